@@ -0,0 +1,381 @@
+/****************************************************/
+/* File: alias.c                                    */
+/* Alias analysis implementation                    */
+/* for the TINY compiler                            */
+/* Array parameters receive the address of the      */
+/* actual array, so every access through a          */
+/* parameter may touch any array that reaches it    */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+
+/* ALIAS_SIZE is the size of the declaration hash table */
+#define ALIAS_SIZE 211
+
+/* The record kept for every array declaration
+ * (VarArrayK or ArrayParamK). targets[k] is TRUE
+ * when declared array number k may be the storage
+ * bound to this declaration
+ */
+typedef struct AliasRec
+{
+    TreeNode *decl;
+    int array; /* number of a VarArrayK, -1 for parameters */
+    char *targets;
+    struct AliasRec *next;
+} * AliasList;
+
+/* an array argument flows from src into the parameter dst */
+typedef struct
+{
+    AliasList src;
+    AliasList dst;
+} AliasEdge;
+
+static AliasList aliasHash[ALIAS_SIZE];
+static AliasList *aliasTab = NULL; /* records in declaration order */
+static int nAlias = 0;
+static int maxAlias = 0;
+static int nArrays = 0; /* number of VarArrayK declarations */
+static AliasEdge *edges = NULL;
+static int nEdges = 0;
+static int maxEdges = 0;
+static int analyzed = FALSE;
+
+/* the hash function on declaration nodes */
+static int hashDecl(TreeNode *t)
+{
+    return (int)(((unsigned long)t >> 4) % ALIAS_SIZE);
+}
+
+static int isArrayDecl(TreeNode *t)
+{
+    return t != NULL && t->nodekind == ExpK &&
+           (t->kind.exp == VarArrayK || t->kind.exp == ArrayParamK);
+}
+
+static AliasList lookupDecl(TreeNode *t)
+{
+    AliasList l = aliasHash[hashDecl(t)];
+    while (l != NULL && l->decl != t)
+        l = l->next;
+    return l;
+}
+
+static void insertDecl(TreeNode *t)
+{
+    int h = hashDecl(t);
+    AliasList l = (AliasList)malloc(sizeof(struct AliasRec));
+    l->decl = t;
+    l->array = -1;
+    l->targets = NULL;
+    l->next = aliasHash[h];
+    aliasHash[h] = l;
+    if (nAlias == maxAlias)
+    {
+        maxAlias = maxAlias ? 2 * maxAlias : 32;
+        aliasTab = realloc(aliasTab, maxAlias * sizeof(AliasList));
+    }
+    aliasTab[nAlias++] = l;
+}
+
+static void addEdge(AliasList src, AliasList dst)
+{
+    if (nEdges == maxEdges)
+    {
+        maxEdges = maxEdges ? 2 * maxEdges : 32;
+        edges = realloc(edges, maxEdges * sizeof(AliasEdge));
+    }
+    edges[nEdges].src = src;
+    edges[nEdges].dst = dst;
+    nEdges++;
+}
+
+/* Procedure walk applies proc to every node
+ * of the tree in preorder
+ */
+static void walk(TreeNode *t, void (*proc)(TreeNode *))
+{
+    int i;
+    while (t != NULL)
+    {
+        proc(t);
+        for (i = 0; i < MAXCHILDREN; i++)
+            walk(t->child[i], proc);
+        t = t->sibling;
+    }
+}
+
+static void collectDecl(TreeNode *t)
+{
+    if (isArrayDecl(t) && lookupDecl(t) == NULL)
+    {
+        insertDecl(t);
+        if (t->kind.exp == VarArrayK)
+            aliasTab[nAlias - 1]->array = nArrays++;
+    }
+}
+
+/* Procedure collectCall records an edge for every
+ * array passed to an array parameter at a call site
+ */
+static void collectCall(TreeNode *t)
+{
+    TreeNode *fn, *formal, *actual;
+    if (t->nodekind != ExpK || t->kind.exp != CallK)
+        return;
+    fn = declOf(t);
+    if (fn == NULL || fn->nodekind != StmtK)
+        return;
+    formal = fn->child[1];
+    actual = t->child[0];
+    while (formal != NULL && actual != NULL)
+    {
+        if (formal->nodekind == ExpK && formal->kind.exp == ArrayParamK &&
+            actual->nodekind == ExpK && actual->kind.exp == IdK)
+        {
+            AliasList src = lookupDecl(declOf(actual));
+            AliasList dst = lookupDecl(formal);
+            if (src != NULL && dst != NULL)
+                addEdge(src, dst);
+        }
+        formal = formal->sibling;
+        actual = actual->sibling;
+    }
+}
+
+static void resetAlias(void)
+{
+    int i;
+    for (i = 0; i < nAlias; i++)
+    {
+        free(aliasTab[i]->targets);
+        free(aliasTab[i]);
+    }
+    for (i = 0; i < ALIAS_SIZE; i++)
+        aliasHash[i] = NULL;
+    nAlias = 0;
+    nArrays = 0;
+    nEdges = 0;
+}
+
+static void printAlias(FILE *listing)
+{
+    int i, k;
+    fprintf(listing, "  Param     Function  May be bound to\n");
+    fprintf(listing, "--------  ----------  ---------------\n");
+    for (i = 0; i < nAlias; i++)
+    {
+        AliasList l = aliasTab[i];
+        if (l->decl->kind.exp != ArrayParamK)
+            continue;
+        fprintf(listing, "%-8s  ", l->decl->attr.name);
+        fprintf(listing, "%-10s  ", l->decl->scope ? l->decl->scope->name : "?");
+        for (k = 0; k < nAlias; k++)
+        {
+            TreeNode *d = aliasTab[k]->decl;
+            if (d->kind.exp == VarArrayK && mayReach(l->decl, d))
+                fprintf(listing, "%s(%s) ", d->attr.arr.name,
+                        d->scope ? d->scope->name : "?");
+        }
+        fprintf(listing, "\n");
+    }
+}
+
+/* Procedure aliasAnalysis computes for every array
+ * parameter the set of declared arrays that can be
+ * bound to it through any chain of call sites
+ */
+void aliasAnalysis(TreeNode *syntaxTree)
+{
+    int i, k, changed;
+    resetAlias();
+    walk(syntaxTree, collectDecl);
+    for (i = 0; i < nAlias; i++)
+    {
+        AliasList l = aliasTab[i];
+        l->targets = (char *)calloc(nArrays > 0 ? nArrays : 1, sizeof(char));
+        if (l->array >= 0)
+            l->targets[l->array] = TRUE;
+    }
+    walk(syntaxTree, collectCall);
+    /* propagate along the call edges until nothing changes;
+       a parameter passed on to another call forwards its set */
+    do
+    {
+        changed = FALSE;
+        for (i = 0; i < nEdges; i++)
+        {
+            char *s = edges[i].src->targets;
+            char *d = edges[i].dst->targets;
+            for (k = 0; k < nArrays; k++)
+                if (s[k] && !d[k])
+                {
+                    d[k] = TRUE;
+                    changed = TRUE;
+                }
+        }
+    } while (changed);
+    analyzed = TRUE;
+    if (TraceAnalyze)
+    {
+        fprintf(listing, "\nAlias sets:\n\n");
+        printAlias(listing);
+    }
+}
+
+/* Function declOf returns the declaration node that
+ * an IdK, ArrayIdK or CallK node refers to, or NULL
+ */
+TreeNode *declOf(TreeNode *t)
+{
+    if (t == NULL || t->bucket == NULL)
+        return NULL;
+    return t->bucket->treeNode;
+}
+
+int isVar(TreeNode *t, TreeNode *decl)
+{
+    return t != NULL && t->nodekind == ExpK && t->kind.exp == IdK &&
+           declOf(t) == decl;
+}
+
+/* Function offsetOf returns TRUE if the subscript
+ * t is var, var + c, c + var or var - c, setting
+ * offset to the constant added to var
+ */
+int offsetOf(TreeNode *t, TreeNode *var, int *offset)
+{
+    *offset = 0;
+    if (isVar(t, var))
+        return TRUE;
+    if (t->nodekind != ExpK || t->kind.exp != OpK)
+        return FALSE;
+    if (t->attr.op == PLUS && isVar(t->child[0], var) && isConst(t->child[1]))
+        *offset = t->child[1]->attr.val;
+    else if (t->attr.op == PLUS && isConst(t->child[0]) && isVar(t->child[1], var))
+        *offset = t->child[0]->attr.val;
+    else if (t->attr.op == MINUS && isVar(t->child[0], var) && isConst(t->child[1]))
+        *offset = -t->child[1]->attr.val;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/* Function assignCount counts the assignments to the
+ * variable decl in t, and any user call as one if
+ * decl is global
+ */
+int assignCount(TreeNode *t, TreeNode *decl)
+{
+    int n = 0, i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == AssignK && isVar(t->child[0], decl))
+            n++;
+        else if (t->nodekind == ExpK && t->kind.exp == CallK &&
+                 decl->scope == globalScope && t->bucket != NULL &&
+                 t->bucket->treeNode->child[2] != NULL)
+            n++;
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += assignCount(t->child[i], decl);
+    }
+    return n;
+}
+
+/* Function isInvariant returns TRUE if the
+ * expression e keeps its value while the loop
+ * body runs
+ */
+int isInvariant(TreeNode *e, TreeNode *body)
+{
+    if (e->nodekind != ExpK)
+        return FALSE;
+    switch (e->kind.exp)
+    {
+    case ConstK:
+        return TRUE;
+    case IdK:
+        return isScalar(declOf(e)) && assignCount(body, declOf(e)) == 0;
+    case OpK:
+        return isInvariant(e->child[0], body) && isInvariant(e->child[1], body);
+    default:
+        return FALSE;
+    }
+}
+
+/* Function mayReach returns TRUE if the declared
+ * array arr (VarArrayK) may be the storage behind
+ * the array declaration decl (VarArrayK or ArrayParamK)
+ */
+int mayReach(TreeNode *decl, TreeNode *arr)
+{
+    AliasList d, a;
+    if (!analyzed)
+        return TRUE;
+    d = lookupDecl(decl);
+    a = lookupDecl(arr);
+    if (d == NULL || a == NULL || a->array < 0)
+        return TRUE;
+    return d->targets[a->array];
+}
+
+/* Function mayShare returns TRUE if the array
+ * declarations a and b (VarArrayK or ArrayParamK)
+ * may be bound to the same storage
+ */
+int mayShare(TreeNode *a, TreeNode *b)
+{
+    AliasList la, lb;
+    int k;
+    if (a == b || !analyzed)
+        return TRUE;
+    la = lookupDecl(a);
+    lb = lookupDecl(b);
+    if (la == NULL || lb == NULL)
+        return TRUE;
+    for (k = 0; k < nArrays; k++)
+        if (la->targets[k] && lb->targets[k])
+            return TRUE;
+    return FALSE;
+}
+
+static int constIndex(TreeNode *t)
+{
+    return t->kind.exp == ArrayIdK && t->child[0] != NULL &&
+           t->child[0]->nodekind == ExpK && t->child[0]->kind.exp == ConstK;
+}
+
+/* Function mayAlias returns TRUE if the variable
+ * references a and b (IdK or ArrayIdK) may denote
+ * the same memory location
+ */
+int mayAlias(TreeNode *a, TreeNode *b)
+{
+    TreeNode *da = declOf(a);
+    TreeNode *db = declOf(b);
+    AliasList la, lb;
+    int k;
+    if (da == NULL || db == NULL)
+        return TRUE;
+    if (!isArrayDecl(da) || !isArrayDecl(db))
+        /* there are no pointers to scalars in C-Minus */
+        return da == db;
+    if (!analyzed)
+        return TRUE;
+    la = lookupDecl(da);
+    lb = lookupDecl(db);
+    if (la == NULL || lb == NULL)
+        return TRUE;
+    /* the same binding with distinct constant subscripts */
+    if (da == db && constIndex(a) && constIndex(b))
+        return a->child[0]->attr.val == b->child[0]->attr.val;
+    for (k = 0; k < nArrays; k++)
+        if (la->targets[k] && lb->targets[k])
+            return TRUE;
+    return FALSE;
+}
@@ -0,0 +1,62 @@
+/****************************************************/
+/* File: alias.h                                    */
+/* Alias analysis interface for the TINY compiler   */
+/* (array parameters are passed by reference)       */
+/****************************************************/
+
+#ifndef _ALIAS_H_
+#define _ALIAS_H_
+
+/* Procedure aliasAnalysis computes for every array
+ * parameter the set of declared arrays that can be
+ * bound to it through any chain of call sites
+ */
+void aliasAnalysis(TreeNode *syntaxTree);
+
+/* Function declOf returns the declaration node that
+ * an IdK, ArrayIdK or CallK node refers to, or NULL
+ */
+TreeNode *declOf(TreeNode *t);
+
+/* Function isVar returns TRUE if t is an IdK
+ * node referring to the declaration decl
+ */
+int isVar(TreeNode *t, TreeNode *decl);
+
+/* Function offsetOf returns TRUE if the subscript
+ * t is var, var + c, c + var or var - c, setting
+ * offset to the constant added to var
+ */
+int offsetOf(TreeNode *t, TreeNode *var, int *offset);
+
+/* Function assignCount counts the assignments to the
+ * variable decl in t, and any user call as one if
+ * decl is global
+ */
+int assignCount(TreeNode *t, TreeNode *decl);
+
+/* Function isInvariant returns TRUE if the
+ * expression e keeps its value while the loop
+ * body runs
+ */
+int isInvariant(TreeNode *e, TreeNode *body);
+
+/* Function mayReach returns TRUE if the declared
+ * array arr (VarArrayK) may be the storage behind
+ * the array declaration decl (VarArrayK or ArrayParamK)
+ */
+int mayReach(TreeNode *decl, TreeNode *arr);
+
+/* Function mayShare returns TRUE if the array
+ * declarations a and b (VarArrayK or ArrayParamK)
+ * may be bound to the same storage
+ */
+int mayShare(TreeNode *a, TreeNode *b);
+
+/* Function mayAlias returns TRUE if the variable
+ * references a and b (IdK or ArrayIdK) may denote
+ * the same memory location
+ */
+int mayAlias(TreeNode *a, TreeNode *b);
+
+#endif
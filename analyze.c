@@ -96,7 +96,10 @@ static void insertNode(TreeNode *t)
             if (compoundFlag == 1) compoundFlag = 0;
             else {
                 char *newScopeName = nestedScope(sc_top()->name);
-                sc_push(sc_create(newScopeName));
+                ScopeList nested = sc_create(newScopeName);
+                /* nested locals share the frame of the function */
+                nested->loc = sc_top()->loc;
+                sc_push(nested);
             }
             t->scope = sc_top();
             break;
@@ -117,6 +120,8 @@ static void insertNode(TreeNode *t)
                 symbolError(t, "variable type should not Void");
             } else {
                 st_insert(sc_top()->name, t->attr.name, t->type, t);
+                t->scope = sc_top();
+                t->bucket = st_lookup(sc_top()->name, t->attr.name);
             }
             break;
         case SingleParamK:
@@ -126,6 +131,8 @@ static void insertNode(TreeNode *t)
             }
             t->type = t->child[0]->type;
             st_insert(sc_top()->name, t->attr.name, t->type, t);
+            t->scope = sc_top();
+            t->bucket = st_lookup(sc_top()->name, t->attr.name);
             break;
         case VarArrayK:
         case ArrayParamK:
@@ -134,12 +141,16 @@ static void insertNode(TreeNode *t)
                 break;
             }
             st_insert(sc_top()->name, t->attr.name, t->type, t);
+            t->scope = sc_top();
+            t->bucket = st_lookup(sc_top()->name, t->attr.name);
             break;
         case ArrayIdK:
         case IdK:
         case CallK:
             if (sc_lookup(t->attr.name) != NULL) {
                 st_insert(sc_lookup(t->attr.name)->name, t->attr.name, t->type, t);
+                /* remember the declaration the reference resolved to */
+                t->bucket = st_lookup(sc_top()->name, t->attr.name);
             } else {
                 symbolError(t, "variable or function undeclared");
                 break;
@@ -176,7 +187,7 @@ void buildSymtab(TreeNode *syntaxTree)
     TreeNode *output_func;
     output_func = newStmtNode(FunctionK);
     output_func->type = Void;
-    output_func->attr.name = malloc(strlen("input")+1);
+    output_func->attr.name = malloc(strlen("output")+1);
     output_func->lineno = 0;
     strcpy(output_func->attr.name, "output");
     output_func->child[0] = NULL;
@@ -8,6 +8,11 @@
 #ifndef _ANALYZE_H_
 #define _ANALYZE_H_
 
+/* globalScope is the scope of the program's
+ * global variables and functions
+ */
+extern struct ScopeListRec *globalScope;
+
 /* Function buildSymtab constructs the symbol 
  * table by preorder traversal of the syntax tree
  */
@@ -0,0 +1,176 @@
+/****************************************************/
+/* File: bitset.c                                   */
+/* Dense bit set implementation                     */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#include "globals.h"
+#include "bitset.h"
+
+#define WORD(i) ((i) / BITS_PER_WORD)
+#define MASK(i) ((BitWord)1 << ((i) % BITS_PER_WORD))
+
+/* the bits of the last word that belong to the set */
+static BitWord lastMask(Bitset s)
+{
+    int used = s->nbits % BITS_PER_WORD;
+    return used == 0 ? ~(BitWord)0 : MASK(used) - 1;
+}
+
+/* Function bsNew allocates an empty set of nbits members */
+Bitset bsNew(int nbits)
+{
+    Bitset s = (Bitset)malloc(sizeof(struct BitsetRec));
+    s->nbits = nbits;
+    s->nwords = (nbits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    s->words = (BitWord *)calloc(s->nwords > 0 ? s->nwords : 1, sizeof(BitWord));
+    return s;
+}
+
+/* Procedure bsFree releases a set */
+void bsFree(Bitset s)
+{
+    if (s == NULL)
+        return;
+    free(s->words);
+    free(s);
+}
+
+/* Procedure bsClear removes every member */
+void bsClear(Bitset s)
+{
+    memset(s->words, 0, s->nwords * sizeof(BitWord));
+}
+
+/* Procedure bsFill adds every member */
+void bsFill(Bitset s)
+{
+    if (s->nwords == 0)
+        return;
+    memset(s->words, 0xff, s->nwords * sizeof(BitWord));
+    s->words[s->nwords - 1] &= lastMask(s);
+}
+
+void bsSet(Bitset s, int i)
+{
+    s->words[WORD(i)] |= MASK(i);
+}
+
+void bsReset(Bitset s, int i)
+{
+    s->words[WORD(i)] &= ~MASK(i);
+}
+
+int bsTest(Bitset s, int i)
+{
+    return (s->words[WORD(i)] & MASK(i)) != 0;
+}
+
+/* Procedure bsCopy sets dst to src */
+void bsCopy(Bitset dst, Bitset src)
+{
+    memcpy(dst->words, src->words, dst->nwords * sizeof(BitWord));
+}
+
+/* Functions bsUnion and bsIntersect update dst
+ * in place and return TRUE if it changed
+ */
+int bsUnion(Bitset dst, Bitset src)
+{
+    BitWord changed = 0;
+    int i;
+    for (i = 0; i < dst->nwords; i++)
+    {
+        BitWord w = dst->words[i] | src->words[i];
+        changed |= w ^ dst->words[i];
+        dst->words[i] = w;
+    }
+    return changed != 0;
+}
+
+int bsIntersect(Bitset dst, Bitset src)
+{
+    BitWord changed = 0;
+    int i;
+    for (i = 0; i < dst->nwords; i++)
+    {
+        BitWord w = dst->words[i] & src->words[i];
+        changed |= w ^ dst->words[i];
+        dst->words[i] = w;
+    }
+    return changed != 0;
+}
+
+/* Procedure bsDiff removes the members of src from dst */
+void bsDiff(Bitset dst, Bitset src)
+{
+    int i;
+    for (i = 0; i < dst->nwords; i++)
+        dst->words[i] &= ~src->words[i];
+}
+
+int bsEqual(Bitset a, Bitset b)
+{
+    return memcmp(a->words, b->words, a->nwords * sizeof(BitWord)) == 0;
+}
+
+/* Function bsTransfer computes the classic transfer
+ * function out = gen | (in & ~kill) and returns
+ * TRUE if out changed
+ */
+int bsTransfer(Bitset out, Bitset gen, Bitset in, Bitset kill)
+{
+    BitWord changed = 0;
+    int i;
+    for (i = 0; i < out->nwords; i++)
+    {
+        BitWord w = gen->words[i] | (in->words[i] & ~kill->words[i]);
+        changed |= w ^ out->words[i];
+        out->words[i] = w;
+    }
+    return changed != 0;
+}
+
+/* Function bsNext returns the first member at or
+ * after i, or -1 if there is none
+ */
+int bsNext(Bitset s, int i)
+{
+    int w;
+    BitWord bits;
+    if (i < 0)
+        i = 0;
+    if (i >= s->nbits)
+        return -1;
+    w = WORD(i);
+    bits = s->words[w] & ~(MASK(i) - 1);
+    while (bits == 0)
+    {
+        if (++w >= s->nwords)
+            return -1;
+        bits = s->words[w];
+    }
+    i = w * BITS_PER_WORD;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/* Function bsCount returns the number of members */
+int bsCount(Bitset s)
+{
+    int i, n = 0;
+    for (i = 0; i < s->nwords; i++)
+    {
+        BitWord w = s->words[i];
+        while (w != 0)
+        {
+            w &= w - 1;
+            n++;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,68 @@
+/****************************************************/
+/* File: bitset.h                                   */
+/* Dense bit sets for the data-flow analyses        */
+/* of the TINY compiler                             */
+/****************************************************/
+
+#ifndef _BITSET_H_
+#define _BITSET_H_
+
+/* bits are kept in 64-bit words so that set
+ * operations handle 64 members at a time
+ */
+typedef unsigned long long BitWord;
+
+#define BITS_PER_WORD 64
+
+typedef struct BitsetRec
+{
+    int nbits;
+    int nwords;
+    BitWord *words;
+} * Bitset;
+
+/* Function bsNew allocates an empty set of nbits members */
+Bitset bsNew(int nbits);
+
+/* Procedure bsFree releases a set */
+void bsFree(Bitset s);
+
+/* Procedure bsClear removes every member */
+void bsClear(Bitset s);
+
+/* Procedure bsFill adds every member */
+void bsFill(Bitset s);
+
+void bsSet(Bitset s, int i);
+void bsReset(Bitset s, int i);
+int bsTest(Bitset s, int i);
+
+/* Procedure bsCopy sets dst to src */
+void bsCopy(Bitset dst, Bitset src);
+
+/* Functions bsUnion and bsIntersect update dst
+ * in place and return TRUE if it changed
+ */
+int bsUnion(Bitset dst, Bitset src);
+int bsIntersect(Bitset dst, Bitset src);
+
+/* Procedure bsDiff removes the members of src from dst */
+void bsDiff(Bitset dst, Bitset src);
+
+int bsEqual(Bitset a, Bitset b);
+
+/* Function bsTransfer computes the classic transfer
+ * function out = gen | (in & ~kill) and returns
+ * TRUE if out changed
+ */
+int bsTransfer(Bitset out, Bitset gen, Bitset in, Bitset kill);
+
+/* Function bsNext returns the first member at or
+ * after i, or -1 if there is none
+ */
+int bsNext(Bitset s, int i);
+
+/* Function bsCount returns the number of members */
+int bsCount(Bitset s);
+
+#endif
@@ -7,10 +7,19 @@
 /* Kenneth C. Louden                                */
 /****************************************************/
 
+#include <limits.h>
 #include "globals.h"
 #include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "range.h"
 #include "code.h"
 #include "cgen.h"
+#include "strength.h"
+#include "scalar.h"
+#include "idiom.h"
+#include "vector.h"
+#include "profile.h"
 
 /* tmpOffset is the memory offset for temps
    It is decremented each time a temp is
@@ -18,147 +27,1196 @@
 */
 static int tmpOffset = 0;
 
+/* the entry location of every generated function */
+typedef struct FuncRec
+{
+   TreeNode *fn;
+   int entry;
+   struct FuncRec *next;
+} * FuncList;
+
+static FuncList funcs = NULL;
+
+/* the calls of functions not generated yet */
+static FuncList calls = NULL;
+
+/* location of the shared bounds check failure code */
+static int trapLoc = 0;
+
+/* TRUE while the copy of a loop that its guard
+ * proved in bounds is generated
+ */
+static int unchecked = FALSE;
+
+/* the loop whose checked copy is generated */
+static TreeNode *checkedLoop = NULL;
+
+/* highest frame word used by the current function */
+static int frameWords = 0;
+
+/* TM registers FIRST_KEPT..LAST_KEPT hold the
+ * values the loops being generated keep
+ */
+#define FIRST_KEPT 2
+#define LAST_KEPT 4
+#define MAX_KEPT (LAST_KEPT - FIRST_KEPT + 1)
+
+/* value kept[k] is in register FIRST_KEPT + k */
+static KeptValue kept[MAX_KEPT];
+static int nKept = 0;
+
+/* the nTemps registers above the kept ones hold
+ * temps of the expression being generated; code
+ * from -i takes its temps from regalloc.c instead
+ */
+static int nTemps = 0;
+
+/* the comparison genExp leaves as the difference
+ * of its operands, for genCond to branch on
+ */
+static TreeNode *fusedTest = NULL;
+
 /* prototype for internal recursive code generator */
 static void cGen(TreeNode *tree);
+static void genExp(TreeNode *tree);
+
+static int isGlobal(TreeNode *decl)
+{
+   return decl->scope == globalScope;
+}
+
+/* Function varOffset returns the offset from gp or
+ * mp of the scalar, array parameter or element 0
+ * of the array named by the symbol b
+ */
+static int varOffset(BucketList b)
+{
+   TreeNode *d = b->treeNode;
+   if (isGlobal(d))
+      return b->memloc;
+   if (d->kind.exp == VarArrayK)
+      return -(FRAME_HEADER + b->memloc + d->attr.arr.length - 1);
+   return -(FRAME_HEADER + b->memloc);
+}
+
+int frameOffset(TreeNode *decl)
+{
+   return varOffset(decl->bucket);
+}
+
+int frameBase(TreeNode *decl)
+{
+   return isGlobal(decl) ? gp : mp;
+}
+
+/* Procedure frameExtent finds the number of frame
+ * words needed by the locals of nested blocks
+ */
+static void frameExtent(TreeNode *tree)
+{
+   int i;
+   while (tree != NULL)
+   {
+      if (tree->nodekind == StmtK && tree->kind.stmt == CompoundK &&
+          tree->scope != NULL && tree->scope->loc > frameWords)
+         frameWords = tree->scope->loc;
+      for (i = 0; i < MAXCHILDREN; i++)
+         frameExtent(tree->child[i]);
+      tree = tree->sibling;
+   }
+}
+
+int frameSize(TreeNode *fn)
+{
+   frameWords = 0;
+   frameExtent(fn->child[2]);
+   return frameWords;
+}
+
+static int funcEntry(TreeNode *fn)
+{
+   FuncList f = funcs;
+   while (f != NULL && f->fn != fn)
+      f = f->next;
+   return f == NULL ? -1 : f->entry;
+}
+
+/* Procedure genBase loads into register r the
+ * address of element 0 of the array named by t
+ */
+static void genBase(TreeNode *t, int r)
+{
+   BucketList b = t->bucket;
+   TreeNode *d = b->treeNode;
+   if (d->kind.exp == ArrayParamK)
+      emitRM("LD", r, varOffset(b), mp, "load array parameter");
+   else if (isGlobal(d))
+      emitRM("LDA", r, varOffset(b), gp, "global array address");
+   else
+      emitRM("LDA", r, varOffset(b), mp, "local array address");
+}
+
+/* Function keptReg returns the register holding
+ * the value the IdK or ArrayIdK node t names, or
+ * -1 if it is in memory
+ */
+static int keptReg(TreeNode *t)
+{
+   int k;
+   for (k = 0; k < nKept; k++)
+      if (keptMatch(t, &kept[k]))
+         return FIRST_KEPT + k;
+   return -1;
+}
+
+/* Procedure genKeptStore stores the kept value k
+ * back to memory
+ */
+static void genKeptStore(int k)
+{
+   TreeNode *d = kept[k].decl;
+   emitRM("ST", FIRST_KEPT + k, varOffset(d->bucket) + (kept[k].index < 0 ? 0 : kept[k].index),
+          isGlobal(d) ? gp : mp, "loop exit: store kept value");
+}
+
+/* Procedure genLength loads into ac the length
+ * of the array named by t
+ */
+static void genLength(TreeNode *t)
+{
+   BucketList b = t->bucket;
+   TreeNode *d = b->treeNode;
+   if (d->kind.exp == ArrayParamK)
+      emitRM("LD", ac, varOffset(b) - 1, mp, "load array length");
+   else
+      emitRM("LDC", ac, d->attr.arr.length, 0, "array length");
+}
+
+/* Function needsCheck returns TRUE if the element
+ * access t needs a bounds check
+ */
+static int needsCheck(TreeNode *t)
+{
+   return CheckBounds && !unchecked && !boundsSafe(t);
+}
+
+/* Procedure genCheck emits the bounds check of
+ * the subscript held in ac for ArrayIdK node t
+ */
+static void genCheck(TreeNode *t)
+{
+   BucketList b = t->bucket;
+   TreeNode *d = b->treeNode;
+   if (TraceCode)
+      emitComment("-> bounds check");
+   emitRM_Abs("JLT", ac, trapLoc, "check: index below 0");
+   if (d->kind.exp == ArrayParamK)
+   {
+      emitRM("LD", ac1, varOffset(b) - 1, mp, "check: load length");
+      emitRO("SUB", ac1, ac, ac1, "check: index - length");
+   }
+   else
+      emitRM("LDA", ac1, -d->attr.arr.length, ac, "check: index - length");
+   emitRM_Abs("JGE", ac1, trapLoc, "check: index past end");
+   if (TraceCode)
+      emitComment("<- bounds check");
+}
+
+/* Function genElem leaves in ac a base register
+ * value such that element t of the array is found
+ * at the returned offset from ac
+ */
+static int genElem(TreeNode *t)
+{
+   BucketList b = t->bucket;
+   TreeNode *d = b->treeNode;
+   genExp(t->child[0]);
+   if (needsCheck(t))
+      genCheck(t);
+   if (d->kind.exp == ArrayParamK)
+   {
+      emitRM("LD", ac1, varOffset(b), mp, "load array parameter");
+      emitRO("ADD", ac, ac1, ac, "element address");
+      return 0;
+   }
+   if (!isGlobal(d))
+      emitRO("ADD", ac, mp, ac, "add frame pointer");
+   return varOffset(b);
+}
+
+/* Procedure genCall generates the calling sequence:
+ * the arguments are stored into the new frame,
+ * which starts at the first free temp location
+ */
+static void genCall(TreeNode *tree)
+{
+   TreeNode *fn = tree->bucket->treeNode;
+   TreeNode *formal = fn->child[1];
+   TreeNode *arg;
+   int frame = tmpOffset;
+   int loc = 0;
+   if (fn->child[2] == NULL) /* built in input and output */
+   {
+      if (strcmp(tree->attr.name, "input") == 0)
+         emitRO("IN", ac, 0, 0, "input integer value");
+      else
+      {
+         genExp(tree->child[0]);
+         emitRO("OUT", ac, 0, 0, "output ac");
+      }
+      return;
+   }
+   for (arg = tree->child[0]; arg != NULL; arg = arg->sibling)
+   {
+      int slot = frame - FRAME_HEADER - loc;
+      /* temps used by the argument stay below its slot */
+      tmpOffset = slot - st_size(formal);
+      if (formal->kind.exp == ArrayParamK)
+      {
+         genBase(arg, ac);
+         emitRM("ST", ac, slot, mp, "call: store array argument");
+         if (CheckBounds)
+         {
+            genLength(arg);
+            emitRM("ST", ac, slot - 1, mp, "call: store array length");
+         }
+      }
+      else
+      {
+         genExp(arg);
+         emitRM("ST", ac, slot, mp, "call: store argument");
+      }
+      loc += st_size(formal);
+      formal = formal->sibling;
+   }
+   tmpOffset = frame;
+   emitProfile(tree, PROFILE_ENTRY);
+   emitRM("ST", mp, frame, mp, "call: store control link");
+   emitRM("LDA", mp, frame, mp, "call: push frame");
+   emitRM("LDA", ac, 1, pc, "call: return address");
+   if (funcEntry(fn) >= 0)
+      emitRM_Abs("LDA", pc, funcEntry(fn), "call: jump to function");
+   else
+   {
+      /* the jump is patched once fn is generated */
+      FuncList c = (FuncList)malloc(sizeof(struct FuncRec));
+      c->fn = fn;
+      c->entry = emitSkip(1);
+      c->next = calls;
+      calls = c;
+   }
+   emitRM("LD", mp, 0, mp, "call: pop frame");
+}
+
+/* Function assigns returns TRUE if expression t
+ * contains an assignment
+ */
+static int assigns(TreeNode *t)
+{
+   TreeNode *c;
+   int i;
+   if (t->kind.exp == AssignK)
+      return TRUE;
+   for (i = 0; i < MAXCHILDREN; i++)
+      for (c = t->child[i]; c != NULL; c = c->sibling)
+         if (assigns(c))
+            return TRUE;
+   return FALSE;
+}
+
+int tailCall(TreeNode *call)
+{
+   TreeNode *fn = declOf(call), *arg, *d;
+   if (!Optimize || fn == NULL || fn->child[2] == NULL)
+      return FALSE;
+   for (arg = call->child[0]; arg != NULL; arg = arg->sibling)
+   {
+      d = arg->kind.exp == IdK ? declOf(arg) : NULL;
+      if ((d != NULL && d->kind.exp == VarArrayK && !isGlobal(d)) || assigns(arg))
+         return FALSE;
+   }
+   return TRUE;
+}
+
+int passedOn(TreeNode *arg, TreeNode *formal)
+{
+   return arg->nodekind == ExpK && arg->kind.exp == IdK && declOf(arg) == formal;
+}
+
+/* Procedure genTailCall generates a call in tail
+ * position into the frame of the caller: the
+ * arguments are evaluated into the temps, except
+ * the last one, which stays in ac, and are then
+ * copied over the parameters; the callee skips
+ * storing the return address already in place
+ */
+static void genTailCall(TreeNode *tree)
+{
+   TreeNode *fn = tree->bucket->treeNode;
+   TreeNode *formal = fn->child[1];
+   TreeNode *arg;
+   int frame = tmpOffset;
+   int loc = 0, last = -1, n, w;
+   for (arg = tree->child[0]; arg != NULL; arg = arg->sibling)
+   {
+      int slot = frame - FRAME_HEADER - loc;
+      tmpOffset = slot - st_size(formal);
+      if (passedOn(arg, formal))
+         ; /* the parameter already holds it */
+      else if (formal->kind.exp == ArrayParamK)
+      {
+         genBase(arg, ac);
+         emitRM("ST", ac, slot, mp, "tail call: store array argument");
+         if (CheckBounds)
+         {
+            genLength(arg);
+            emitRM("ST", ac, slot - 1, mp, "tail call: store array length");
+         }
+      }
+      else
+      {
+         genExp(arg);
+         if (arg->sibling == NULL)
+            last = loc;
+         else
+            emitRM("ST", ac, slot, mp, "tail call: store argument");
+      }
+      loc += st_size(formal);
+      formal = formal->sibling;
+   }
+   tmpOffset = frame;
+   /* no parameter changes before every argument is read */
+   loc = 0;
+   formal = fn->child[1];
+   for (arg = tree->child[0]; arg != NULL; arg = arg->sibling)
+   {
+      /* the length of an array is only passed in checked mode */
+      n = formal->kind.exp == ArrayParamK && !CheckBounds ? 1 : st_size(formal);
+      if (!passedOn(arg, formal) && loc != last)
+         for (w = 0; w < n; w++)
+         {
+            emitRM("LD", ac1, frame - FRAME_HEADER - loc - w, mp, "tail call: load argument");
+            emitRM("ST", ac1, -FRAME_HEADER - loc - w, mp, "tail call: store parameter");
+         }
+      loc += st_size(formal);
+      formal = formal->sibling;
+   }
+   if (last >= 0)
+      emitRM("ST", ac, -FRAME_HEADER - last, mp, "tail call: store parameter");
+   emitProfile(tree, PROFILE_ENTRY);
+   emitRM_Abs("LDA", pc, funcEntry(fn) + 1, "tail call: jump past function entry");
+}
+
+/* Function genMulConst generates a multiply by a
+ * constant operand as doublings and adds or
+ * subtracts of the other operand when opCost makes
+ * them cheaper, and returns FALSE if it did not
+ */
+static int genMulConst(TreeNode *tree)
+{
+   TreeNode *x = tree->child[0], *k = tree->child[1];
+   int digits[MUL_DIGITS], n, j, c, cost, copy = FALSE;
+   if (x->kind.exp == ConstK)
+   {
+      x = k;
+      k = tree->child[0];
+   }
+   if (k->kind.exp != ConstK || k->attr.val == 0)
+      return FALSE;
+   c = k->attr.val;
+   n = mulDigits(c, digits);
+   cost = (n - 1) * opCost("ADD");
+   for (j = 1; j < n; j++)
+      if (digits[j] != 0)
+      {
+         cost += opCost(digits[j] > 0 ? "ADD" : "SUB");
+         copy = TRUE;
+      }
+   if (copy)
+      cost += opCost("LDA");
+   if (c < 0)
+      cost += opCost("LDC") + opCost("SUB");
+   /* the operand push, the constant and the multiply */
+   if (cost >= opCost("ST") + opCost("LDC") + opCost("LD") + opCost("MUL"))
+      return FALSE;
+   genExp(x);
+   if (copy)
+      emitRM("LDA", ac1, 0, ac, "mul: copy operand");
+   for (j = 1; j < n; j++)
+   {
+      emitRO("ADD", ac, ac, ac, "mul: double");
+      if (digits[j] > 0)
+         emitRO("ADD", ac, ac, ac1, "mul: add operand");
+      else if (digits[j] < 0)
+         emitRO("SUB", ac, ac, ac1, "mul: subtract operand");
+   }
+   if (c < 0)
+   {
+      emitRM("LDC", ac1, 0, 0, "mul: zero");
+      emitRO("SUB", ac, ac1, ac, "mul: negate");
+   }
+   return TRUE;
+}
+
+/* Procedure genKeptLoads loads into the free kept
+ * registers the values the loop is worth keeping
+ */
+static void genKeptLoads(TreeNode *loop)
+{
+   KeptValue vals[2 * MAX_KEPT];
+   TreeNode *d;
+   int n, j, k;
+   n = keptValues(loop, vals, MAX_KEPT + nKept);
+   for (j = 0; j < n && nKept < MAX_KEPT; j++)
+   {
+      for (k = 0; k < nKept; k++)
+         if (kept[k].decl == vals[j].decl && kept[k].index == vals[j].index)
+            break;
+      if (k < nKept)
+         continue; /* kept by an enclosing loop */
+      d = vals[j].decl;
+      kept[nKept] = vals[j];
+      emitRM("LD", FIRST_KEPT + nKept, varOffset(d->bucket) + (vals[j].index < 0 ? 0 : vals[j].index),
+             isGlobal(d) ? gp : mp, "loop entry: load kept value");
+      nKept++;
+   }
+}
+
+/* Function genBlockLoop generates the copy or
+ * fill loop as one MOV or FIL instruction run if
+ * it has trips, and returns FALSE if the elements
+ * need bounds checks
+ */
+static int genBlockLoop(TreeNode *loop)
+{
+   BlockLoop b;
+   int skipLoc, currentLoc, loc, r, spill;
+   if (!blockLoop(loop, &b) || needsCheck(b.dst) || (b.src != NULL && needsCheck(b.src)))
+      return FALSE;
+   if (TraceCode)
+      emitComment("-> block loop");
+   genExp(b.count);
+   skipLoc = emitSkip(1);
+   emitRM("ST", ac, tmpOffset--, mp, "block: push count");
+   loc = genElem(b.dst);
+   emitRM("LDA", ac, loc, ac, "block: first element written");
+   emitRM("ST", ac, tmpOffset--, mp, "block: push destination");
+   if (b.src != NULL)
+   {
+      loc = genElem(b.src);
+      emitRM("LDA", ac, loc, ac, "block: first element read");
+   }
+   else
+      genExp(b.value);
+   emitRM("LD", ac1, ++tmpOffset, mp, "block: load destination");
+   /* the count needs a third register, a kept one if all are busy */
+   spill = nKept == MAX_KEPT;
+   r = spill ? LAST_KEPT : FIRST_KEPT + nKept;
+   if (spill)
+      emitRM("ST", r, tmpOffset, mp, "block: save kept value");
+   emitRM("LD", r, ++tmpOffset, mp, "block: load count");
+   if (b.src != NULL)
+      emitRO("MOV", ac1, ac, r, "block: move words");
+   else
+      emitRO("FIL", ac1, ac, r, "block: fill words");
+   if (spill)
+      emitRM("LD", r, tmpOffset - 1, mp, "block: restore kept value");
+   genExp(b.exit);
+   currentLoc = emitSkip(0);
+   emitBackup(skipLoc);
+   emitRM_Abs("JLE", ac, currentLoc, "block: skip if no trips");
+   emitRestore();
+   if (TraceCode)
+      emitComment("<- block loop");
+   return TRUE;
+}
+
+/* Function checked returns TRUE if an element
+ * access of t needs a bounds check
+ */
+static int checked(TreeNode *t)
+{
+   int i;
+   for (; t != NULL; t = t->sibling)
+   {
+      if (t->nodekind == ExpK && t->kind.exp == ArrayIdK && needsCheck(t))
+         return TRUE;
+      for (i = 0; i < MAXCHILDREN; i++)
+         if (checked(t->child[i]))
+            return TRUE;
+   }
+   return FALSE;
+}
+
+/* Procedure genVector evaluates the expression t
+ * for VECTOR_LENGTH trips into vector register v,
+ * using the registers above v for its operands
+ */
+static void genVector(TreeNode *t, int v)
+{
+   int loc;
+   switch (t->kind.exp)
+   {
+   case ArrayIdK:
+      loc = genElem(t);
+      emitRM("VLD", v, loc, ac, "vector: load elements");
+      break;
+   case OpK:
+      genVector(t->child[0], v);
+      genVector(t->child[1], v + 1);
+      switch (t->attr.op)
+      {
+      case PLUS:
+         emitRO("VADD", v, v, v + 1, "vector: op +");
+         break;
+      case MINUS:
+         emitRO("VSUB", v, v, v + 1, "vector: op -");
+         break;
+      case TIMES:
+         emitRO("VMUL", v, v, v + 1, "vector: op *");
+         break;
+      case LT:
+         emitRO("VLT", v, v, v + 1, "vector: op <");
+         break;
+      case LE:
+         emitRO("VLE", v, v, v + 1, "vector: op <=");
+         break;
+      case GT:
+         emitRO("VLT", v, v + 1, v, "vector: op >");
+         break;
+      case GE:
+         emitRO("VLE", v, v + 1, v, "vector: op >=");
+         break;
+      case EQ:
+         emitRO("VEQ", v, v, v + 1, "vector: op ==");
+         break;
+      default: /* NE */
+         emitRO("VNE", v, v, v + 1, "vector: op !=");
+         break;
+      }
+      break;
+   default: /* the same value on every trip */
+      genExp(t);
+      emitRO("VSPL", v, ac, 0, "vector: spread value");
+      break;
+   }
+}
+
+/* jumps taken when ac relates to 0 as LT..NE say,
+ * and when it does not
+ */
+static char *jumpIf[] = {"JLT", "JLE", "JGT", "JGE", "JEQ", "JNE"};
+static char *jumpUnless[] = {"JGE", "JGT", "JLE", "JLT", "JNE", "JEQ"};
+
+/* Function relIndex returns the index of the
+ * relational operator op in jumpIf, or -1
+ */
+static int relIndex(TokenType op)
+{
+   switch (op)
+   {
+   case LT:
+      return 0;
+   case LE:
+      return 1;
+   case GT:
+      return 2;
+   case GE:
+      return 3;
+   case EQ:
+      return 4;
+   case NE:
+      return 5;
+   default:
+      return -1;
+   }
+}
+
+/* Function genCond generates the condition t of
+ * an if or while and returns the index in jumpIf
+ * of the jump taken when it holds; a comparison
+ * leaves only the difference of its operands in
+ * ac, which the jump tests, instead of 0 or 1
+ */
+static int genCond(TreeNode *t)
+{
+   int rel = -1;
+   if (t->nodekind == ExpK && t->kind.exp == OpK)
+      rel = relIndex(t->attr.op);
+   if (rel < 0)
+   {
+      genExp(t);
+      return relIndex(NE);
+   }
+   fusedTest = t;
+   genExp(t);
+   fusedTest = NULL;
+   return rel;
+}
+
+/* Procedure genVectorLoop runs the trips of the
+ * loop VECTOR_LENGTH at a time while enough are
+ * left, before the loop itself runs the rest
+ */
+static void genVectorLoop(TreeNode *loop)
+{
+   VectorLoop v;
+   TreeNode *s;
+   int skipLoc, bodyLoc, currentLoc, loc, rel;
+   if (!vectorLoop(loop, &v) || checked(loop->child[1]))
+      return;
+   if (TraceCode)
+      emitComment("-> vector loop");
+   rel = genCond(v.test);
+   skipLoc = emitSkip(1);
+   bodyLoc = emitSkip(0);
+   for (s = v.stmts; s != v.step; s = s->sibling)
+   {
+      genVector(s->child[1], 0);
+      loc = genElem(s->child[0]);
+      emitRM("VST", 0, loc, ac, "vector: store elements");
+   }
+   genExp(v.next);
+   genCond(v.test);
+   emitRM_Abs(jumpIf[rel], ac, bodyLoc, "vector: jmp back to body");
+   currentLoc = emitSkip(0);
+   emitBackup(skipLoc);
+   emitRM_Abs(jumpUnless[rel], ac, currentLoc, "vector: jmp to end");
+   emitRestore();
+   if (TraceCode)
+      emitComment("<- vector loop");
+}
+
+static void genStmt(TreeNode *tree);
+
+/* Function genGuardedLoop generates the loop twice
+ * behind a test of its counter and bound on entry:
+ * a copy without bounds checks for when the test
+ * proves them all in bounds, and the checked loop
+ * for when it does not. It returns FALSE if the
+ * subscripts do not allow such a test
+ */
+static int genGuardedLoop(TreeNode *loop)
+{
+   LoopGuard g;
+   TreeNode *outer;
+   int failLoc[MAX_GUARDED + 2];
+   int nFail = 0, endLoc, currentLoc, k;
+   if (unchecked || loop == checkedLoop || !guardLoop(loop, &g))
+      return FALSE;
+   if (TraceCode)
+      emitComment("-> guarded loop");
+   genExp(g.counter);
+   emitRM("LDA", ac, -g.low, ac, "guard: counter - low");
+   failLoc[nFail++] = emitSkip(1);
+   if (g.high < INT_MAX)
+   {
+      genExp(g.bound);
+      emitRM("LDA", ac, -g.high, ac, "guard: bound - high");
+      failLoc[nFail++] = emitSkip(1);
+   }
+   for (k = 0; k < g.nParams; k++)
+   {
+      genExp(g.bound);
+      emitRM("LDA", ac1, g.slack[k], ac, "guard: bound + slack");
+      genLength(g.param[k]);
+      emitRO("SUB", ac, ac1, ac, "guard: bound + slack - length");
+      failLoc[nFail++] = emitSkip(1);
+   }
+   unchecked = TRUE;
+   genStmt(loop);
+   unchecked = FALSE;
+   endLoc = emitSkip(1);
+   currentLoc = emitSkip(0);
+   emitBackup(failLoc[0]);
+   emitRM_Abs("JLT", ac, currentLoc, "guard: jmp to checked loop");
+   for (k = 1; k < nFail; k++)
+   {
+      emitBackup(failLoc[k]);
+      emitRM_Abs("JGT", ac, currentLoc, "guard: jmp to checked loop");
+   }
+   emitRestore();
+   outer = checkedLoop;
+   checkedLoop = loop;
+   genStmt(loop);
+   checkedLoop = outer;
+   currentLoc = emitSkip(0);
+   emitBackup(endLoc);
+   emitRM_Abs("LDA", pc, currentLoc, "guard: jmp to end");
+   emitRestore();
+   if (TraceCode)
+      emitComment("<- guarded loop");
+   return TRUE;
+}
 
 /* Procedure genStmt generates code at a statement node */
 static void genStmt(TreeNode *tree)
 {
    TreeNode *p1, *p2, *p3;
-   int savedLoc1, savedLoc2, currentLoc;
-   int loc;
+   int savedLoc1, savedLoc2, currentLoc, outer, k, rel;
+   NodeProfile *prof;
+   FuncList f;
    switch (tree->kind.stmt)
    {
 
+   case FunctionK:
+      if (TraceCode)
+      {
+         emitComment("-> function");
+         emitComment(tree->attr.name);
+      }
+      f = (FuncList)malloc(sizeof(struct FuncRec));
+      f->fn = tree;
+      f->entry = emitSkip(0);
+      f->next = funcs;
+      funcs = f;
+      tmpOffset = -(FRAME_HEADER + frameSize(tree));
+      emitProfile(tree, PROFILE_ENTRY);
+      emitRM("ST", ac, RA_OFFSET, mp, "function: store return address");
+      cGen(tree->child[2]);
+      emitRM("LD", pc, RA_OFFSET, mp, "function: return");
+      if (TraceCode)
+         emitComment("<- function");
+      break; /* FunctionK */
+
+   case CompoundK:
+      cGen(tree->child[1]);
+      break; /* CompoundK */
+
    case IfK:
       if (TraceCode)
          emitComment("-> if");
       p1 = tree->child[0];
       p2 = tree->child[1];
       p3 = tree->child[2];
+      prof = nodeProfile(tree);
       /* generate code for test expression */
-      cGen(p1);
+      rel = genCond(p1);
+      if (p3 != NULL && prof != NULL && prof->trips > prof->elses)
+      {
+         /* the then part runs more often, so it
+          * goes last and needs no jump to the end
+          */
+         savedLoc1 = emitSkip(1);
+         emitComment("if: jump to then belongs here");
+         cGen(p3);
+         savedLoc2 = emitSkip(1);
+         emitComment("if: jump to end belongs here");
+         currentLoc = emitSkip(0);
+         emitBackup(savedLoc1);
+         emitProfile(tree, PROFILE_THEN);
+         emitRM_Abs(jumpIf[rel], ac, currentLoc, "if: jmp to then");
+         emitRestore();
+         cGen(p2);
+         currentLoc = emitSkip(0);
+         emitBackup(savedLoc2);
+         emitRM_Abs("LDA", pc, currentLoc, "jmp to end");
+         emitRestore();
+         if (TraceCode)
+            emitComment("<- if");
+         break;
+      }
       savedLoc1 = emitSkip(1);
       emitComment("if: jump to else belongs here");
       /* recurse on then part */
       cGen(p2);
-      savedLoc2 = emitSkip(1);
-      emitComment("if: jump to end belongs here");
+      if (p3 != NULL)
+      {
+         savedLoc2 = emitSkip(1);
+         emitComment("if: jump to end belongs here");
+      }
       currentLoc = emitSkip(0);
       emitBackup(savedLoc1);
-      emitRM_Abs("JEQ", ac, currentLoc, "if: jmp to else");
-      emitRestore();
-      /* recurse on else part */
-      cGen(p3);
-      currentLoc = emitSkip(0);
-      emitBackup(savedLoc2);
-      emitRM_Abs("LDA", pc, currentLoc, "jmp to end");
+      emitProfile(tree, PROFILE_ELSE);
+      emitRM_Abs(jumpUnless[rel], ac, currentLoc, "if: jmp to else");
       emitRestore();
+      if (p3 != NULL)
+      {
+         /* recurse on else part */
+         cGen(p3);
+         currentLoc = emitSkip(0);
+         emitBackup(savedLoc2);
+         emitRM_Abs("LDA", pc, currentLoc, "jmp to end");
+         emitRestore();
+      }
       if (TraceCode)
          emitComment("<- if");
       break; /* if_k */
-   /*
-      case RepeatK:
-         if (TraceCode) emitComment("-> repeat") ;
-         p1 = tree->child[0] ;
-         p2 = tree->child[1] ;
+
+   case WhileK:
+      if (TraceCode)
+         emitComment("-> while");
+      if (Optimize && genBlockLoop(tree))
+      {
+         if (TraceCode)
+            emitComment("<- while");
+         break;
+      }
+      p1 = tree->child[0];
+      p2 = tree->child[1];
+      prof = nodeProfile(tree);
+      if (Optimize && !OptimizeSize && CheckBounds && (prof == NULL || prof->entries > 0) &&
+          genGuardedLoop(tree))
+      {
+         if (TraceCode)
+            emitComment("<- while");
+         break;
+      }
+      if (prof != NULL && prof->entries == 0)
+      {
+         /* never entered in training: the compact
+          * loop with the test at its top
+          */
          savedLoc1 = emitSkip(0);
-         emitComment("repeat: jump after body comes back here");
-         cGen(p1);
+         rel = genCond(p1);
+         savedLoc2 = emitSkip(1);
+         emitComment("while: jump to end belongs here");
          cGen(p2);
-         emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
-         if (TraceCode)  emitComment("<- repeat") ;
-         break; 
-      */
-   case AssignK:
+         emitRM_Abs("LDA", pc, savedLoc1, "while: jmp back to test");
+         currentLoc = emitSkip(0);
+         emitBackup(savedLoc2);
+         emitProfile(tree, PROFILE_TEST);
+         emitRM_Abs(jumpUnless[rel], ac, currentLoc, "while: jmp to end");
+         emitRestore();
+         if (TraceCode)
+            emitComment("<- while");
+         break;
+      }
+      if (Optimize && !OptimizeSize)
+         genVectorLoop(tree);
+      /* the loop is rotated: a guard test skips it, and
+       * a copy of the test after the body branches back
+       * straight to the body
+       */
+      outer = nKept;
+      if (Optimize)
+         genKeptLoads(tree);
+      rel = genCond(p1);
+      savedLoc2 = emitSkip(1);
+      emitComment("while: jump to end belongs here");
+      savedLoc1 = emitSkip(0);
+      emitComment("while: jump back to body comes here");
+      cGen(p2);
+      genCond(p1);
+      emitProfile(tree, PROFILE_TRIP);
+      emitRM_Abs(jumpIf[rel], ac, savedLoc1, "while: jmp back to body");
+      currentLoc = emitSkip(0);
+      emitBackup(savedLoc2);
+      emitProfile(tree, PROFILE_ENTRY);
+      emitRM_Abs(jumpUnless[rel], ac, currentLoc, "while: jmp to end");
+      emitRestore();
+      for (; nKept > outer; nKept--)
+         if (kept[nKept - 1].stored)
+            genKeptStore(nKept - 1);
       if (TraceCode)
-         emitComment("-> assign");
-      /* generate code for rhs */
-      cGen(tree->child[0]);
-      /* now store value */
-      /*
-      loc = st_lookup(tree->attr.name);
-      emitRM("ST", ac, loc, gp, "assign: store value");
+         emitComment("<- while");
+      break; /* WhileK */
+
+   case ReturnK:
       if (TraceCode)
-         emitComment("<- assign");
-      break; *//* assign_k */
-   /*
-      case ReadK:
-         emitRO("IN",ac,0,0,"read integer value");
-         loc = st_lookup(tree->attr.name);
-         emitRM("ST",ac,loc,gp,"read: store value");
-         break;
-      case WriteK:
-         cGen(tree->child[0]);
-         emitRO("OUT",ac,0,0,"write ac");
-         break;
-      */
+         emitComment("-> return");
+      p1 = tree->child[0];
+      if (p1 != NULL && p1->nodekind == ExpK && p1->kind.exp == CallK && tailCall(p1) &&
+          funcEntry(p1->bucket->treeNode) >= 0)
+         genTailCall(p1);
+      else
+      {
+         if (p1 != NULL)
+            genExp(p1);
+         /* the locals die, the globals are stored back */
+         for (k = 0; k < nKept; k++)
+            if (kept[k].stored && isGlobal(kept[k].decl))
+               genKeptStore(k);
+         emitRM("LD", pc, RA_OFFSET, mp, "return: jump to caller");
+      }
+      if (TraceCode)
+         emitComment("<- return");
+      break; /* ReturnK */
+
    default:
       break;
    }
 } /* genStmt */
 
+/* Function isLeaf returns TRUE if t is a constant
+ * or a scalar in memory, which one instruction
+ * loads into any register
+ */
+static int isLeaf(TreeNode *t)
+{
+   return t->nodekind == ExpK && keptReg(t) < 0 &&
+          (t->kind.exp == ConstK || (t->kind.exp == IdK && t->type != IntegerArray));
+}
+
+/* Procedure genLeaf loads the leaf t into
+ * register r
+ */
+static void genLeaf(TreeNode *t, int r)
+{
+   if (t->kind.exp == ConstK)
+      emitRM("LDC", r, t->attr.val, 0, "load const");
+   else
+      emitRM("LD", r, varOffset(t->bucket),
+             isGlobal(t->bucket->treeNode) ? gp : mp, "load id value");
+}
+
+/* Function effects returns TRUE if the code of t
+ * calls or assigns, so that it must keep its place
+ * in the order of evaluation; with user set, only
+ * calls of user functions, which use the registers
+ * of the temps, count
+ */
+static int effects(TreeNode *t, int user)
+{
+   int i;
+   for (; t != NULL; t = t->sibling)
+   {
+      if (t->nodekind == ExpK &&
+          ((t->kind.exp == AssignK && !user) ||
+           (t->kind.exp == CallK && (!user || declOf(t)->child[2] != NULL))))
+         return TRUE;
+      for (i = 0; i < MAXCHILDREN; i++)
+         if (effects(t->child[i], user))
+            return TRUE;
+   }
+   return FALSE;
+}
+
+/* Function regNeed returns the registers the
+ * expression t takes, ac included, without
+ * spilling a temp (its Sethi-Ullman number)
+ */
+static int regNeed(TreeNode *t)
+{
+   TreeNode *p1 = t->child[0], *p2 = t->child[1];
+   int left, right;
+   if (t->nodekind != ExpK)
+      return 1;
+   switch (t->kind.exp)
+   {
+   case ArrayIdK:
+      return keptReg(t) >= 0 ? 1 : regNeed(p1);
+   case AssignK:
+      if (keptReg(p1) >= 0 || p1->kind.exp != ArrayIdK)
+         return regNeed(p2);
+      left = regNeed(p1->child[0]);
+      right = regNeed(p2) + 1;
+      return left > right ? left : right;
+   case OpK:
+      /* as genExp evaluates the operands */
+      if (keptReg(p1) >= 0 || isLeaf(p2))
+         return regNeed(p1);
+      if (keptReg(p2) >= 0 || (isLeaf(p1) && !effects(p2, FALSE)))
+         return regNeed(p2);
+      left = regNeed(p1);
+      right = regNeed(p2);
+      return left == right ? left + 1 : left > right ? left : right;
+   default:
+      return 1;
+   }
+}
+
+/* Function takeTemp returns a free register to
+ * hold a temp while the code of t runs, or -1 if
+ * none is free or t calls a user function
+ */
+static int takeTemp(TreeNode *t)
+{
+   if (FIRST_KEPT + nKept + nTemps > LAST_KEPT || effects(t, TRUE))
+      return -1;
+   return FIRST_KEPT + nKept + nTemps++;
+}
+
 /* Procedure genExp generates code at an expression node */
 static void genExp(TreeNode *tree)
 {
-   int loc;
+   int loc, left, right, temp;
    TreeNode *p1, *p2;
    switch (tree->kind.exp)
    {
-   /*
-    case ConstK :
-      if (TraceCode) emitComment("-> Const") ;
-      emitRM("LDC",ac,tree->attr.val,0,"load const");
-      if (TraceCode)  emitComment("<- Const") ;
-      break;
-    */
+   case ConstK:
+      if (TraceCode)
+         emitComment("-> Const");
+      emitRM("LDC", ac, tree->attr.val, 0, "load const");
+      if (TraceCode)
+         emitComment("<- Const");
+      break; /* ConstK */
+
    case IdK:
-      /*
       if (TraceCode)
          emitComment("-> Id");
-      loc = st_lookup(tree->attr.name);
-      emitRM("LD", ac, loc, gp, "load id value");
+      if (tree->type == IntegerArray)
+         genBase(tree, ac);
+      else if (keptReg(tree) >= 0)
+         emitRM("LDA", ac, 0, keptReg(tree), "copy kept value");
+      else
+         emitRM("LD", ac, varOffset(tree->bucket),
+                isGlobal(tree->bucket->treeNode) ? gp : mp, "load id value");
       if (TraceCode)
-         emitComment("<- Id");*/
+         emitComment("<- Id");
       break; /* IdK */
 
+   case ArrayIdK:
+      if (TraceCode)
+         emitComment("-> ArrayId");
+      if (keptReg(tree) >= 0)
+      {
+         emitRM("LDA", ac, 0, keptReg(tree), "copy kept element");
+         if (TraceCode)
+            emitComment("<- ArrayId");
+         break;
+      }
+      loc = genElem(tree);
+      emitRM("LD", ac, loc, ac, "load array element");
+      if (TraceCode)
+         emitComment("<- ArrayId");
+      break; /* ArrayIdK */
+
+   case AssignK:
+      if (TraceCode)
+         emitComment("-> assign");
+      p1 = tree->child[0];
+      p2 = tree->child[1];
+      if (keptReg(p1) >= 0)
+      {
+         genExp(p2);
+         emitRM("LDA", keptReg(p1), 0, ac, "assign: keep value");
+      }
+      else if (p1->kind.exp == ArrayIdK)
+      {
+         /* the element address is computed first */
+         loc = genElem(p1);
+         temp = takeTemp(p2);
+         if (temp >= 0)
+         {
+            emitRM("LDA", temp, 0, ac, "assign: keep address");
+            genExp(p2);
+            nTemps--;
+         }
+         else
+         {
+            emitRM("ST", ac, tmpOffset--, mp, "assign: push address");
+            genExp(p2);
+            emitRM("LD", ac1, ++tmpOffset, mp, "assign: load address");
+            temp = ac1;
+         }
+         emitRM("ST", ac, loc, temp, "assign: store element");
+      }
+      else
+      {
+         genExp(p2);
+         emitRM("ST", ac, varOffset(p1->bucket),
+                isGlobal(p1->bucket->treeNode) ? gp : mp, "assign: store value");
+      }
+      if (TraceCode)
+         emitComment("<- assign");
+      break; /* AssignK */
+
+   case CallK:
+      if (TraceCode)
+         emitComment("-> call");
+      genCall(tree);
+      if (TraceCode)
+         emitComment("<- call");
+      break; /* CallK */
+
    case OpK:
       if (TraceCode)
          emitComment("-> Op");
       p1 = tree->child[0];
       p2 = tree->child[1];
-      /* gen code for ac = left arg */
-      cGen(p1);
-      /* gen code to push left operand */
-      emitRM("ST", ac, tmpOffset--, mp, "op: push left");
-      /* gen code for ac = right operand */
-      cGen(p2);
-      /* now load left operand */
-      emitRM("LD", ac1, ++tmpOffset, mp, "op: load left");
+      if (Optimize && tree->attr.op == TIMES && genMulConst(tree))
+      {
+         if (TraceCode)
+            emitComment("<- Op");
+         break;
+      }
+      /* a kept operand is read from its register */
+      left = keptReg(p1);
+      right = keptReg(p2);
+      if (left < 0 && right < 0 && isLeaf(p2))
+      {
+         genExp(p1);
+         genLeaf(p2, ac1);
+         left = ac;
+         right = ac1;
+      }
+      else if (left < 0 && right < 0 && isLeaf(p1) && !effects(p2, FALSE))
+      {
+         genExp(p2);
+         genLeaf(p1, ac1);
+         left = ac1;
+         right = ac;
+      }
+      else if (left < 0 && right < 0)
+      {
+         /* the operand needing more registers goes first,
+          * unless the order of evaluation shows
+          */
+         if (regNeed(p2) > regNeed(p1) && !effects(p1, FALSE) && !effects(p2, FALSE))
+         {
+            p1 = tree->child[1];
+            p2 = tree->child[0];
+         }
+         genExp(p1);
+         temp = takeTemp(p2);
+         if (temp >= 0)
+         {
+            emitRM("LDA", temp, 0, ac, "op: keep operand");
+            genExp(p2);
+            nTemps--;
+         }
+         else
+         {
+            emitRM("ST", ac, tmpOffset--, mp, "op: push operand");
+            genExp(p2);
+            emitRM("LD", ac1, ++tmpOffset, mp, "op: load operand");
+            temp = ac1;
+         }
+         if (p1 == tree->child[0])
+         {
+            left = temp;
+            right = ac;
+         }
+         else
+         {
+            left = ac;
+            right = temp;
+         }
+      }
+      else if (left < 0)
+      {
+         genExp(p1);
+         left = ac;
+      }
+      else if (right < 0)
+         genExp(p2);
+      if (right < 0)
+         right = ac;
       switch (tree->attr.op)
       {
       case PLUS:
-         emitRO("ADD", ac, ac1, ac, "op +");
+         emitRO("ADD", ac, left, right, "op +");
          break;
       case MINUS:
-         emitRO("SUB", ac, ac1, ac, "op -");
+         emitRO("SUB", ac, left, right, "op -");
          break;
       case TIMES:
-         emitRO("MUL", ac, ac1, ac, "op *");
+         emitRO("MUL", ac, left, right, "op *");
          break;
       case OVER:
-         emitRO("DIV", ac, ac1, ac, "op /");
+         emitRO("DIV", ac, left, right, "op /");
          break;
       case LT:
-         emitRO("SUB", ac, ac1, ac, "op <");
-         emitRM("JLT", ac, 2, pc, "br if true");
-         emitRM("LDC", ac, 0, ac, "false case");
-         emitRM("LDA", pc, 1, pc, "unconditional jmp");
-         emitRM("LDC", ac, 1, ac, "true case");
-         break;
+      case LE:
+      case GT:
+      case GE:
       case EQ:
-         emitRO("SUB", ac, ac1, ac, "op ==");
-         emitRM("JEQ", ac, 2, pc, "br if true");
+      case NE:
+         emitRO("SUB", ac, left, right, "op compare");
+         if (tree == fusedTest)
+            break; /* the branch tests the difference */
+         emitRM(jumpIf[relIndex(tree->attr.op)], ac, 2, pc, "br if true");
          emitRM("LDC", ac, 0, ac, "false case");
          emitRM("LDA", pc, 1, pc, "unconditional jmp");
          emitRM("LDC", ac, 1, ac, "true case");
@@ -210,18 +1268,49 @@ static void cGen(TreeNode *tree)
 void codeGen(TreeNode *syntaxTree, char *codefile)
 {
    char *s = malloc(strlen(codefile) + 7);
+   TreeNode *t, *mainFn = NULL;
+   FuncList c;
+   int mainLoc;
    strcpy(s, "File: ");
    strcat(s, codefile);
+   funcs = calls = NULL;
    emitComment("TINY Compilation to TM Code");
    emitComment(s);
    /* generate standard prelude */
    emitComment("Standard prelude:");
    emitRM("LD", mp, 0, ac, "load maxaddress from location 0");
    emitRM("ST", ac, 0, ac, "clear location 0");
+   emitRM("LDA", ac, 1, pc, "return address of main");
+   mainLoc = emitSkip(1);
+   emitComment("End of execution.");
+   emitRO("HALT", 0, 0, 0, "");
+   if (CheckBounds)
+   {
+      /* a failed check faults like an access outside dMem */
+      trapLoc = emitSkip(0);
+      emitRM("LD", ac, -1, gp, "bounds check failed");
+   }
    emitComment("End of standard prelude.");
    /* generate code for TINY program */
    cGen(syntaxTree);
    /* finish */
-   emitComment("End of execution.");
-   emitRO("HALT", 0, 0, 0, "");
+   while (calls != NULL)
+   {
+      c = calls;
+      emitBackup(c->entry);
+      emitRM_Abs("LDA", pc, funcEntry(c->fn), "call: jump to function");
+      emitRestore();
+      calls = c->next;
+      free(c);
+   }
+   for (t = syntaxTree; t != NULL; t = t->sibling)
+      if (t->nodekind == StmtK && t->kind.stmt == FunctionK &&
+          strcmp(t->attr.name, "main") == 0)
+         mainFn = t;
+   emitBackup(mainLoc);
+   if (mainFn != NULL)
+      emitRM_Abs("LDA", pc, funcEntry(mainFn), "jump to main");
+   else
+      emitRO("HALT", 0, 0, 0, "no main function");
+   emitRestore();
 }
@@ -8,6 +8,55 @@
 #ifndef _CGEN_H_
 #define _CGEN_H_
 
+/* Activation records are kept at the top of dMem
+ * and grow downwards; mp points to the current one:
+ *     0(mp)   control link (mp of the caller)
+ *    -1(mp)   return address
+ *    -2(mp)   parameters and locals in memloc order,
+ *             followed by the temps
+ * An array parameter holds the address of element 0
+ * and, in checked mode, the length of the actual
+ * array in the next word. Globals are addressed
+ * from gp, which the TM leaves at 0, so a global
+ * location is also its absolute address.
+ */
+#define RA_OFFSET (-1)
+#define FRAME_HEADER 2
+
+/* Function frameOffset returns the offset from
+ * frameBase(decl) of the scalar, array parameter
+ * or element 0 of the array declared by decl
+ */
+int frameOffset(TreeNode *decl);
+
+/* Function frameBase returns gp for globals
+ * and mp for parameters and locals
+ */
+int frameBase(TreeNode *decl);
+
+/* Function frameSize returns the number of frame
+ * words the parameters and locals of the
+ * FunctionK node fn occupy
+ */
+int frameSize(TreeNode *fn);
+
+/* Function tailCall returns TRUE if the CallK node
+ * call, in tail position, may run in the frame of
+ * its caller: -O is set, the callee has a body, no
+ * argument is an array of the caller's frame and
+ * none assigns, so that parameters passed on keep
+ * their value. The callee is then entered one
+ * instruction past its entry, the return address
+ * being in place.
+ */
+int tailCall(TreeNode *call);
+
+/* Function passedOn returns TRUE if the argument
+ * arg of a call in tail position is the parameter
+ * formal it is bound to, which keeps its value
+ */
+int passedOn(TreeNode *arg, TreeNode *formal);
+
 /* Procedure codeGen generates code to a code
  * file by traversal of the syntax tree. The
  * second parameter (codefile) is the file name
@@ -0,0 +1,140 @@
+/****************************************************/
+/* File: clone.c                                    */
+/* Copying code between scopes and estimating       */
+/* its size, for the TINY compiler                  */
+/* Copies made for the same frame words as the      */
+/* original never run at the same time, so a block  */
+/* copy may reuse the words of the block it copies  */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "clone.h"
+
+int nodeCost(TreeNode *t)
+{
+    int n = 0, i;
+    if (t->nodekind == StmtK)
+    {
+        n += t->kind.stmt == CompoundK ? 0 : 2;
+        /* a rotated loop has its test twice */
+        if (t->kind.stmt == WhileK)
+            n += codeCost(t->child[0]);
+    }
+    else if (t->nodekind != ExpK)
+        return 0;
+    else
+        switch (t->kind.exp)
+        {
+        case VarK:
+        case VarArrayK:
+        case SingleParamK:
+        case ArrayParamK:
+            return 0;
+        case ArrayIdK:
+        case OpK:
+            n += 3;
+            break;
+        case CallK:
+            n += isUserCall(t) ? CALL_COST : 1;
+            break;
+        default:
+            n += 1;
+            break;
+        }
+    for (i = 0; i < MAXCHILDREN; i++)
+        n += codeCost(t->child[i]);
+    return n;
+}
+
+int codeCost(TreeNode *t)
+{
+    int n = 0;
+    for (; t != NULL; t = t->sibling)
+        n += nodeCost(t);
+    return n;
+}
+
+/* the symbols copies refer to instead of the
+ * symbols of the original
+ */
+typedef struct
+{
+    BucketList from, to;
+} Binding;
+
+static Binding *binds;
+static int nBinds, maxBinds;
+
+void cloneReset(void)
+{
+    nBinds = 0;
+}
+
+void cloneBind(BucketList from, BucketList to)
+{
+    if (nBinds == maxBinds)
+    {
+        maxBinds = maxBinds ? 2 * maxBinds : 16;
+        binds = realloc(binds, maxBinds * sizeof(Binding));
+    }
+    binds[nBinds].from = from;
+    binds[nBinds].to = to;
+    nBinds++;
+}
+
+static BucketList bound(BucketList b)
+{
+    int i;
+    for (i = nBinds - 1; i >= 0; i--)
+        if (binds[i].from == b)
+            return binds[i].to;
+    return b;
+}
+
+TreeNode *cloneDecl(TreeNode *d, ScopeList sc)
+{
+    TreeNode *c = allocTree();
+    *c = *d;
+    c->sibling = NULL;
+    if (c->kind.exp == SingleParamK)
+        c->kind.exp = VarK;
+    st_declare(sc, c);
+    cloneBind(d->bucket, c->bucket);
+    return c;
+}
+
+TreeNode *cloneTree(TreeNode *t, ScopeList sc)
+{
+    TreeNode *list = NULL, *c, *d;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        c = allocTree();
+        *c = *t;
+        c->sibling = NULL;
+        if (t->nodekind == StmtK && t->kind.stmt == CompoundK && t->scope != NULL)
+        {
+            ScopeList nested = sc_create(t->scope->name);
+            nested->loc = sc->loc;
+            c->scope = nested;
+            c->child[0] = NULL;
+            for (d = t->child[0]; d != NULL; d = d->sibling)
+                c->child[0] = dangleTree(c->child[0], cloneDecl(d, nested));
+            c->child[1] = cloneTree(t->child[1], nested);
+        }
+        else
+        {
+            if (t->nodekind == ExpK && t->bucket != NULL)
+            {
+                c->bucket = bound(t->bucket);
+                c->attr.name = c->bucket->name;
+            }
+            for (i = 0; i < MAXCHILDREN; i++)
+                c->child[i] = cloneTree(t->child[i], sc);
+        }
+        list = dangleTree(list, c);
+    }
+    return list;
+}
@@ -0,0 +1,49 @@
+/****************************************************/
+/* File: clone.h                                    */
+/* Copying code between scopes and estimating       */
+/* its size, for the TINY compiler                  */
+/****************************************************/
+
+#ifndef _CLONE_H_
+#define _CLONE_H_
+
+#include "symtab.h"
+
+/* CALL_COST is the TM instructions of a calling
+ * sequence, prologue and return
+ */
+#define CALL_COST 7
+
+/* Function codeCost estimates the TM instructions
+ * the code generator emits for t and its siblings
+ */
+int codeCost(TreeNode *t);
+
+/* Function nodeCost estimates the TM instructions
+ * the code generator emits for t alone, without
+ * its siblings
+ */
+int nodeCost(TreeNode *t);
+
+/* Procedure cloneReset forgets every binding */
+void cloneReset(void);
+
+/* Procedure cloneBind makes copied references to
+ * the symbol from refer to the symbol to instead
+ */
+void cloneBind(BucketList from, BucketList to);
+
+/* Function cloneDecl declares in scope sc a copy
+ * of the declaration d, a parameter becoming a
+ * local, and binds d's symbol to the copy
+ */
+TreeNode *cloneDecl(TreeNode *d, ScopeList sc);
+
+/* Function cloneTree copies the code t and its
+ * siblings into scope sc. Every block of the copy
+ * gets a scope of its own nested in sc, holding
+ * copies of its declarations
+ */
+TreeNode *cloneTree(TreeNode *t, ScopeList sc);
+
+#endif
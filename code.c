@@ -17,12 +17,43 @@ static int emitLoc = 0;
    emitBackup, and emitRestore */
 static int highEmitLoc = 0;
 
+/* the cycles the TM simulator charges for each
+ * instruction when it counts cycles (see tm.c)
+ */
+static struct
+{
+    char *op;
+    int cycles;
+} cycleTab[] = {
+    {"HALT", 1}, {"IN", 1}, {"OUT", 1}, {"ADD", 1}, {"SUB", 1},
+    {"MUL", 4}, {"DIV", 12}, {"MOV", 2}, {"FIL", 2}, {"VADD", 1},
+    {"VSUB", 1}, {"VMUL", 4}, {"VLT", 1}, {"VLE", 1}, {"VEQ", 1},
+    {"VNE", 1}, {"VSPL", 1}, {"LD", 2}, {"ST", 2}, {"VLD", 2},
+    {"VST", 2}, {"LDA", 1}, {"LDC", 1}, {"JLT", 1}, {"JLE", 1},
+    {"JGT", 1}, {"JGE", 1}, {"JEQ", 1}, {"JNE", 1}};
+
+/* the node and role emitProfile gave the next
+ * instruction
+ */
+static TreeNode *profileNode = NULL;
+static int profileRole;
+
+/* Procedure emitMapped writes the profile map
+ * line of the instruction about to be emitted
+ */
+static void emitMapped(void)
+{
+    if (profileNode != NULL && code != NULL && map != NULL && profileNode->id > 0)
+        fprintf(map, "%d %d %c\n", emitLoc, profileNode->id, profileRole);
+    profileNode = NULL;
+}
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
 void emitComment(char *c)
 {
-    if (TraceCode)
+    if (TraceCode && code != NULL)
         fprintf(code, "* %s\n", c);
 }
 
@@ -36,10 +67,15 @@ void emitComment(char *c)
  */
 void emitRO(char *op, int r, int s, int t, char *c)
 {
-    fprintf(code, "%3d:  %5s  %d,%d,%d ", emitLoc++, op, r, s, t);
-    if (TraceCode)
-        fprintf(code, "\t%s", c);
-    fprintf(code, "\n");
+    emitMapped();
+    if (code != NULL)
+    {
+        fprintf(code, "%3d:  %5s  %d,%d,%d ", emitLoc, op, r, s, t);
+        if (TraceCode)
+            fprintf(code, "\t%s", c);
+        fprintf(code, "\n");
+    }
+    emitLoc++;
     if (highEmitLoc < emitLoc)
         highEmitLoc = emitLoc;
 } /* emitRO */
@@ -54,10 +90,15 @@ void emitRO(char *op, int r, int s, int t, char *c)
  */
 void emitRM(char *op, int r, int d, int s, char *c)
 {
-    fprintf(code, "%3d:  %5s  %d,%d(%d) ", emitLoc++, op, r, d, s);
-    if (TraceCode)
-        fprintf(code, "\t%s", c);
-    fprintf(code, "\n");
+    emitMapped();
+    if (code != NULL)
+    {
+        fprintf(code, "%3d:  %5s  %d,%d(%d) ", emitLoc, op, r, d, s);
+        if (TraceCode)
+            fprintf(code, "\t%s", c);
+        fprintf(code, "\n");
+    }
+    emitLoc++;
     if (highEmitLoc < emitLoc)
         highEmitLoc = emitLoc;
 } /* emitRM */
@@ -104,12 +145,58 @@ void emitRestore(void)
  */
 void emitRM_Abs(char *op, int r, int a, char *c)
 {
-    fprintf(code, "%3d:  %5s  %d,%d(%d) ",
-            emitLoc, op, r, a - (emitLoc + 1), pc);
+    emitMapped();
+    if (code != NULL)
+    {
+        fprintf(code, "%3d:  %5s  %d,%d(%d) ",
+                emitLoc, op, r, a - (emitLoc + 1), pc);
+        if (TraceCode)
+            fprintf(code, "\t%s", c);
+        fprintf(code, "\n");
+    }
     ++emitLoc;
-    if (TraceCode)
-        fprintf(code, "\t%s", c);
-    fprintf(code, "\n");
     if (highEmitLoc < emitLoc)
         highEmitLoc = emitLoc;
 } /* emitRM_Abs */
+
+/* Procedure emitProfile names the next
+ * instruction emitted in the profile map as
+ * playing role for node t (see profile.h)
+ */
+void emitProfile(TreeNode *t, int role)
+{
+    profileNode = t;
+    profileRole = role;
+}
+
+/* Procedure emitReset starts a new code file
+ * at location 0
+ */
+void emitReset(void)
+{
+    emitLoc = 0;
+    highEmitLoc = 0;
+}
+
+/* Function emitSize returns the number of
+ * code locations used so far
+ */
+int emitSize(void)
+{
+    return highEmitLoc;
+}
+
+/* Function opCost returns what executing the TM
+ * instruction op costs: its cycles if CycleCost
+ * is set, else 1
+ */
+int opCost(char *op)
+{
+    int k;
+    if (!CycleCost)
+        return 1;
+    for (k = 0; k < (int)(sizeof(cycleTab) / sizeof(cycleTab[0])); k++)
+        if (strcmp(cycleTab[k].op, op) == 0)
+            return cycleTab[k].cycles;
+    return 1;
+}
@@ -29,7 +29,21 @@
 /* 2nd accumulator */
 #define ac1 1
 
-/* code emitting utilities */
+/* size of the TM instruction memory (see tm.c) */
+#define IADDR_SIZE 1024
+
+/* size of the TM data memory (see tm.c) */
+#define DADDR_SIZE 1024
+
+/* TM vector registers and the words in each (see tm.c) */
+#define VECTOR_REGS 4
+#define VECTOR_LENGTH 4
+
+/* code emitting utilities. While the code file
+ * is NULL nothing is written but locations are
+ * still counted, so a generator can be run just
+ * to measure the size of its output
+ */
 
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
@@ -83,4 +97,26 @@ void emitRestore(void);
  */
 void emitRM_Abs(char *op, int r, int a, char *c);
 
+/* Procedure emitProfile names the next
+ * instruction emitted in the profile map as
+ * playing role for node t (see profile.h)
+ */
+void emitProfile(TreeNode *t, int role);
+
+/* Procedure emitReset starts a new code file
+ * at location 0
+ */
+void emitReset(void);
+
+/* Function emitSize returns the number of
+ * code locations used so far
+ */
+int emitSize(void);
+
+/* Function opCost returns what executing the TM
+ * instruction op costs: its cycles if CycleCost
+ * is set, else 1
+ */
+int opCost(char *op);
+
 #endif
@@ -0,0 +1,705 @@
+/****************************************************/
+/* File: dataflow.c                                 */
+/* Data-flow analysis framework implementation      */
+/* for the TINY compiler                            */
+/* A function is lowered to a graph with one node   */
+/* per expression statement, test and return, and  */
+/* gen/kill problems over it are solved on dense    */
+/* bit sets with a worklist                         */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "dataflow.h"
+
+/* maps a declaration or an AssignK node to its
+ * variable or definition number
+ */
+typedef struct FlowVarRec
+{
+    TreeNode *node;
+    int index;
+    struct FlowVarRec *next;
+} * FlowVarList;
+
+static int hashNode(TreeNode *t)
+{
+    return (int)(((unsigned long)t >> 4) % FLOW_HASH_SIZE);
+}
+
+static int lookup(FlowGraph g, TreeNode *t)
+{
+    FlowVarList l = g->varHash[hashNode(t)];
+    while (l != NULL && l->node != t)
+        l = l->next;
+    return l == NULL ? -1 : l->index;
+}
+
+static void insert(FlowGraph g, TreeNode *t, int index)
+{
+    int h = hashNode(t);
+    FlowVarList l = (FlowVarList)malloc(sizeof(struct FlowVarRec));
+    l->node = t;
+    l->index = index;
+    l->next = g->varHash[h];
+    g->varHash[h] = l;
+}
+
+/**************************************************/
+/*************   graph construction   *************/
+/**************************************************/
+
+static int newNode(FlowGraph g, FlowKind kind, TreeNode *stmt, TreeNode *exp)
+{
+    FlowNode *n;
+    if (g->nNodes == g->maxNodes)
+    {
+        g->maxNodes = g->maxNodes ? 2 * g->maxNodes : 32;
+        g->nodes = realloc(g->nodes, g->maxNodes * sizeof(FlowNode));
+    }
+    n = &g->nodes[g->nNodes];
+    n->kind = kind;
+    n->stmt = stmt;
+    n->exp = exp;
+    n->nsucc = n->maxSucc = 0;
+    n->succ = NULL;
+    n->npred = n->maxPred = 0;
+    n->pred = NULL;
+    return g->nNodes++;
+}
+
+static void addEdge(FlowGraph g, int from, int to)
+{
+    FlowNode *a, *b;
+    if (from < 0)
+        return; /* control cannot get here */
+    a = &g->nodes[from];
+    b = &g->nodes[to];
+    if (a->nsucc == a->maxSucc)
+    {
+        a->maxSucc = a->maxSucc ? 2 * a->maxSucc : 2;
+        a->succ = realloc(a->succ, a->maxSucc * sizeof(int));
+    }
+    a->succ[a->nsucc++] = to;
+    if (b->npred == b->maxPred)
+    {
+        b->maxPred = b->maxPred ? 2 * b->maxPred : 2;
+        b->pred = realloc(b->pred, b->maxPred * sizeof(int));
+    }
+    b->pred[b->npred++] = from;
+}
+
+static int lowerList(FlowGraph g, TreeNode *t, int cur);
+
+/* Function lowerStmt adds the nodes of statement t,
+ * entered from node cur, and returns the node
+ * control leaves t from, or -1 if it cannot
+ */
+static int lowerStmt(FlowGraph g, TreeNode *t, int cur)
+{
+    int c, n, j;
+    if (t->nodekind == ExpK)
+    {
+        n = newNode(g, FlowExp, t, t);
+        addEdge(g, cur, n);
+        return n;
+    }
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        return lowerList(g, t->child[1], cur);
+    case IfK:
+        c = newNode(g, FlowCond, t, t->child[0]);
+        addEdge(g, cur, c);
+        n = lowerList(g, t->child[1], c);
+        j = newNode(g, FlowJoin, t, NULL);
+        addEdge(g, n, j);
+        addEdge(g, t->child[2] != NULL ? lowerList(g, t->child[2], c) : c, j);
+        return j;
+    case WhileK:
+        j = newNode(g, FlowJoin, t, NULL);
+        addEdge(g, cur, j);
+        c = newNode(g, FlowCond, t, t->child[0]);
+        addEdge(g, j, c);
+        addEdge(g, lowerList(g, t->child[1], c), j);
+        return c;
+    case ReturnK:
+        n = newNode(g, FlowReturn, t, t->child[0]);
+        addEdge(g, cur, n);
+        addEdge(g, n, g->exit);
+        return -1;
+    default:
+        return cur;
+    }
+}
+
+static int lowerList(FlowGraph g, TreeNode *t, int cur)
+{
+    for (; t != NULL; t = t->sibling)
+        cur = lowerStmt(g, t, cur);
+    return cur;
+}
+
+static int isScalarDecl(TreeNode *d)
+{
+    return d != NULL && d->nodekind == ExpK &&
+           (d->kind.exp == VarK || d->kind.exp == SingleParamK);
+}
+
+static void addVar(FlowGraph g, TreeNode *d)
+{
+    if (g->nVars == g->maxVars)
+    {
+        g->maxVars = g->maxVars ? 2 * g->maxVars : 32;
+        g->vars = realloc(g->vars, g->maxVars * sizeof(TreeNode *));
+    }
+    insert(g, d, g->nVars);
+    g->vars[g->nVars++] = d;
+}
+
+static int addDef(FlowGraph g, TreeNode *t, int v, int node)
+{
+    if (g->nDefs == g->maxDefs)
+    {
+        g->maxDefs = g->maxDefs ? 2 * g->maxDefs : 32;
+        g->defs = realloc(g->defs, g->maxDefs * sizeof(TreeNode *));
+        g->defVar = realloc(g->defVar, g->maxDefs * sizeof(int));
+        g->defNode = realloc(g->defNode, g->maxDefs * sizeof(int));
+    }
+    g->defs[g->nDefs] = t;
+    g->defVar[g->nDefs] = v;
+    g->defNode[g->nDefs] = node;
+    return g->nDefs++;
+}
+
+/* numbers the locals of the statements t */
+static void collectLocals(FlowGraph g, TreeNode *t)
+{
+    TreeNode *d;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind != StmtK)
+            continue;
+        if (t->kind.stmt == CompoundK)
+            for (d = t->child[0]; d != NULL; d = d->sibling)
+                if (isScalarDecl(d))
+                    addVar(g, d);
+        for (i = 0; i < MAXCHILDREN; i++)
+            collectLocals(g, t->child[i]);
+    }
+}
+
+/* numbers the globals referenced in t */
+static void collectGlobals(FlowGraph g, TreeNode *t)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == IdK)
+        {
+            TreeNode *d = declOf(t);
+            if (isScalarDecl(d) && d->scope == globalScope && lookup(g, d) < 0)
+                addVar(g, d);
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            collectGlobals(g, t->child[i]);
+    }
+}
+
+/* variable number of a scalar reference, or -1 */
+static int refVar(FlowGraph g, TreeNode *t)
+{
+    TreeNode *d = declOf(t);
+    return d == NULL ? -1 : lookup(g, d);
+}
+
+/* numbers the assignments to scalars in t */
+static void collectDefs(FlowGraph g, TreeNode *t, int node)
+{
+    int i;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    for (i = 0; i < MAXCHILDREN; i++)
+    {
+        TreeNode *c;
+        for (c = t->child[i]; c != NULL; c = c->sibling)
+            collectDefs(g, c, node);
+    }
+    if (t->kind.exp == AssignK && t->child[0]->kind.exp == IdK)
+    {
+        int v = refVar(g, t->child[0]);
+        if (v >= 0)
+            insert(g, t, addDef(g, t, v, node));
+    }
+}
+
+/* Function buildFlowGraph builds the flow graph of
+ * the FunctionK node fn from its IfK, WhileK,
+ * CompoundK and ReturnK structure
+ */
+FlowGraph buildFlowGraph(TreeNode *fn)
+{
+    FlowGraph g = (FlowGraph)calloc(1, sizeof(struct FlowGraphRec));
+    TreeNode *p;
+    int n, v, d;
+    g->fn = fn;
+    for (p = fn->child[1]; p != NULL; p = p->sibling)
+        if (isScalarDecl(p))
+            addVar(g, p);
+    collectLocals(g, fn->child[2]);
+    g->nLocals = g->nVars;
+    collectGlobals(g, fn->child[2]);
+
+    g->entry = newNode(g, FlowEntry, fn, NULL);
+    g->exit = newNode(g, FlowExit, fn, NULL);
+    addEdge(g, lowerList(g, fn->child[2], g->entry), g->exit);
+
+    /* parameters and globals hold a value on entry;
+     * a global's outside value is also produced by
+     * every call
+     */
+    for (v = 0; v < g->nVars; v++)
+        if (v >= g->nLocals || g->vars[v]->kind.exp == SingleParamK)
+            addDef(g, g->vars[v], v, v >= g->nLocals ? -1 : g->entry);
+    for (n = 0; n < g->nNodes; n++)
+        collectDefs(g, g->nodes[n].exp, n);
+    g->varDefs = (Bitset *)malloc((g->nVars > 0 ? g->nVars : 1) * sizeof(Bitset));
+    for (v = 0; v < g->nVars; v++)
+        g->varDefs[v] = bsNew(g->nDefs);
+    for (d = 0; d < g->nDefs; d++)
+        bsSet(g->varDefs[g->defVar[d]], d);
+    return g;
+}
+
+/* Procedure freeFlowGraph releases a flow graph */
+void freeFlowGraph(FlowGraph g)
+{
+    int i;
+    if (g == NULL)
+        return;
+    for (i = 0; i < g->nNodes; i++)
+    {
+        free(g->nodes[i].succ);
+        free(g->nodes[i].pred);
+    }
+    for (i = 0; i < FLOW_HASH_SIZE; i++)
+    {
+        FlowVarList l = g->varHash[i];
+        while (l != NULL)
+        {
+            FlowVarList next = l->next;
+            free(l);
+            l = next;
+        }
+    }
+    for (i = 0; i < g->nVars; i++)
+        bsFree(g->varDefs[i]);
+    free(g->varDefs);
+    free(g->nodes);
+    free(g->vars);
+    free(g->defs);
+    free(g->defVar);
+    free(g->defNode);
+    free(g);
+}
+
+/* Function flowVar returns the number of the
+ * scalar declared by decl, or -1
+ */
+int flowVar(FlowGraph g, TreeNode *decl)
+{
+    return isScalarDecl(decl) ? lookup(g, decl) : -1;
+}
+
+/**************************************************/
+/*************   local effects   ******************/
+/**************************************************/
+
+/* walks t in evaluation order */
+static void useDefExp(FlowGraph g, TreeNode *t, Bitset use, Bitset def)
+{
+    TreeNode *c;
+    int i, v;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    switch (t->kind.exp)
+    {
+    case IdK:
+        v = refVar(g, t);
+        if (v >= 0 && !bsTest(def, v))
+            bsSet(use, v);
+        break;
+    case AssignK:
+        if (t->child[0]->kind.exp == ArrayIdK)
+        {
+            useDefExp(g, t->child[0]->child[0], use, def);
+            useDefExp(g, t->child[1], use, def);
+        }
+        else
+        {
+            useDefExp(g, t->child[1], use, def);
+            if ((v = refVar(g, t->child[0])) >= 0)
+                bsSet(def, v);
+        }
+        break;
+    case CallK:
+        for (c = t->child[0]; c != NULL; c = c->sibling)
+            useDefExp(g, c, use, def);
+        /* the callee may read any global */
+        if (isUserCall(t))
+            for (v = g->nLocals; v < g->nVars; v++)
+                if (!bsTest(def, v))
+                    bsSet(use, v);
+        break;
+    default:
+        for (i = 0; i < MAXCHILDREN; i++)
+            useDefExp(g, t->child[i], use, def);
+        break;
+    }
+}
+
+/* Procedure flowUseDef computes the variables node
+ * n reads before writing them (use) and the
+ * variables it surely writes (def)
+ */
+void flowUseDef(FlowGraph g, int n, Bitset use, Bitset def)
+{
+    bsClear(use);
+    bsClear(def);
+    useDefExp(g, g->nodes[n].exp, use, def);
+}
+
+/* the definitions of t that survive to its end */
+static void genKillExp(FlowGraph g, TreeNode *t, Bitset gen, Bitset kill)
+{
+    TreeNode *c;
+    int i, v;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    for (i = 0; i < MAXCHILDREN; i++)
+        for (c = t->child[i]; c != NULL; c = c->sibling)
+            genKillExp(g, c, gen, kill);
+    if (t->kind.exp == AssignK && t->child[0]->kind.exp == IdK)
+    {
+        int d = lookup(g, t);
+        if (d >= 0)
+        {
+            v = g->defVar[d];
+            bsUnion(kill, g->varDefs[v]);
+            bsDiff(gen, g->varDefs[v]);
+            bsSet(gen, d);
+        }
+    }
+    else if (isUserCall(t))
+    {
+        /* a call may leave any global changed
+         * but kills none of its definitions
+         */
+        int d;
+        for (d = 0; d < g->nDefs; d++)
+            if (g->defNode[d] < 0)
+                bsSet(gen, d);
+    }
+}
+
+/**************************************************/
+/*************   solver   *************************/
+/**************************************************/
+
+/* Procedure order lists the nodes in reverse
+ * postorder of a depth-first search from start,
+ * following successors (forward) or predecessors;
+ * nodes the search misses come last
+ */
+static void order(FlowGraph g, int start, int forward, int *rpo)
+{
+    int *stack = (int *)malloc(g->nNodes * sizeof(int));
+    int *next = (int *)calloc(g->nNodes, sizeof(int));
+    char *seen = (char *)calloc(g->nNodes, sizeof(char));
+    int sp = 0, k = g->nNodes, i;
+    stack[sp++] = start;
+    seen[start] = TRUE;
+    while (sp > 0)
+    {
+        int n = stack[sp - 1];
+        FlowNode *fn = &g->nodes[n];
+        int deg = forward ? fn->nsucc : fn->npred;
+        if (next[n] < deg)
+        {
+            int s = forward ? fn->succ[next[n]] : fn->pred[next[n]];
+            next[n]++;
+            if (!seen[s])
+            {
+                seen[s] = TRUE;
+                stack[sp++] = s;
+            }
+        }
+        else
+            rpo[--k] = stack[--sp];
+    }
+    /* unreachable nodes keep their creation order */
+    for (i = g->nNodes - 1; i >= 0; i--)
+        if (!seen[i])
+            rpo[--k] = i;
+    free(stack);
+    free(next);
+    free(seen);
+}
+
+/* Function solveDataflow solves problem p over g
+ * with a worklist seeded in reverse postorder
+ */
+Dataflow solveDataflow(FlowGraph g, DataflowProblem *p)
+{
+    Dataflow d = (Dataflow)malloc(sizeof(struct DataflowRec));
+    int nn = g->nNodes;
+    Bitset *gen = (Bitset *)malloc(nn * sizeof(Bitset));
+    Bitset *kill = (Bitset *)malloc(nn * sizeof(Bitset));
+    Bitset bound = bsNew(p->nbits);
+    int *rpo = (int *)malloc(nn * sizeof(int));
+    int *queue = (int *)malloc((nn + 1) * sizeof(int));
+    char *queued = (char *)malloc(nn * sizeof(char));
+    int head = 0, tail = 0, i;
+    int start = p->forward ? g->entry : g->exit;
+
+    d->nNodes = nn;
+    d->in = (Bitset *)malloc(nn * sizeof(Bitset));
+    d->out = (Bitset *)malloc(nn * sizeof(Bitset));
+    d->visits = 0;
+    for (i = 0; i < nn; i++)
+    {
+        gen[i] = bsNew(p->nbits);
+        kill[i] = bsNew(p->nbits);
+        p->local(g, i, gen[i], kill[i], p->arg);
+        d->in[i] = bsNew(p->nbits);
+        d->out[i] = bsNew(p->nbits);
+        if (!p->meetUnion)
+        {
+            bsFill(d->in[i]);
+            bsFill(d->out[i]);
+        }
+    }
+    if (p->boundary != NULL)
+        p->boundary(g, bound, p->arg);
+
+    order(g, start, p->forward, rpo);
+    for (i = 0; i < nn; i++)
+    {
+        queue[tail++] = rpo[i];
+        queued[rpo[i]] = TRUE;
+    }
+    tail %= nn + 1;
+
+    while (head != tail)
+    {
+        int n = queue[head];
+        FlowNode *fn = &g->nodes[n];
+        /* for a backward problem the roles of in
+         * and out and of succ and pred swap
+         */
+        Bitset before = p->forward ? d->in[n] : d->out[n];
+        Bitset after = p->forward ? d->out[n] : d->in[n];
+        int *from = p->forward ? fn->pred : fn->succ;
+        int nfrom = p->forward ? fn->npred : fn->nsucc;
+        int *to = p->forward ? fn->succ : fn->pred;
+        int nto = p->forward ? fn->nsucc : fn->npred;
+        head = (head + 1) % (nn + 1);
+        queued[n] = FALSE;
+        d->visits++;
+
+        if (n == start)
+            bsCopy(before, bound);
+        else
+        {
+            if (p->meetUnion)
+                bsClear(before);
+            else
+                bsFill(before);
+            for (i = 0; i < nfrom; i++)
+            {
+                Bitset b = p->forward ? d->out[from[i]] : d->in[from[i]];
+                if (p->meetUnion)
+                    bsUnion(before, b);
+                else
+                    bsIntersect(before, b);
+            }
+        }
+        if (bsTransfer(after, gen[n], before, kill[n]))
+            for (i = 0; i < nto; i++)
+                if (!queued[to[i]])
+                {
+                    queued[to[i]] = TRUE;
+                    queue[tail] = to[i];
+                    tail = (tail + 1) % (nn + 1);
+                }
+    }
+
+    for (i = 0; i < nn; i++)
+    {
+        bsFree(gen[i]);
+        bsFree(kill[i]);
+    }
+    free(gen);
+    free(kill);
+    bsFree(bound);
+    free(rpo);
+    free(queue);
+    free(queued);
+    return d;
+}
+
+/* Procedure freeDataflow releases a solution */
+void freeDataflow(Dataflow d)
+{
+    int i;
+    if (d == NULL)
+        return;
+    for (i = 0; i < d->nNodes; i++)
+    {
+        bsFree(d->in[i]);
+        bsFree(d->out[i]);
+    }
+    free(d->in);
+    free(d->out);
+    free(d);
+}
+
+/**************************************************/
+/*************   built-in clients   ***************/
+/**************************************************/
+
+/* liveness: gen is use, kill is def */
+static void liveLocal(FlowGraph g, int n, Bitset gen, Bitset kill, void *arg)
+{
+    (void)arg;
+    flowUseDef(g, n, gen, kill);
+}
+
+/* globals stay live after the function returns */
+static void liveExit(FlowGraph g, Bitset b, void *arg)
+{
+    int v;
+    (void)arg;
+    for (v = g->nLocals; v < g->nVars; v++)
+        bsSet(b, v);
+}
+
+Dataflow liveness(FlowGraph g)
+{
+    DataflowProblem p;
+    p.forward = FALSE;
+    p.meetUnion = TRUE;
+    p.nbits = g->nVars;
+    p.local = liveLocal;
+    p.boundary = liveExit;
+    p.arg = NULL;
+    return solveDataflow(g, &p);
+}
+
+static void reachLocal(FlowGraph g, int n, Bitset gen, Bitset kill, void *arg)
+{
+    (void)arg;
+    genKillExp(g, g->nodes[n].exp, gen, kill);
+}
+
+/* the values of parameters and globals on entry */
+static void reachEntry(FlowGraph g, Bitset b, void *arg)
+{
+    int d;
+    (void)arg;
+    for (d = 0; d < g->nDefs; d++)
+        if (g->defNode[d] < 0 || g->defNode[d] == g->entry)
+            bsSet(b, d);
+}
+
+Dataflow reachingDefs(FlowGraph g)
+{
+    DataflowProblem p;
+    p.forward = TRUE;
+    p.meetUnion = TRUE;
+    p.nbits = g->nDefs;
+    p.local = reachLocal;
+    p.boundary = reachEntry;
+    p.arg = NULL;
+    return solveDataflow(g, &p);
+}
+
+/* definite assignment: gen is def, nothing is killed */
+static void assignLocal(FlowGraph g, int n, Bitset gen, Bitset kill, void *arg)
+{
+    Bitset use = bsNew(g->nVars);
+    (void)kill;
+    (void)arg;
+    flowUseDef(g, n, use, gen);
+    bsFree(use);
+}
+
+/* parameters and globals are assigned on entry */
+static void assignEntry(FlowGraph g, Bitset b, void *arg)
+{
+    int v;
+    (void)arg;
+    for (v = 0; v < g->nVars; v++)
+        if (v >= g->nLocals || g->vars[v]->kind.exp == SingleParamK)
+            bsSet(b, v);
+}
+
+Dataflow definiteAssignment(FlowGraph g)
+{
+    DataflowProblem p;
+    p.forward = TRUE;
+    p.meetUnion = FALSE;
+    p.nbits = g->nVars;
+    p.local = assignLocal;
+    p.boundary = assignEntry;
+    p.arg = NULL;
+    return solveDataflow(g, &p);
+}
+
+/* Procedure checkAssignment warns about every
+ * local variable that may be read before it is
+ * assigned
+ */
+void checkAssignment(TreeNode *syntaxTree)
+{
+    TreeNode *fn;
+    for (fn = syntaxTree; fn != NULL; fn = fn->sibling)
+    {
+        FlowGraph g;
+        Dataflow da;
+        Bitset use, def, warned;
+        int n, v;
+        if (fn->nodekind != StmtK || fn->kind.stmt != FunctionK ||
+            fn->child[2] == NULL)
+            continue;
+        g = buildFlowGraph(fn);
+        da = definiteAssignment(g);
+        use = bsNew(g->nVars);
+        def = bsNew(g->nVars);
+        warned = bsNew(g->nVars);
+        for (n = 0; n < g->nNodes; n++)
+        {
+            flowUseDef(g, n, use, def);
+            bsDiff(use, da->in[n]);
+            bsDiff(use, warned);
+            for (v = bsNext(use, 0); v >= 0; v = bsNext(use, v + 1))
+            {
+                fprintf(listing, "Warning at line %d: %s may be used before it is assigned\n",
+                        g->nodes[n].exp->lineno, g->vars[v]->attr.name);
+                bsSet(warned, v);
+            }
+        }
+        if (TraceAnalyze)
+            fprintf(listing, "Data flow of %s: %d nodes, %d variables, %d definitions, %d visits\n",
+                    fn->attr.name, g->nNodes, g->nVars, g->nDefs, da->visits);
+        bsFree(use);
+        bsFree(def);
+        bsFree(warned);
+        freeDataflow(da);
+        freeFlowGraph(g);
+    }
+}
@@ -0,0 +1,140 @@
+/****************************************************/
+/* File: dataflow.h                                 */
+/* Data-flow analysis framework                     */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _DATAFLOW_H_
+#define _DATAFLOW_H_
+
+#include "bitset.h"
+
+/* FLOW_HASH_SIZE is the size of the variable
+ * hash table of a flow graph
+ */
+#define FLOW_HASH_SIZE 211
+
+typedef enum
+{
+    FlowEntry,  /* function entry */
+    FlowExit,   /* function exit */
+    FlowJoin,   /* merge point after an if, loop head */
+    FlowExp,    /* expression statement */
+    FlowCond,   /* test of an if or while */
+    FlowReturn  /* return statement */
+} FlowKind;
+
+/* a node of the statement-level flow graph.
+ * stmt is the statement the node comes from and
+ * exp the expression it evaluates, if any
+ */
+typedef struct
+{
+    FlowKind kind;
+    TreeNode *stmt;
+    TreeNode *exp;
+    int nsucc, maxSucc;
+    int *succ;
+    int npred, maxPred;
+    int *pred;
+} FlowNode;
+
+/* The flow graph of one function.
+ * The scalars the function refers to are numbered
+ * 0..nVars-1: parameters and locals first, then
+ * globals. Definitions are numbered 0..nDefs-1.
+ * defs[d] is the AssignK node of an assignment, or
+ * the declaration itself for the value a parameter
+ * or global has on entry or a global has after
+ * a call
+ */
+typedef struct FlowGraphRec
+{
+    TreeNode *fn;
+    int entry, exit;
+    int nNodes, maxNodes;
+    FlowNode *nodes;
+    int nVars, maxVars;
+    TreeNode **vars;
+    int nLocals; /* vars[nLocals..] are globals */
+    int nDefs, maxDefs;
+    TreeNode **defs;
+    int *defVar;
+    int *defNode;    /* -1 for the values of globals after a call */
+    Bitset *varDefs; /* definitions of every variable */
+    struct FlowVarRec *varHash[FLOW_HASH_SIZE];
+} * FlowGraph;
+
+/* Function buildFlowGraph builds the flow graph of
+ * the FunctionK node fn from its IfK, WhileK,
+ * CompoundK and ReturnK structure
+ */
+FlowGraph buildFlowGraph(TreeNode *fn);
+
+/* Procedure freeFlowGraph releases a flow graph */
+void freeFlowGraph(FlowGraph g);
+
+/* Function flowVar returns the number of the
+ * scalar declared by decl, or -1
+ */
+int flowVar(FlowGraph g, TreeNode *decl);
+
+/* Procedure flowUseDef computes the variables node
+ * n reads before writing them (use) and the
+ * variables it surely writes (def)
+ */
+void flowUseDef(FlowGraph g, int n, Bitset use, Bitset def);
+
+/* A gen/kill data-flow problem. The solver calls
+ * local once for every node and boundary once for
+ * the value at the entry (forward problems) or at
+ * the exit (backward problems)
+ */
+typedef struct
+{
+    int forward;   /* TRUE for forward problems */
+    int meetUnion; /* TRUE for union, FALSE for intersection */
+    int nbits;
+    void (*local)(FlowGraph g, int n, Bitset gen, Bitset kill, void *arg);
+    void (*boundary)(FlowGraph g, Bitset b, void *arg);
+    void *arg;
+} DataflowProblem;
+
+/* The solution of a problem: in[n] holds just
+ * before node n and out[n] just after it, in
+ * program order for either direction
+ */
+typedef struct DataflowRec
+{
+    int nNodes;
+    Bitset *in;
+    Bitset *out;
+    int visits; /* nodes taken from the worklist */
+} * Dataflow;
+
+/* Function solveDataflow solves problem p over g
+ * with a worklist seeded in reverse postorder
+ */
+Dataflow solveDataflow(FlowGraph g, DataflowProblem *p);
+
+/* Procedure freeDataflow releases a solution */
+void freeDataflow(Dataflow d);
+
+/* Built-in clients.
+ * liveness: bits are variables, in[n] holds the
+ * variables live before n.
+ * reachingDefs: bits are definitions.
+ * definiteAssignment: bits are variables, in[n]
+ * holds the variables assigned on every path to n
+ */
+Dataflow liveness(FlowGraph g);
+Dataflow reachingDefs(FlowGraph g);
+Dataflow definiteAssignment(FlowGraph g);
+
+/* Procedure checkAssignment warns about every
+ * local variable that may be read before it is
+ * assigned
+ */
+void checkAssignment(TreeNode *syntaxTree);
+
+#endif
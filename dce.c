@@ -0,0 +1,209 @@
+/****************************************************/
+/* File: dce.c                                      */
+/* Dead code and dead store elimination             */
+/* for the TINY compiler                            */
+/* A dead store whose right-hand side calls a       */
+/* function or assigns is replaced by that right-   */
+/* hand side, so every effect is kept               */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "alias.h"
+#include "dataflow.h"
+#include "dce.h"
+
+static int nUnreachable; /* statements after a return */
+static int nPruned;      /* branches and loops removed */
+static int nStores;      /* dead stores removed */
+
+/* an empty statement */
+static void makeEmpty(TreeNode *t)
+{
+    int i;
+    for (i = 0; i < MAXCHILDREN; i++)
+        t->child[i] = NULL;
+    t->nodekind = StmtK;
+    t->kind.stmt = CompoundK;
+    t->scope = NULL;
+}
+
+static int isEmpty(TreeNode *t)
+{
+    return t == NULL ||
+           (t->nodekind == StmtK && t->kind.stmt == CompoundK &&
+            t->child[0] == NULL && t->child[1] == NULL);
+}
+
+/* Function completes returns FALSE if control can
+ * never leave statement t to the next one
+ */
+static int completes(TreeNode *t)
+{
+    TreeNode *s;
+    if (t->nodekind == ExpK)
+        return TRUE;
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        for (s = t->child[1]; s != NULL; s = s->sibling)
+            if (!completes(s))
+                return FALSE;
+        return TRUE;
+    case IfK:
+        return t->child[2] == NULL ||
+               completes(t->child[1]) || completes(t->child[2]);
+    case WhileK:
+        return !isConst(t->child[0]) || t->child[0]->attr.val == 0;
+    case ReturnK:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+static int countStmts(TreeNode *t)
+{
+    int n = 0;
+    for (; t != NULL; t = t->sibling)
+        n++;
+    return n;
+}
+
+static void pruneList(TreeNode **list);
+
+/* Procedure pruneStmt removes the unreachable code
+ * of statement t, replacing t in place
+ */
+static void pruneStmt(TreeNode *t)
+{
+    if (t->nodekind == ExpK)
+        return;
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        pruneList(&t->child[1]);
+        break;
+    case IfK:
+        pruneStmt(t->child[1]);
+        if (t->child[2] != NULL)
+            pruneStmt(t->child[2]);
+        if (isConst(t->child[0]))
+        {
+            TreeNode *taken = t->child[0]->attr.val ? t->child[1] : t->child[2];
+            if (taken != NULL)
+                replaceNode(t, taken);
+            else
+                makeEmpty(t);
+            nPruned++;
+        }
+        else if (isEmpty(t->child[1]) && isEmpty(t->child[2]) &&
+                 isPureExp(t->child[0]))
+        {
+            makeEmpty(t);
+            nPruned++;
+        }
+        break;
+    case WhileK:
+        pruneStmt(t->child[1]);
+        if (isConst(t->child[0]) && t->child[0]->attr.val == 0)
+        {
+            makeEmpty(t);
+            nPruned++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Procedure pruneList prunes the statement list
+ * *list, unlinking empty statements and everything
+ * after a statement that cannot complete
+ */
+static void pruneList(TreeNode **list)
+{
+    TreeNode *t;
+    while ((t = *list) != NULL)
+    {
+        pruneStmt(t);
+        if (isEmpty(t))
+        {
+            *list = t->sibling;
+            continue;
+        }
+        if (!completes(t) && t->sibling != NULL)
+        {
+            nUnreachable += countStmts(t->sibling);
+            t->sibling = NULL;
+        }
+        list = &t->sibling;
+    }
+}
+
+/**************************************************/
+/*************   dead stores   ********************/
+/**************************************************/
+
+/* Procedure removeStores removes the assignments
+ * made by expression statements to locals that
+ * are dead after them
+ */
+static void removeStores(TreeNode *fn)
+{
+    FlowGraph graph = buildFlowGraph(fn);
+    Dataflow live = liveness(graph);
+    int n, v;
+    for (n = 0; n < graph->nNodes; n++)
+    {
+        TreeNode *t = graph->nodes[n].exp;
+        if (graph->nodes[n].kind != FlowExp)
+            continue;
+        /* the store is the last thing the statement
+         * does, so only later statements can read it
+         */
+        while (t->nodekind == ExpK && t->kind.exp == AssignK &&
+               t->child[0]->kind.exp == IdK &&
+               (v = flowVar(graph, declOf(t->child[0]))) >= 0 &&
+               v < graph->nLocals && !bsTest(live->out[n], v))
+        {
+            if (isPureExp(t->child[1]))
+                makeEmpty(t);
+            else
+                replaceNode(t, t->child[1]);
+            nStores++;
+        }
+    }
+    freeDataflow(live);
+    freeFlowGraph(graph);
+}
+
+/* Function deadCodeElim removes statements that
+ * follow a return, branches and loops constant
+ * tests never enter, and assignments to locals
+ * that are never read again, until nothing changes,
+ * and returns the number of statements removed
+ */
+int deadCodeElim(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int before;
+    nUnreachable = nPruned = nStores = 0;
+    do
+    {
+        before = nUnreachable + nPruned + nStores;
+        for (t = syntaxTree; t != NULL; t = t->sibling)
+            if (t->nodekind == StmtK && t->kind.stmt == FunctionK &&
+                t->child[2] != NULL)
+            {
+                removeStores(t);
+                pruneStmt(t->child[2]);
+            }
+    } while (nUnreachable + nPruned + nStores != before);
+    if (TraceAnalyze)
+        fprintf(listing, "\nDead code elimination: %d unreachable statements, "
+                         "%d branches and %d dead stores removed\n",
+                nUnreachable, nPruned, nStores);
+    return nUnreachable + nPruned + nStores;
+}
@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: dce.h                                      */
+/* Dead code and dead store elimination             */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _DCE_H_
+#define _DCE_H_
+
+/* Function deadCodeElim removes statements that
+ * follow a return, branches and loops constant
+ * tests never enter, and assignments to locals
+ * that are never read again, until nothing changes,
+ * and returns the number of statements removed
+ */
+int deadCodeElim(TreeNode *syntaxTree);
+
+#endif
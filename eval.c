@@ -0,0 +1,340 @@
+/****************************************************/
+/* File: eval.c                                     */
+/* Compile-time evaluation of calls                 */
+/* for the TINY compiler                            */
+/* An interpreter over the analyzed syntax tree     */
+/* runs calls on a stack of frames laid out as the  */
+/* symbol table places them, with the arithmetic of */
+/* the TM. It gives up on globals, input, output,   */
+/* reads of unset words, subscripts out of bounds   */
+/* and traps, so a run it completes is the run the  */
+/* TM would make                                    */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "cgen.h"
+#include "fold.h"
+#include "eval.h"
+
+/* MAX_STEPS bounds the nodes one evaluation runs,
+ * MAX_TOTAL those all evaluations of the program run
+ */
+#define MAX_STEPS 100000
+#define MAX_TOTAL 2000000
+
+/* MAX_CALLS bounds the depth of nested calls */
+#define MAX_CALLS 200
+
+/* MAX_WORDS is the memory the frames may take */
+#define MAX_WORDS 1024
+
+/* how running a statement ends */
+typedef enum
+{
+    Completed,
+    Returned,
+    Failed
+} Outcome;
+
+static int mem[MAX_WORDS];
+static char isSet[MAX_WORDS]; /* the word holds a value */
+static int base;              /* frame of the running function */
+static int top;               /* first free word */
+static int depth;             /* calls running */
+static long steps;            /* nodes run by this evaluation */
+static long total;            /* nodes run by all evaluations */
+static int result;            /* value of the last return */
+
+/* the functions evaluations ran */
+static int nEvaluated, maxEvaluated;
+static TreeNode **evaluated;
+
+/* Function step counts a node run and returns
+ * FALSE once the budgets are spent
+ */
+static int step(void)
+{
+    return ++steps <= MAX_STEPS && ++total <= MAX_TOTAL;
+}
+
+static int evalExp(TreeNode *t, int *val);
+
+/* Function local returns the declaration of the
+ * local or parameter t refers to, or NULL
+ */
+static TreeNode *local(TreeNode *t)
+{
+    TreeNode *d = t->bucket != NULL ? t->bucket->treeNode : NULL;
+    if (d == NULL || d->nodekind != ExpK || d->scope == globalScope)
+        return NULL;
+    return d;
+}
+
+/* Function arrayOf finds the first word and the
+ * length of the array the IdK or ArrayIdK node t
+ * names
+ */
+static int arrayOf(TreeNode *t, int *addr, int *length)
+{
+    TreeNode *d = local(t);
+    int loc;
+    if (d == NULL)
+        return FALSE;
+    loc = base + t->bucket->memloc;
+    if (d->kind.exp == VarArrayK)
+    {
+        *addr = loc;
+        *length = d->attr.arr.length;
+        return TRUE;
+    }
+    if (d->kind.exp == ArrayParamK)
+    {
+        *addr = mem[loc];
+        *length = mem[loc + 1];
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Function address finds the word the variable or
+ * array element t refers to
+ */
+static int address(TreeNode *t, int *addr)
+{
+    TreeNode *d = local(t);
+    int first, length, i;
+    if (d == NULL)
+        return FALSE;
+    if (t->kind.exp == IdK)
+    {
+        if (d->kind.exp != VarK && d->kind.exp != SingleParamK)
+            return FALSE;
+        *addr = base + t->bucket->memloc;
+        return TRUE;
+    }
+    if (t->kind.exp != ArrayIdK || !arrayOf(t, &first, &length) ||
+        !evalExp(t->child[0], &i) || i < 0 || i >= length)
+        return FALSE;
+    *addr = first + i;
+    return TRUE;
+}
+
+static Outcome execStmt(TreeNode *t);
+
+/* Procedure ran records that fn ran to its end */
+static void ran(TreeNode *fn)
+{
+    int i;
+    for (i = 0; i < nEvaluated; i++)
+        if (evaluated[i] == fn)
+            return;
+    if (nEvaluated == maxEvaluated)
+    {
+        maxEvaluated = maxEvaluated ? 2 * maxEvaluated : 16;
+        evaluated = realloc(evaluated, maxEvaluated * sizeof(TreeNode *));
+    }
+    evaluated[nEvaluated++] = fn;
+}
+
+/* Function callFunction runs the call in a new
+ * frame on top of the stack
+ */
+static int callFunction(TreeNode *call, int *val)
+{
+    TreeNode *fn, *formal, *arg;
+    int frame = top, saved = base, size, loc, ok = TRUE;
+    Outcome out;
+    if (!isUserCall(call) || depth == MAX_CALLS)
+        return FALSE;
+    fn = call->bucket->treeNode;
+    size = frameSize(fn);
+    if (frame + size > MAX_WORDS)
+        return FALSE;
+    memset(isSet + frame, 0, size);
+    /* the arguments run in the caller's frame, calls
+     * among them above the new one
+     */
+    top = frame + size;
+    formal = fn->child[1];
+    for (arg = call->child[0]; ok && arg != NULL; arg = arg->sibling, formal = formal->sibling)
+    {
+        loc = frame + formal->bucket->memloc;
+        if (formal->kind.exp == ArrayParamK)
+        {
+            ok = arg->kind.exp == IdK && arrayOf(arg, &mem[loc], &mem[loc + 1]);
+            isSet[loc + 1] = TRUE;
+        }
+        else
+            ok = evalExp(arg, &mem[loc]);
+        isSet[loc] = TRUE;
+    }
+    if (ok)
+    {
+        base = frame;
+        depth++;
+        out = execStmt(fn->child[2]);
+        depth--;
+        base = saved;
+        if (out == Failed || (out == Completed && fn->child[0]->type != Void))
+            ok = FALSE;
+        *val = out == Returned ? result : 0;
+    }
+    top = frame;
+    if (ok)
+        ran(fn);
+    return ok;
+}
+
+/* Function evalExp runs the expression t into val */
+static int evalExp(TreeNode *t, int *val)
+{
+    int a, b, addr;
+    if (!step() || t->nodekind != ExpK)
+        return FALSE;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        *val = t->attr.val;
+        return TRUE;
+    case IdK:
+    case ArrayIdK:
+        if (!address(t, &addr) || !isSet[addr])
+            return FALSE;
+        *val = mem[addr];
+        return TRUE;
+    case OpK:
+        return evalExp(t->child[0], &a) && evalExp(t->child[1], &b) &&
+               evalOp(t->attr.op, a, b, val);
+    case AssignK:
+        /* the element address is computed first */
+        if (!address(t->child[0], &addr) || !evalExp(t->child[1], val))
+            return FALSE;
+        mem[addr] = *val;
+        isSet[addr] = TRUE;
+        return TRUE;
+    case CallK:
+        return callFunction(t, val);
+    default:
+        return FALSE;
+    }
+}
+
+/* Function execStmt runs the statements t */
+static Outcome execStmt(TreeNode *t)
+{
+    Outcome out;
+    int val;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK)
+        {
+            if (!evalExp(t, &val))
+                return Failed;
+            continue;
+        }
+        if (!step())
+            return Failed;
+        out = Completed;
+        switch (t->kind.stmt)
+        {
+        case CompoundK:
+            out = execStmt(t->child[1]);
+            break;
+        case IfK:
+            if (!evalExp(t->child[0], &val))
+                return Failed;
+            out = execStmt(val ? t->child[1] : t->child[2]);
+            break;
+        case WhileK:
+            while (out == Completed)
+            {
+                if (!evalExp(t->child[0], &val))
+                    return Failed;
+                if (!val)
+                    break;
+                out = execStmt(t->child[1]);
+            }
+            break;
+        case ReturnK:
+            if (t->child[0] != NULL && !evalExp(t->child[0], &result))
+                return Failed;
+            return Returned;
+        default:
+            return Failed;
+        }
+        if (out != Completed)
+            return out;
+    }
+    return Completed;
+}
+
+/* Function evalCall runs the call of a user
+ * function whose arguments are all constants and
+ * returns TRUE with its value in val (0 for a void
+ * function) if the run neither depends on nor
+ * changes anything but its own frames, and ends
+ * within the step and call depth budgets
+ */
+int evalCall(TreeNode *call, int *val)
+{
+    TreeNode *arg;
+    if (!isUserCall(call))
+        return FALSE;
+    for (arg = call->child[0]; arg != NULL; arg = arg->sibling)
+        if (arg->nodekind != ExpK || arg->kind.exp != ConstK)
+            return FALSE;
+    base = top = depth = 0;
+    steps = 0;
+    return callFunction(call, val);
+}
+
+/* Function callers counts the calls of fn in the
+ * code t made by other functions
+ */
+static int callers(TreeNode *t, TreeNode *fn)
+{
+    int n = 0, i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t == fn)
+            continue;
+        if (isUserCall(t) && t->bucket->treeNode == fn)
+            n++;
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += callers(t->child[i], fn);
+    }
+    return n;
+}
+
+/* Function removeEvaluated unlinks the functions
+ * evalCall ran that are left without callers and
+ * returns their number
+ */
+int removeEvaluated(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int i, n = 0, removed, wasRun;
+    do
+    {
+        removed = FALSE;
+        for (t = syntaxTree; t->sibling != NULL;)
+        {
+            wasRun = FALSE;
+            for (i = 0; i < nEvaluated; i++)
+                wasRun = wasRun || evaluated[i] == t->sibling;
+            if (wasRun && strcmp(t->sibling->attr.name, "main") != 0 &&
+                callers(syntaxTree, t->sibling) == 0)
+            {
+                t->sibling = t->sibling->sibling;
+                removed = TRUE;
+                n++;
+            }
+            else
+                t = t->sibling;
+        }
+    } while (removed);
+    return n;
+}
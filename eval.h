@@ -0,0 +1,25 @@
+/****************************************************/
+/* File: eval.h                                     */
+/* Compile-time evaluation of calls                 */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _EVAL_H_
+#define _EVAL_H_
+
+/* Function evalCall runs the call of a user
+ * function whose arguments are all constants and
+ * returns TRUE with its value in val (0 for a void
+ * function) if the run neither depends on nor
+ * changes anything but its own frames, and ends
+ * within the step and call depth budgets
+ */
+int evalCall(TreeNode *call, int *val);
+
+/* Function removeEvaluated unlinks the functions
+ * evalCall ran that are left without callers and
+ * returns their number
+ */
+int removeEvaluated(TreeNode *syntaxTree);
+
+#endif
@@ -0,0 +1,340 @@
+/****************************************************/
+/* File: fold.c                                     */
+/* Constant folding and propagation                 */
+/* for the TINY compiler                            */
+/* Arithmetic follows the TM: ints wrap around and  */
+/* division truncates; a division that would trap   */
+/* is left for run time                             */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "alias.h"
+#include "dataflow.h"
+#include "eval.h"
+#include "fold.h"
+
+/* MAX_ROUNDS bounds the fold and propagate rounds */
+#define MAX_ROUNDS 10
+
+static int nFolded;     /* operators folded or simplified */
+static int nEvaluated;  /* calls evaluated */
+static int nPropagated; /* reads replaced by constants */
+static int nPruned;     /* branches and loops removed */
+
+static void makeConst(TreeNode *t, int val)
+{
+    int i;
+    for (i = 0; i < MAXCHILDREN; i++)
+        t->child[i] = NULL;
+    t->nodekind = ExpK;
+    t->kind.exp = ConstK;
+    t->attr.val = val;
+    t->bucket = NULL;
+}
+
+/* an empty statement */
+static void makeEmpty(TreeNode *t)
+{
+    int i;
+    for (i = 0; i < MAXCHILDREN; i++)
+        t->child[i] = NULL;
+    t->nodekind = StmtK;
+    t->kind.stmt = CompoundK;
+    t->scope = NULL;
+}
+
+/* Function evalOp computes a op b into val and
+ * returns FALSE if the TM would trap
+ */
+int evalOp(TokenType op, int a, int b, int *val)
+{
+    unsigned int ua = (unsigned int)a, ub = (unsigned int)b;
+    switch (op)
+    {
+    case PLUS:
+        *val = (int)(ua + ub);
+        break;
+    case MINUS:
+        *val = (int)(ua - ub);
+        break;
+    case TIMES:
+        *val = (int)(ua * ub);
+        break;
+    case OVER:
+        if (b == 0 || (a == INT_MIN && b == -1))
+            return FALSE;
+        *val = a / b;
+        break;
+    case LT:
+        *val = a < b;
+        break;
+    case LE:
+        *val = a <= b;
+        break;
+    case GT:
+        *val = a > b;
+        break;
+    case GE:
+        *val = a >= b;
+        break;
+    case EQ:
+        *val = a == b;
+        break;
+    case NE:
+        *val = a != b;
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Procedure foldExp folds the expression t bottom up */
+static void foldExp(TreeNode *t)
+{
+    TreeNode *l, *r, *c;
+    int i, val;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    for (i = 0; i < MAXCHILDREN; i++)
+        for (c = t->child[i]; c != NULL; c = c->sibling)
+            foldExp(c);
+    if (t->kind.exp == CallK && evalCall(t, &val))
+    {
+        makeConst(t, val);
+        nEvaluated++;
+        return;
+    }
+    if (t->kind.exp != OpK)
+        return;
+    l = t->child[0];
+    r = t->child[1];
+    if (isConst(l) && isConst(r))
+    {
+        if (evalOp(t->attr.op, l->attr.val, r->attr.val, &val))
+        {
+            makeConst(t, val);
+            nFolded++;
+        }
+    }
+    /* x+0, 0+x, x-0, x*1, 1*x and x/1 are x */
+    else if ((isConst(r) && r->attr.val == 0 &&
+              (t->attr.op == PLUS || t->attr.op == MINUS)) ||
+             (isConst(r) && r->attr.val == 1 &&
+              (t->attr.op == TIMES || t->attr.op == OVER)))
+    {
+        replaceNode(t, l);
+        nFolded++;
+    }
+    else if (isConst(l) && ((l->attr.val == 0 && t->attr.op == PLUS) ||
+                            (l->attr.val == 1 && t->attr.op == TIMES)))
+    {
+        replaceNode(t, r);
+        nFolded++;
+    }
+    /* x*0 and 0*x are 0 if x has no effect */
+    else if (t->attr.op == TIMES &&
+             ((isConst(r) && r->attr.val == 0 && isPureExp(l)) ||
+              (isConst(l) && l->attr.val == 0 && isPureExp(r))))
+    {
+        makeConst(t, 0);
+        nFolded++;
+    }
+}
+
+/* Procedure foldStmt folds the expressions of the
+ * statements t and removes the branches their
+ * constant tests never take
+ */
+static void foldStmt(TreeNode *t)
+{
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK)
+        {
+            foldExp(t);
+            /* a statement left a constant does nothing */
+            if (isConst(t))
+                makeEmpty(t);
+            continue;
+        }
+        switch (t->kind.stmt)
+        {
+        case CompoundK:
+            foldStmt(t->child[1]);
+            break;
+        case IfK:
+            foldExp(t->child[0]);
+            foldStmt(t->child[1]);
+            foldStmt(t->child[2]);
+            if (isConst(t->child[0]))
+            {
+                TreeNode *taken = t->child[0]->attr.val ? t->child[1] : t->child[2];
+                if (taken != NULL)
+                    replaceNode(t, taken);
+                else
+                    makeEmpty(t);
+                nPruned++;
+            }
+            break;
+        case WhileK:
+            foldExp(t->child[0]);
+            foldStmt(t->child[1]);
+            if (isConst(t->child[0]) && t->child[0]->attr.val == 0)
+            {
+                makeEmpty(t);
+                nPruned++;
+            }
+            break;
+        case ReturnK:
+            foldExp(t->child[0]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**************************************************/
+/*************   propagation   ********************/
+/**************************************************/
+
+static FlowGraph graph;
+static Dataflow reach;
+static Dataflow assignedIn; /* definite assignment */
+static Bitset assigned; /* variables written earlier in the node */
+static Bitset defs;
+static int callSeen;    /* a call was made earlier in the node */
+
+/* Function constValue finds the value every
+ * definition in defs assigns, returning FALSE if
+ * there is none or they differ
+ */
+static int constValue(int *val)
+{
+    int d = bsNext(defs, 0), found = FALSE;
+    for (; d >= 0; d = bsNext(defs, d + 1))
+    {
+        TreeNode *def = graph->defs[d];
+        if (def->nodekind != ExpK || def->kind.exp != AssignK ||
+            !isConst(def->child[1]))
+            return FALSE;
+        if (found && def->child[1]->attr.val != *val)
+            return FALSE;
+        *val = def->child[1]->attr.val;
+        found = TRUE;
+    }
+    return found;
+}
+
+/* walks t in evaluation order, replacing each read
+ * reached only by definitions of one constant
+ */
+static void propagateExp(TreeNode *t, int n)
+{
+    TreeNode *c;
+    int i, v, val;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    switch (t->kind.exp)
+    {
+    case IdK:
+        v = flowVar(graph, declOf(t));
+        /* reads that may see an unassigned local keep
+         * whatever the frame holds
+         */
+        if (v < 0 || bsTest(assigned, v) || (callSeen && v >= graph->nLocals) ||
+            !bsTest(assignedIn->in[n], v))
+            break;
+        bsCopy(defs, reach->in[n]);
+        bsIntersect(defs, graph->varDefs[v]);
+        if (constValue(&val))
+        {
+            makeConst(t, val);
+            nPropagated++;
+        }
+        break;
+    case AssignK:
+        if (t->child[0]->kind.exp == ArrayIdK)
+        {
+            propagateExp(t->child[0]->child[0], n);
+            propagateExp(t->child[1], n);
+        }
+        else
+        {
+            propagateExp(t->child[1], n);
+            if ((v = flowVar(graph, declOf(t->child[0]))) >= 0)
+                bsSet(assigned, v);
+        }
+        break;
+    case CallK:
+        for (c = t->child[0]; c != NULL; c = c->sibling)
+            propagateExp(c, n);
+        if (isUserCall(t))
+            callSeen = TRUE;
+        break;
+    default:
+        for (i = 0; i < MAXCHILDREN; i++)
+            propagateExp(t->child[i], n);
+        break;
+    }
+}
+
+static void propagate(TreeNode *fn)
+{
+    int n;
+    graph = buildFlowGraph(fn);
+    reach = reachingDefs(graph);
+    assignedIn = definiteAssignment(graph);
+    assigned = bsNew(graph->nVars);
+    defs = bsNew(graph->nDefs);
+    for (n = 0; n < graph->nNodes; n++)
+    {
+        bsClear(assigned);
+        callSeen = FALSE;
+        propagateExp(graph->nodes[n].exp, n);
+    }
+    bsFree(assigned);
+    bsFree(defs);
+    freeDataflow(reach);
+    freeDataflow(assignedIn);
+    freeFlowGraph(graph);
+}
+
+/* Function constantFold folds operators on
+ * constants, evaluates the calls with constant
+ * arguments that evalCall can run, replaces reads
+ * of scalars whose every reaching definition
+ * assigns the same constant, and removes the
+ * branches constant tests can never take, until
+ * nothing changes, and returns the number of
+ * changes
+ */
+int constantFold(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int round, before, removed;
+    nFolded = nEvaluated = nPropagated = nPruned = 0;
+    for (round = 0; round < MAX_ROUNDS; round++)
+    {
+        before = nFolded + nEvaluated + nPropagated + nPruned;
+        for (t = syntaxTree; t != NULL; t = t->sibling)
+            if (t->nodekind == StmtK && t->kind.stmt == FunctionK)
+            {
+                foldStmt(t->child[2]);
+                propagate(t);
+            }
+        if (nFolded + nEvaluated + nPropagated + nPruned == before)
+            break;
+    }
+    removed = removeEvaluated(syntaxTree);
+    if (TraceAnalyze)
+        fprintf(listing, "\nConstant folding: %d operators folded, %d calls evaluated, "
+                         "%d reads replaced by constants, %d branches removed, "
+                         "%d functions removed\n",
+                nFolded, nEvaluated, nPropagated, nPruned, removed);
+    return nFolded + nEvaluated + nPropagated + nPruned + removed;
+}
@@ -0,0 +1,26 @@
+/****************************************************/
+/* File: fold.h                                     */
+/* Constant folding and propagation                 */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* Function evalOp computes a op b into val and
+ * returns FALSE if the TM would trap
+ */
+int evalOp(TokenType op, int a, int b, int *val);
+
+/* Function constantFold folds operators on
+ * constants, evaluates the calls with constant
+ * arguments that evalCall can run, replaces reads
+ * of scalars whose every reaching definition
+ * assigns the same constant, and removes the
+ * branches constant tests can never take, until
+ * nothing changes, and returns the number of
+ * changes
+ */
+int constantFold(TreeNode *syntaxTree);
+
+#endif
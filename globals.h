@@ -55,6 +55,7 @@ typedef int TokenType;
 extern FILE *source;  /* source code text file */
 extern FILE *listing; /* listing output text file */
 extern FILE *code;    /* code text file for TM simulator */
+extern FILE *map;     /* profile map of the code file, or NULL */
 
 extern int lineno; /* source line number for listing */
 
@@ -134,6 +135,8 @@ typedef struct treeNode
     } attr;
     ExpType type; /* for type checking of exps */
     struct ScopeListRec *scope;
+    struct BucketListRec *bucket; /* symbol declared, or referenced by ids and calls */
+    int id; /* number in the parsed tree, kept by copies; 0 for new nodes */
 } TreeNode;
 
 /**************************************************/
@@ -168,6 +171,57 @@ extern int TraceAnalyze;
  */
 extern int TraceCode;
 
+/* CheckBounds = TRUE causes a bounds check to be
+ * generated for every array subscript that the
+ * range analysis cannot prove to be in bounds
+ */
+extern int CheckBounds;
+
+/* GenIR = TRUE causes code to be generated from
+ * the three-address IR instead of the syntax tree
+ */
+extern int GenIR;
+
+/* TraceIR = TRUE causes the IR to be printed to
+ * the listing file
+ */
+extern int TraceIR;
+
+/* Optimize = TRUE causes the optimization passes
+ * of the -O level to be run and the code generators
+ * to optimize
+ */
+extern int Optimize;
+
+/* OptimizeSize = TRUE (-Os) leaves out the
+ * optimizations that make the code larger
+ */
+extern int OptimizeSize;
+
+/* CycleCost = TRUE causes the cost models that
+ * choose between instruction sequences to weigh
+ * each TM instruction by the cycles the simulator
+ * charges for it instead of counting it
+ */
+extern int CycleCost;
+
+/* InlineLimit is the code growth, in estimated TM
+ * instructions, the inliner accepts for a call
+ * outside loops; calls in loops may grow more
+ */
+extern int InlineLimit;
+
+/* UnrollFactor is the number of trips of a counted
+ * loop the unroller runs per test; 1 turns partial
+ * unrolling off
+ */
+extern int UnrollFactor;
+
+/* MemoSize is the number of results kept for each
+ * memoized function; 0 turns memoization off
+ */
+extern int MemoSize;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error;
 #endif
@@ -0,0 +1,850 @@
+/****************************************************/
+/* File: gvn.c                                      */
+/* Value numbering on the IR                        */
+/* for the TINY compiler                            */
+/* The blocks are visited down the dominator tree,  */
+/* and an expression equal to one available from a  */
+/* dominating block reads the register of the first */
+/* instead. Loads are keyed by the version of what  */
+/* they read: a store starts a new version of what  */
+/* it may write, as does a call to a function that  */
+/* may write it, and a join any of whose paths from */
+/* the dominator may write it. A value reused in    */
+/* another block lives in the frame, so that is     */
+/* only done when it saves more than the loads.     */
+/* Code from the tree code generator, which has no  */
+/* IR, is not numbered                              */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "bitset.h"
+#include "code.h"
+#include "ir.h"
+#include "irtm.h"
+#include "gvn.h"
+
+/* HASH_SIZE is the size of the expression table */
+#define HASH_SIZE 211
+
+/* an available expression */
+typedef struct
+{
+    IrOp op;
+    int a, b, imm;
+    TreeNode *sym;
+    int version;
+    int reg;        /* register holding the value */
+    IrBlock *block; /* block computing it */
+    int calls;      /* calls of the block before it */
+    int hash;
+    int next;       /* next entry of the bucket */
+} Expr;
+
+static Expr *exprs;
+static int nExprs, maxExprs;
+static int bucket[HASH_SIZE];
+
+/* what a function may write, with its callees */
+typedef struct
+{
+    TreeNode *fn;
+    int globals; /* global scalars */
+    int arrays;
+} Effect;
+
+static Effect *effects;
+static int nEffects;
+
+static IrFunc *func;
+static IrBlock **order; /* reverse postorder */
+static int nOrder;
+static int *rpoNum;     /* position in order, by block id */
+static IrBlock **idom;  /* by block id */
+static int *seen;       /* by block id */
+static int stamp;
+
+/* the variables and arrays the function reads or writes */
+static TreeNode **locs;
+static int nLocs, maxLocs;
+static int *version;  /* current version of every location */
+static Bitset *kills; /* locations each block may write, by id */
+
+static int *defs;        /* definitions of every register */
+static IrInst **defInst; /* the definition, if only one */
+static IrBlock **defBlock;
+static int *useCount;    /* reads of every register */
+static int *inFrame;     /* TRUE if kept in the frame */
+static int *callsAt;     /* calls of its block before the definition */
+static int *repl;        /* register reused instead, or NO_REG */
+static int *same;        /* earlier register of the same value */
+static int *uses, maxUses;
+
+static int nExpr, nLoads, nChecks;
+
+/* the block being numbered: the calls and the
+ * position reached, and after every position the
+ * number of its values held in TM registers
+ */
+static int calls;
+static int position;
+static int *liveAfter;
+static int *defAt, *lastAt; /* positions, by register */
+
+static int isArray(TreeNode *d)
+{
+    return d->kind.exp == VarArrayK || d->kind.exp == ArrayParamK;
+}
+
+static int isGlobalScalar(TreeNode *d)
+{
+    return d->scope == globalScope && !isArray(d);
+}
+
+static int readsOf(IrInst *i)
+{
+    if (irMaxUses(i) > maxUses)
+    {
+        maxUses = irMaxUses(i);
+        uses = realloc(uses, maxUses * sizeof(int));
+    }
+    return irUses(i, uses);
+}
+
+/**************************************************/
+/*************   effects of calls   ***************/
+/**************************************************/
+
+static Effect *effectOf(TreeNode *fn)
+{
+    int k;
+    for (k = 0; k < nEffects; k++)
+        if (effects[k].fn == fn)
+            return &effects[k];
+    return NULL;
+}
+
+/* Procedure findEffects finds what every function
+ * may write, directly or through its callees
+ */
+static void findEffects(IrFunc *prog)
+{
+    IrFunc *f;
+    IrBlock *b;
+    IrInst *i;
+    Effect *e, *c;
+    int changed;
+    nEffects = 0;
+    for (f = prog; f != NULL; f = f->next)
+        nEffects++;
+    effects = realloc(effects, (nEffects > 0 ? nEffects : 1) * sizeof(Effect));
+    nEffects = 0;
+    for (f = prog; f != NULL; f = f->next)
+    {
+        e = &effects[nEffects++];
+        e->fn = f->fn;
+        e->globals = e->arrays = FALSE;
+        for (b = f->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = i->next)
+                if (i->op == IrStore && isGlobalScalar(i->sym))
+                    e->globals = TRUE;
+                else if (i->op == IrStoreX || i->op == IrStoreP)
+                    e->arrays = TRUE;
+    }
+    do
+    {
+        changed = FALSE;
+        for (f = prog; f != NULL; f = f->next)
+        {
+            e = effectOf(f->fn);
+            for (b = f->entry; b != NULL; b = b->next)
+                for (i = b->first; i != NULL; i = i->next)
+                {
+                    if (i->op != IrCall)
+                        continue;
+                    c = effectOf(i->sym);
+                    if ((c == NULL || c->globals) && !e->globals)
+                        e->globals = changed = TRUE;
+                    if ((c == NULL || c->arrays) && !e->arrays)
+                        e->arrays = changed = TRUE;
+                }
+        }
+    } while (changed);
+}
+
+/**************************************************/
+/*************   dominators   *********************/
+/**************************************************/
+
+static void postorder(IrBlock *b)
+{
+    int k;
+    seen[b->id] = TRUE;
+    for (k = 0; k < b->nsucc; k++)
+        if (!seen[b->succ[k]->id])
+            postorder(b->succ[k]);
+    order[nOrder++] = b;
+}
+
+static IrBlock *intersect(IrBlock *x, IrBlock *y)
+{
+    while (x != y)
+    {
+        while (rpoNum[x->id] > rpoNum[y->id])
+            x = idom[x->id];
+        while (rpoNum[y->id] > rpoNum[x->id])
+            y = idom[y->id];
+    }
+    return x;
+}
+
+/* Procedure dominators finds the immediate
+ * dominator of every block, by the iterative
+ * algorithm of Cooper, Harvey and Kennedy
+ */
+static void dominators(void)
+{
+    IrBlock *b, *d, *t;
+    int k, p, changed;
+    nOrder = 0;
+    for (k = 0; k < func->nBlocks; k++)
+    {
+        seen[k] = FALSE;
+        idom[k] = NULL;
+    }
+    postorder(func->entry);
+    for (k = 0; k < nOrder / 2; k++)
+    {
+        t = order[k];
+        order[k] = order[nOrder - 1 - k];
+        order[nOrder - 1 - k] = t;
+    }
+    for (k = 0; k < nOrder; k++)
+        rpoNum[order[k]->id] = k;
+    idom[func->entry->id] = func->entry;
+    do
+    {
+        changed = FALSE;
+        for (k = 1; k < nOrder; k++)
+        {
+            b = order[k];
+            d = NULL;
+            for (p = 0; p < b->npred; p++)
+                if (idom[b->pred[p]->id] != NULL)
+                    d = d == NULL ? b->pred[p] : intersect(b->pred[p], d);
+            if (d != idom[b->id])
+            {
+                idom[b->id] = d;
+                changed = TRUE;
+            }
+        }
+    } while (changed);
+}
+
+/**************************************************/
+/*************   locations   **********************/
+/**************************************************/
+
+static int locOf(TreeNode *sym)
+{
+    int k;
+    for (k = 0; k < nLocs; k++)
+        if (locs[k] == sym)
+            return k;
+    if (nLocs == maxLocs)
+    {
+        maxLocs = maxLocs ? 2 * maxLocs : 16;
+        locs = realloc(locs, maxLocs * sizeof(TreeNode *));
+    }
+    locs[nLocs] = sym;
+    return nLocs++;
+}
+
+/* Procedure writes adds to s the locations
+ * instruction i may write
+ */
+static void writes(IrInst *i, Bitset s)
+{
+    Effect *e;
+    int k;
+    switch (i->op)
+    {
+    case IrStore:
+        bsSet(s, locOf(i->sym));
+        break;
+    case IrStoreX:
+    case IrStoreP:
+        for (k = 0; k < nLocs; k++)
+            if (isArray(locs[k]) && mayShare(locs[k], i->sym))
+                bsSet(s, k);
+        break;
+    case IrCall:
+        e = effectOf(i->sym);
+        for (k = 0; k < nLocs; k++)
+            if (isArray(locs[k]) ? e == NULL || e->arrays
+                                 : isGlobalScalar(locs[k]) && (e == NULL || e->globals))
+                bsSet(s, k);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Procedure scan records the locations, the kills
+ * of every block and the definitions and reads of
+ * every register of func
+ */
+static void scan(void)
+{
+    int size = func->nRegs > 0 ? func->nRegs : 1;
+    IrBlock *b;
+    IrInst *i;
+    int k, n;
+    nLocs = 0;
+    for (b = func->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if (i->sym != NULL && i->op != IrCall)
+                locOf(i->sym);
+    version = realloc(version, (nLocs > 0 ? nLocs : 1) * sizeof(int));
+    for (k = 0; k < nLocs; k++)
+        version[k] = 0;
+    kills = realloc(kills, func->nBlocks * sizeof(Bitset));
+    for (k = 0; k < func->nBlocks; k++)
+        kills[k] = NULL;
+    for (b = func->entry; b != NULL; b = b->next)
+    {
+        kills[b->id] = bsNew(nLocs > 0 ? nLocs : 1);
+        for (i = b->first; i != NULL; i = i->next)
+            writes(i, kills[b->id]);
+    }
+
+    defs = realloc(defs, size * sizeof(int));
+    defInst = realloc(defInst, size * sizeof(IrInst *));
+    defBlock = realloc(defBlock, size * sizeof(IrBlock *));
+    useCount = realloc(useCount, size * sizeof(int));
+    inFrame = realloc(inFrame, size * sizeof(int));
+    callsAt = realloc(callsAt, size * sizeof(int));
+    repl = realloc(repl, size * sizeof(int));
+    same = realloc(same, size * sizeof(int));
+    defAt = realloc(defAt, size * sizeof(int));
+    lastAt = realloc(lastAt, size * sizeof(int));
+    for (k = 0; k < func->nRegs; k++)
+    {
+        defs[k] = useCount[k] = 0;
+        defInst[k] = NULL;
+        defBlock[k] = NULL;
+        inFrame[k] = FALSE;
+        repl[k] = same[k] = NO_REG;
+    }
+    /* the registers read in another block or after
+     * a call are the ones likely to be left in the
+     * frame (see regalloc.c)
+     */
+    for (b = func->entry; b != NULL; b = b->next)
+        for (i = b->first, calls = 0; i != NULL; i = i->next)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+            {
+                useCount[uses[k]]++;
+                if (defBlock[uses[k]] != b || callsAt[uses[k]] != calls)
+                    inFrame[uses[k]] = TRUE;
+            }
+            if (i->dst != NO_REG)
+            {
+                defs[i->dst]++;
+                defInst[i->dst] = i;
+                defBlock[i->dst] = b;
+                callsAt[i->dst] = calls;
+            }
+            calls += i->op == IrCall;
+        }
+}
+
+static void newVersions(Bitset s)
+{
+    int k;
+    for (k = bsNext(s, 0); k >= 0; k = bsNext(s, k + 1))
+        version[k] = ++stamp;
+}
+
+/* Procedure joinKills starts new versions of what
+ * the paths into the join b from its immediate
+ * dominator may write
+ */
+static void joinKills(IrBlock *b)
+{
+    IrBlock **stack = (IrBlock **)malloc(func->nBlocks * sizeof(IrBlock *));
+    Bitset s = bsNew(nLocs > 0 ? nLocs : 1);
+    IrBlock *d = idom[b->id], *x;
+    int n = 0, k;
+    for (k = 0; k < func->nBlocks; k++)
+        seen[k] = FALSE;
+    seen[d->id] = TRUE;
+    for (k = 0; k < b->npred; k++)
+        if (!seen[b->pred[k]->id])
+        {
+            seen[b->pred[k]->id] = TRUE;
+            stack[n++] = b->pred[k];
+        }
+    while (n > 0)
+    {
+        x = stack[--n];
+        bsUnion(s, kills[x->id]);
+        for (k = 0; k < x->npred; k++)
+            if (!seen[x->pred[k]->id])
+            {
+                seen[x->pred[k]->id] = TRUE;
+                stack[n++] = x->pred[k];
+            }
+    }
+    newVersions(s);
+    bsFree(s);
+    free(stack);
+}
+
+/**************************************************/
+/*************   expressions   ********************/
+/**************************************************/
+
+static int hashOf(Expr *e)
+{
+    unsigned h = e->op;
+    h = h * 31 + e->a;
+    h = h * 31 + e->b;
+    h = h * 31 + e->imm;
+    h = h * 31 + (unsigned)((unsigned long)e->sym >> 4);
+    h = h * 31 + e->version;
+    return (int)(h % HASH_SIZE);
+}
+
+static int find(int r)
+{
+    while (repl[r] != NO_REG)
+        r = repl[r];
+    return r;
+}
+
+/* the register keys use for the value of r */
+static int valueOf(int r)
+{
+    return r != NO_REG && same[r] != NO_REG ? same[r] : r;
+}
+
+static int single(int r)
+{
+    return r == NO_REG || defs[r] == 1;
+}
+
+/* Function keyOf describes in e the value i
+ * computes, and returns FALSE if it has none
+ */
+static int keyOf(IrInst *i, Expr *e)
+{
+    int k;
+    e->op = i->op;
+    e->a = valueOf(i->src[0]);
+    e->b = valueOf(i->src[1]);
+    e->imm = 0;
+    e->sym = NULL;
+    e->version = 0;
+    if (!single(i->dst) || !single(i->src[0]) || !single(i->src[1]))
+        return FALSE;
+    switch (i->op)
+    {
+    case IrConst:
+    case IrAddI:
+        e->imm = i->imm;
+        return TRUE;
+    case IrAdd:
+    case IrMul:
+    case IrEq:
+    case IrNe:
+        if (e->a > e->b)
+        {
+            k = e->a;
+            e->a = e->b;
+            e->b = k;
+        }
+        return TRUE;
+    case IrSub:
+    case IrDiv:
+    case IrLt:
+    case IrLe:
+    case IrGt:
+    case IrGe:
+        return TRUE;
+    case IrLoadP:
+        e->imm = i->imm;
+        /* fall through */
+    case IrLoad:
+    case IrLoadX:
+        e->sym = i->sym;
+        e->version = version[locOf(i->sym)];
+        return TRUE;
+    case IrAddr:
+    case IrLen:
+    case IrCheck:
+        e->sym = i->sym;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static int lookup(Expr *e)
+{
+    int k;
+    e->hash = hashOf(e);
+    for (k = bucket[e->hash]; k >= 0; k = exprs[k].next)
+        if (exprs[k].op == e->op && exprs[k].a == e->a && exprs[k].b == e->b &&
+            exprs[k].imm == e->imm && exprs[k].sym == e->sym &&
+            exprs[k].version == e->version)
+            return k;
+    return -1;
+}
+
+static void insert(Expr *e, int reg, IrBlock *b)
+{
+    if (nExprs == maxExprs)
+    {
+        maxExprs = maxExprs ? 2 * maxExprs : 64;
+        exprs = realloc(exprs, maxExprs * sizeof(Expr));
+    }
+    e->hash = hashOf(e);
+    e->reg = reg;
+    e->block = b;
+    e->calls = calls;
+    e->next = bucket[e->hash];
+    exprs[nExprs] = *e;
+    bucket[e->hash] = nExprs++;
+}
+
+/* Procedure remember makes the value a store
+ * writes available to the loads after it
+ */
+static void remember(IrInst *i, IrOp load, int value, IrBlock *b)
+{
+    Expr e;
+    if (!single(value) || !single(i->src[0]))
+        return;
+    e.op = load;
+    e.a = load == IrLoad ? NO_REG : valueOf(i->src[0]);
+    e.b = NO_REG;
+    e.imm = load == IrLoadP ? i->imm : 0;
+    e.sym = i->sym;
+    e.version = version[locOf(i->sym)];
+    insert(&e, value, b);
+}
+
+/* TRUE if op only computes a value */
+static int computes(IrOp op)
+{
+    return (op >= IrConst && op <= IrNe) || op == IrLoad || op == IrLoadX ||
+           op == IrLoadP || op == IrAddr || op == IrLen;
+}
+
+/* Function cost estimates the TM instructions i
+ * and the operands only it reads take in block b
+ */
+static int cost(IrBlock *b, IrInst *i)
+{
+    TreeNode *d = i->sym;
+    int c, k;
+    switch (i->op)
+    {
+    case IrConst:
+        c = opCost("LDC");
+        break;
+    case IrAddI:
+        c = opCost("LDA");
+        break;
+    case IrAdd:
+        c = opCost("ADD");
+        break;
+    case IrSub:
+        c = opCost("SUB");
+        break;
+    case IrMul:
+        c = opCost("MUL");
+        break;
+    case IrDiv:
+        c = opCost("DIV");
+        break;
+    case IrLoad:
+    case IrLoadP:
+        c = opCost("LD");
+        break;
+    case IrLoadX:
+        c = opCost("LD");
+        if (d->kind.exp == ArrayParamK)
+            c += opCost("LD") + opCost("ADD");
+        else if (d->scope != globalScope)
+            c += opCost("ADD");
+        break;
+    case IrAddr:
+    case IrLen:
+        c = opCost(d->kind.exp == ArrayParamK ? "LD" : "LDA");
+        break;
+    default:
+        /* a relational operator */
+        c = opCost("SUB") + opCost("JLT") + opCost("LDC") + opCost("LDA");
+        break;
+    }
+    for (k = 0; k < 2; k++)
+        if (i->src[k] != NO_REG && useCount[i->src[k]] == 1 &&
+            defs[i->src[k]] == 1 && defBlock[i->src[k]] == b &&
+            computes(defInst[i->src[k]]->op))
+            c += cost(b, defInst[i->src[k]]);
+    return c;
+}
+
+/* Procedure hold counts one more value as held in
+ * a TM register after the positions from to to-1,
+ * or one fewer if by is -1
+ */
+static void hold(int from, int to, int by)
+{
+    for (; from < to; from++)
+        liveAfter[from] += by;
+}
+
+/* Function crowded returns TRUE if keeping r in
+ * its register up to the current position could
+ * leave a value of the block without one
+ */
+static int crowded(IrBlock *b, int r)
+{
+    int k;
+    if (defBlock[r] != b || inFrame[r])
+        return FALSE;
+    for (k = lastAt[r]; k < position; k++)
+        if (liveAfter[k] >= IR_REGS)
+            return TRUE;
+    return FALSE;
+}
+
+/* Function reuse decides whether i of block b
+ * should read the register of available
+ * expression e instead of computing it again
+ */
+static int reuse(IrBlock *b, IrInst *i, Expr *e)
+{
+    int r = e->reg, price;
+    if (i->op == IrCheck)
+        return TRUE;
+    /* a value pushed out of the registers is stored
+     * and loaded again
+     */
+    if (e->block == b && e->calls == calls)
+        return !crowded(b, r) || cost(b, i) > opCost("ST") + opCost("LD");
+    /* r moves to the frame if it does not live there yet */
+    price = useCount[i->dst] * opCost("LD");
+    if (!inFrame[r])
+        price += opCost("ST") + useCount[r] * opCost("LD");
+    return cost(b, i) > price;
+}
+
+/* Procedure number reuses the value of i, if it
+ * is available, and makes it available if not
+ */
+static void number(IrBlock *b, IrInst *i)
+{
+    Expr e;
+    int k, x;
+    for (k = 0; k < 2; k++)
+        if (i->src[k] != NO_REG)
+            i->src[k] = find(i->src[k]);
+    for (k = 0; k < i->nargs; k++)
+        i->args[k] = find(i->args[k]);
+    switch (i->op)
+    {
+    case IrStore:
+        version[locOf(i->sym)] = ++stamp;
+        remember(i, IrLoad, i->src[0], b);
+        return;
+    case IrStoreX:
+    case IrStoreP:
+    case IrCall:
+    {
+        Bitset s = bsNew(nLocs > 0 ? nLocs : 1);
+        writes(i, s);
+        newVersions(s);
+        bsFree(s);
+        if (i->op != IrCall)
+            remember(i, i->op == IrStoreX ? IrLoadX : IrLoadP, i->src[1], b);
+        else
+            calls++;
+        return;
+    }
+    default:
+        break;
+    }
+    if (!keyOf(i, &e))
+        return;
+    k = lookup(&e);
+    if (k >= 0 && reuse(b, i, &exprs[k]))
+    {
+        if (i->dst != NO_REG)
+        {
+            x = exprs[k].reg;
+            repl[i->dst] = x;
+            useCount[x] += useCount[i->dst];
+            if (exprs[k].block != b || exprs[k].calls != calls || inFrame[i->dst])
+            {
+                /* x is read where only the frame keeps it */
+                if (!inFrame[i->dst])
+                    hold(defAt[i->dst], lastAt[i->dst], -1);
+                if (defBlock[x] == b && !inFrame[x])
+                    hold(defAt[x], lastAt[x], -1);
+                inFrame[x] = TRUE;
+            }
+            else if (defBlock[x] == b && !inFrame[x])
+            {
+                hold(lastAt[x], position, 1);
+                if (lastAt[i->dst] > lastAt[x])
+                    lastAt[x] = lastAt[i->dst];
+            }
+        }
+        nExpr++;
+        nLoads += i->op == IrLoad || i->op == IrLoadX || i->op == IrLoadP;
+        nChecks += i->op == IrCheck;
+        irRemove(b, i);
+        free(i);
+    }
+    else
+    {
+        /* the keys of what uses i see the first register */
+        if (k >= 0 && i->dst != NO_REG)
+            same[i->dst] = valueOf(exprs[k].reg);
+        insert(&e, i->dst, b);
+    }
+}
+
+/* Procedure pressure finds how many values of
+ * block b are held in TM registers after each
+ * of its instructions
+ */
+static void pressure(IrBlock *b)
+{
+    IrInst *i;
+    int n = 0, k, r;
+    for (i = b->first; i != NULL; i = i->next, n++)
+    {
+        r = readsOf(i);
+        for (k = 0; k < r; k++)
+            lastAt[uses[k]] = n;
+        if (i->dst != NO_REG)
+            defAt[i->dst] = lastAt[i->dst] = n;
+    }
+    liveAfter = (int *)calloc(n > 0 ? n : 1, sizeof(int));
+    for (i = b->first; i != NULL; i = i->next)
+        if (i->dst != NO_REG && defs[i->dst] == 1 && !inFrame[i->dst])
+            hold(defAt[i->dst], lastAt[i->dst], 1);
+}
+
+/* Procedure visit numbers block b and then the
+ * blocks it immediately dominates
+ */
+static void visit(IrBlock *b)
+{
+    int *saved = (int *)malloc((nLocs > 0 ? nLocs : 1) * sizeof(int));
+    int height = nExprs, k;
+    IrInst *i, *next;
+    if (b != func->entry && (b->npred != 1 || b->pred[0] != idom[b->id]))
+        joinKills(b);
+    memcpy(saved, version, nLocs * sizeof(int));
+    pressure(b);
+    calls = 0;
+    position = 0;
+    for (i = b->first; i != NULL; i = next, position++)
+    {
+        next = i->next;
+        number(b, i);
+    }
+    free(liveAfter);
+    for (k = 0; k < nOrder; k++)
+        if (order[k] != b && idom[order[k]->id] == b)
+            visit(order[k]);
+    while (nExprs > height)
+    {
+        nExprs--;
+        bucket[exprs[nExprs].hash] = exprs[nExprs].next;
+    }
+    memcpy(version, saved, nLocs * sizeof(int));
+    free(saved);
+}
+
+/* Function numberValues removes the computations,
+ * loads and bounds checks whose value an earlier
+ * one on every path already holds, and returns
+ * their number
+ */
+int numberValues(IrFunc *prog)
+{
+    int k, removed = 0;
+    findEffects(prog);
+    if (TraceAnalyze)
+        fprintf(listing, "\nValue numbering:\n");
+    for (func = prog; func != NULL; func = func->next)
+    {
+        if (func->entry == NULL)
+            continue;
+        order = realloc(order, func->nBlocks * sizeof(IrBlock *));
+        rpoNum = realloc(rpoNum, func->nBlocks * sizeof(int));
+        idom = realloc(idom, func->nBlocks * sizeof(IrBlock *));
+        seen = realloc(seen, func->nBlocks * sizeof(int));
+        dominators();
+        scan();
+        for (k = 0; k < HASH_SIZE; k++)
+            bucket[k] = -1;
+        nExprs = 0;
+        nExpr = nLoads = nChecks = 0;
+        visit(func->entry);
+        removed += nExpr;
+        for (k = 0; k < func->nBlocks; k++)
+            if (kills[k] != NULL)
+                bsFree(kills[k]);
+        if (nExpr > 0)
+            irSweep(func);
+        if (TraceAnalyze && func->fn->child[2] != NULL)
+            fprintf(listing, "  %s: %d redundant expressions removed, "
+                             "%d of them loads and %d bounds checks\n",
+                    func->fn->attr.name, nExpr, nLoads, nChecks);
+    }
+    free(exprs);
+    free(effects);
+    free(order);
+    free(rpoNum);
+    free(idom);
+    free(seen);
+    free(locs);
+    free(version);
+    free(kills);
+    free(defs);
+    free(defInst);
+    free(defBlock);
+    free(useCount);
+    free(inFrame);
+    free(callsAt);
+    free(repl);
+    free(same);
+    free(defAt);
+    free(lastAt);
+    free(uses);
+    exprs = NULL;
+    effects = NULL;
+    order = NULL;
+    rpoNum = seen = version = NULL;
+    idom = NULL;
+    locs = NULL;
+    kills = NULL;
+    defs = useCount = inFrame = callsAt = repl = same = uses = NULL;
+    defAt = lastAt = NULL;
+    defInst = NULL;
+    defBlock = NULL;
+    maxExprs = maxLocs = maxUses = 0;
+    return removed;
+}
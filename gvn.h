@@ -0,0 +1,19 @@
+/****************************************************/
+/* File: gvn.h                                      */
+/* Value numbering on the IR                        */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _GVN_H_
+#define _GVN_H_
+
+#include "ir.h"
+
+/* Function numberValues removes the computations,
+ * loads and bounds checks whose value an earlier
+ * one on every path already holds, and returns
+ * their number
+ */
+int numberValues(IrFunc *prog);
+
+#endif
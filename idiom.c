@@ -0,0 +1,122 @@
+/****************************************************/
+/* File: idiom.c                                    */
+/* Recognition of array copy and fill loops         */
+/* for the TINY compiler                            */
+/* The loops                                        */
+/*     while (i < n) { a[i + c] = b[i + d]; ++i; }  */
+/*     while (i < n) { a[i + c] = v; ++i; }         */
+/* with < or <=, an unchanging bound n and value v, */
+/* constants c and d, and ++i for i = i + 1, move   */
+/* or fill n - i words at once. A copy within one   */
+/* array must read each word before it writes it,   */
+/* so its destination may not start above its       */
+/* source; distinct arrays that may share storage   */
+/* are left alone. Only the tree code generator     */
+/* emits MOV and FIL; under -i such a loop is       */
+/* compiled as written, and unrolled at -O2         */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "alias.h"
+#include "idiom.h"
+
+/* Function isValue returns TRUE if t is a constant
+ * or a scalar other than the counter var
+ */
+static int isValue(TreeNode *t, TreeNode *var)
+{
+    return isConst(t) ||
+           (t->nodekind == ExpK && t->kind.exp == IdK && isScalar(declOf(t)) &&
+            declOf(t) != var);
+}
+
+/* Function element returns the declaration of the
+ * array t subscripts with var plus a constant, or
+ * NULL
+ */
+static TreeNode *element(TreeNode *t, TreeNode *var, int *offset)
+{
+    TreeNode *d;
+    if (t->nodekind != ExpK || t->kind.exp != ArrayIdK)
+        return NULL;
+    d = declOf(t);
+    if (d == NULL || (d->kind.exp != VarArrayK && d->kind.exp != ArrayParamK) ||
+        !offsetOf(t->child[0], var, offset))
+        return NULL;
+    return d;
+}
+
+/* Function steps returns TRUE if t is the
+ * assignment var = var + 1
+ */
+static int steps(TreeNode *t, TreeNode *var)
+{
+    TreeNode *rhs;
+    if (t->nodekind != ExpK || t->kind.exp != AssignK || !isVar(t->child[0], var))
+        return FALSE;
+    rhs = t->child[1];
+    return rhs->nodekind == ExpK && rhs->kind.exp == OpK && rhs->attr.op == PLUS &&
+           ((isVar(rhs->child[0], var) && isConst(rhs->child[1]) &&
+             rhs->child[1]->attr.val == 1) ||
+            (isConst(rhs->child[0]) && rhs->child[0]->attr.val == 1 &&
+             isVar(rhs->child[1], var)));
+}
+
+static TreeNode *copyNode(TreeNode *t)
+{
+    TreeNode *c = allocTree();
+    *c = *t;
+    c->sibling = NULL;
+    return c;
+}
+
+int blockLoop(TreeNode *loop, BlockLoop *b)
+{
+    TreeNode *test = loop->child[0], *body = loop->child[1];
+    TreeNode *move, *var, *dst, *src, *last;
+    int dstOffset, srcOffset;
+    if (test->nodekind != ExpK || test->kind.exp != OpK ||
+        (test->attr.op != LT && test->attr.op != LE) ||
+        test->child[0]->kind.exp != IdK || !isScalar(var = declOf(test->child[0])) ||
+        !isValue(test->child[1], var))
+        return FALSE;
+    if (body->nodekind != StmtK || body->kind.stmt != CompoundK || body->child[0] != NULL)
+        return FALSE;
+    move = body->child[1];
+    if (move == NULL || move->sibling == NULL || move->sibling->sibling != NULL ||
+        !steps(move->sibling, var) || move->nodekind != ExpK || move->kind.exp != AssignK)
+        return FALSE;
+    dst = element(move->child[0], var, &dstOffset);
+    if (dst == NULL)
+        return FALSE;
+    b->dst = move->child[0];
+    b->src = b->value = NULL;
+    src = element(move->child[1], var, &srcOffset);
+    if (src != NULL)
+    {
+        if (src == dst ? dstOffset > srcOffset : mayShare(src, dst))
+            return FALSE;
+        b->src = move->child[1];
+    }
+    else if (isValue(move->child[1], var))
+        b->value = move->child[1];
+    else
+        return FALSE;
+    /* n - i trips for <, n - i + 1 for <=, after which i is n or n + 1 */
+    last = copyNode(test->child[1]);
+    b->count = newOp(MINUS, copyNode(test->child[1]), copyNode(test->child[0]));
+    if (test->attr.op == LE)
+    {
+        b->count = newOp(PLUS, b->count, newExpNode(ConstK));
+        b->count->child[1]->attr.val = 1;
+        b->count->child[1]->type = Integer;
+        last = newOp(PLUS, last, copyNode(b->count->child[1]));
+    }
+    b->exit = newExpNode(AssignK);
+    b->exit->child[0] = copyNode(test->child[0]);
+    b->exit->child[1] = last;
+    b->exit->type = Integer;
+    b->exit->lineno = loop->lineno;
+    return TRUE;
+}
@@ -0,0 +1,28 @@
+/****************************************************/
+/* File: idiom.h                                    */
+/* Recognition of array copy and fill loops         */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _IDIOM_H_
+#define _IDIOM_H_
+
+/* a loop that copies or fills an array range */
+typedef struct
+{
+    TreeNode *dst;   /* the element written on the first trip */
+    TreeNode *src;   /* the element read on the first trip, or NULL */
+    TreeNode *value; /* the value a fill stores */
+    TreeNode *count; /* the number of trips, if positive */
+    TreeNode *exit;  /* the assignment of the final counter value */
+} BlockLoop;
+
+/* Function blockLoop returns TRUE if the WhileK
+ * node loop only copies one array range into
+ * another, or fills a range with an unchanging
+ * value, stepping a counter by one, and then
+ * describes it in b
+ */
+int blockLoop(TreeNode *loop, BlockLoop *b);
+
+#endif
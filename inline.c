@@ -0,0 +1,541 @@
+/****************************************************/
+/* File: inline.c                                   */
+/* Function inlining                                */
+/* for the TINY compiler                            */
+/* A call is replaced by a block that declares the  */
+/* callee's parameters and locals in the caller's   */
+/* frame, assigns the arguments and runs a copy of  */
+/* the body. Array parameters are bound to the      */
+/* argument arrays by reference                     */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "code.h"
+#include "clone.h"
+#include "profile.h"
+#include "inline.h"
+
+/* a call in a loop weighs LOOP_WEIGHT times more
+ * per level of nesting, up to MAX_DEPTH levels
+ */
+#define LOOP_WEIGHT 8
+#define MAX_DEPTH 3
+
+/* MAX_CODE bounds the estimated program size,
+ * leaving room for the error of the estimate
+ */
+#define MAX_CODE (IADDR_SIZE / 2)
+
+/* MAX_ROUNDS bounds inlining into inlined code */
+#define MAX_ROUNDS 4
+
+static int nInlined;    /* calls substituted */
+static int nRemoved;    /* functions removed */
+static int programSize; /* estimated TM instructions */
+
+/* the functions of the program */
+static int nFuncs;
+static TreeNode **funcs;
+static int *recursive;
+static int *callCount;
+static int *inlined; /* some call of the function was inlined */
+static int *visited;
+
+static int funcIndex(TreeNode *fn)
+{
+    int i;
+    for (i = 0; i < nFuncs; i++)
+        if (funcs[i] == fn)
+            return i;
+    return -1;
+}
+
+/* Function reaches returns TRUE if the code t can
+ * call target, directly or through other calls
+ */
+static int reaches(TreeNode *t, TreeNode *target)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (isUserCall(t))
+        {
+            TreeNode *g = t->bucket->treeNode;
+            int k = funcIndex(g);
+            if (g == target)
+                return TRUE;
+            if (k >= 0 && !visited[k])
+            {
+                visited[k] = TRUE;
+                if (reaches(g->child[2], target))
+                    return TRUE;
+            }
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (reaches(t->child[i], target))
+                return TRUE;
+    }
+    return FALSE;
+}
+
+static void countCalls(TreeNode *t)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (isUserCall(t) && (i = funcIndex(t->bucket->treeNode)) >= 0)
+            callCount[i]++;
+        for (i = 0; i < MAXCHILDREN; i++)
+            countCalls(t->child[i]);
+    }
+}
+
+/**************************************************/
+/*************   copying the callee   *************/
+/**************************************************/
+
+/* how the returns of the callee are copied */
+typedef enum
+{
+    ToReturn,  /* the caller returns the value */
+    ToResult,  /* the value is assigned to result */
+    ToDiscard  /* the value is not used */
+} ReturnMode;
+
+static ReturnMode mode;
+static BucketList result;
+
+static TreeNode *newId(BucketList b, int line)
+{
+    TreeNode *t = newExpNode(IdK);
+    t->attr.name = b->name;
+    t->bucket = b;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+static TreeNode *newAssign(BucketList b, TreeNode *e, int line)
+{
+    TreeNode *t = newExpNode(AssignK);
+    t->child[0] = newId(b, line);
+    t->child[1] = e;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+/* Procedure rewriteReturns turns the returns of
+ * the copied body t into assignments of their
+ * values to the result, or into the values alone
+ * when the caller drops them
+ */
+static void rewriteReturns(TreeNode *t)
+{
+    TreeNode *e;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == StmtK && t->kind.stmt == ReturnK)
+        {
+            e = t->child[0];
+            if (e != NULL && mode == ToResult)
+                replaceNode(t, newAssign(result, e, t->lineno));
+            else if (e != NULL && !isPureExp(e))
+                replaceNode(t, e);
+            else
+                replaceNode(t, newStmtNode(CompoundK));
+            continue;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            rewriteReturns(t->child[i]);
+    }
+}
+
+/* Function tailReturns returns TRUE if every return
+ * of the statements t ends its path through them
+ */
+static int tailReturns(TreeNode *t, int tail)
+{
+    for (; t != NULL; t = t->sibling)
+    {
+        int last = tail && t->sibling == NULL;
+        if (t->nodekind != StmtK)
+            continue;
+        switch (t->kind.stmt)
+        {
+        case ReturnK:
+            if (!last)
+                return FALSE;
+            break;
+        case CompoundK:
+            if (!tailReturns(t->child[1], last))
+                return FALSE;
+            break;
+        case IfK:
+            if (!tailReturns(t->child[1], last) ||
+                !tailReturns(t->child[2], last))
+                return FALSE;
+            break;
+        case WhileK:
+            if (!tailReturns(t->child[1], FALSE))
+                return FALSE;
+            break;
+        default:
+            break;
+        }
+    }
+    return TRUE;
+}
+
+/* Procedure substitute replaces statement s by a
+ * block running the call it makes first, then the
+ * rest of s with the call replaced by its value
+ */
+static void substitute(TreeNode *s, TreeNode *call, ScopeList enclosing)
+{
+    TreeNode *fn = call->bucket->treeNode;
+    ScopeList sc = sc_create(fn->attr.name);
+    TreeNode *decls = NULL, *stmts = NULL, *rest = NULL;
+    TreeNode *formal, *arg, *next, *d, *last, *body;
+    sc->loc = enclosing->loc;
+    cloneReset();
+    if (mode == ToResult && s->nodekind == ExpK && s->kind.exp == AssignK &&
+        s->child[0]->kind.exp == IdK && s->child[1] == call)
+        result = s->child[0]->bucket;
+    else if (mode == ToResult)
+    {
+        /* a variable holding the value for the rest of s */
+        d = newExpNode(VarK);
+        d->attr.name = fn->attr.name;
+        d->child[0] = fn->child[0];
+        d->type = Integer;
+        d->lineno = call->lineno;
+        st_declare(sc, d);
+        decls = d;
+        result = d->bucket;
+        rest = allocTree();
+        *rest = *s;
+        rest->sibling = NULL;
+    }
+    arg = call->child[0];
+    for (formal = fn->child[1]; formal != NULL && formal->nodekind == ExpK;
+         formal = formal->sibling)
+    {
+        next = arg->sibling;
+        arg->sibling = NULL;
+        if (formal->kind.exp == ArrayParamK)
+            cloneBind(formal->bucket, arg->bucket);
+        else
+        {
+            d = cloneDecl(formal, sc);
+            decls = dangleTree(decls, d);
+            stmts = dangleTree(stmts, newAssign(d->bucket, arg, call->lineno));
+        }
+        arg = next;
+    }
+    for (d = fn->child[2]->child[0]; d != NULL; d = d->sibling)
+        decls = dangleTree(decls, cloneDecl(d, sc));
+    body = cloneTree(fn->child[2]->child[1], sc);
+    if (mode != ToReturn)
+        rewriteReturns(body);
+    stmts = dangleTree(stmts, body);
+    if (mode == ToReturn)
+    {
+        /* the caller returns when the callee falls off its end */
+        for (last = fn->child[2]->child[1]; last != NULL && last->sibling != NULL;)
+            last = last->sibling;
+        if (last == NULL || last->nodekind != StmtK || last->kind.stmt != ReturnK)
+            stmts = dangleTree(stmts, newStmtNode(ReturnK));
+    }
+    if (rest != NULL)
+    {
+        /* the blocks of the rest of s must not reuse the result */
+        sc_shift(rest, sc->loc - enclosing->loc);
+        call->kind.exp = IdK;
+        call->child[0] = NULL;
+        call->attr.name = result->name;
+        call->bucket = result;
+        stmts = dangleTree(stmts, rest);
+    }
+    s->nodekind = StmtK;
+    s->kind.stmt = CompoundK;
+    s->child[0] = decls;
+    s->child[1] = stmts;
+    s->child[2] = NULL;
+    s->scope = sc;
+    s->bucket = NULL;
+}
+
+/**************************************************/
+/*************   choosing the calls   *************/
+/**************************************************/
+
+/* the result of searching an expression for the
+ * call a statement makes first
+ */
+enum
+{
+    Stable,  /* only reads local scalars */
+    Found,   /* the call was found */
+    Blocked  /* something before it must stay first */
+};
+
+static TreeNode *found;
+
+static int isStableId(TreeNode *t)
+{
+    TreeNode *d = t->bucket->treeNode;
+    return (d->kind.exp == VarK || d->kind.exp == SingleParamK) &&
+           d->scope != globalScope;
+}
+
+static int argsPure(TreeNode *call)
+{
+    TreeNode *a;
+    for (a = call->child[0]; a != NULL; a = a->sibling)
+        if (!isPureExp(a))
+            return FALSE;
+    return TRUE;
+}
+
+/* Function findCall looks in t, in evaluation
+ * order, for a call that can be made before the
+ * rest of its statement: everything evaluated
+ * ahead of it may only read local scalars, which
+ * no callee can change, and may not trap
+ */
+static int findCall(TreeNode *t)
+{
+    TreeNode *a;
+    int r;
+    if (t == NULL)
+        return Stable;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return Stable;
+    case IdK:
+        return isStableId(t) ? Stable : Blocked;
+    case OpK:
+        if ((r = findCall(t->child[0])) != Stable ||
+            (r = findCall(t->child[1])) != Stable)
+            return r;
+        if (t->attr.op == OVER &&
+            !(isConst(t->child[1]) && t->child[1]->attr.val != 0))
+            return Blocked;
+        return Stable;
+    case ArrayIdK:
+        return findCall(t->child[0]) == Found ? Found : Blocked;
+    case AssignK:
+        a = t->child[0];
+        if (a->kind.exp == ArrayIdK)
+        {
+            if ((r = findCall(a->child[0])) != Stable)
+                return r;
+            if (CheckBounds)
+                return Blocked;
+        }
+        return findCall(t->child[1]) == Found ? Found : Blocked;
+    case CallK:
+        if (isUserCall(t) && argsPure(t))
+        {
+            found = t;
+            return Found;
+        }
+        for (a = t->child[0]; a != NULL; a = a->sibling)
+            if ((r = findCall(a)) != Stable)
+                return r;
+        return Blocked;
+    default:
+        return Blocked;
+    }
+}
+
+static int loopWeight(int depth)
+{
+    int w = 1;
+    for (; depth > 0 && depth <= MAX_DEPTH; depth--)
+        w *= LOOP_WEIGHT;
+    return w;
+}
+
+/* Function callWeight returns how many times more
+ * the call at loop depth depth counts than a call
+ * made once: with a profile, the times it ran per
+ * run of main, up to the weight of the deepest
+ * loop
+ */
+static long callWeight(TreeNode *call, int depth)
+{
+    NodeProfile *prof = nodeProfile(call), *runs = NULL;
+    long w;
+    int i;
+    for (i = 0; i < nFuncs; i++)
+        if (strcmp(funcs[i]->attr.name, "main") == 0)
+            runs = nodeProfile(funcs[i]);
+    if (prof == NULL || runs == NULL || runs->entries == 0)
+        return loopWeight(depth);
+    w = prof->entries / runs->entries;
+    return w < loopWeight(MAX_DEPTH) ? w : loopWeight(MAX_DEPTH);
+}
+
+/* Function tryInline inlines the first call made
+ * by the expression e of statement s if the cost
+ * model accepts it, returning TRUE if it did
+ */
+static int tryInline(TreeNode *s, TreeNode *e, ScopeList scope, int depth)
+{
+    TreeNode *fn;
+    int i, growth;
+    if (findCall(e) != Found)
+        return FALSE;
+    fn = found->bucket->treeNode;
+    i = funcIndex(fn);
+    if (i < 0 || recursive[i])
+        return FALSE;
+    if (s->nodekind == StmtK && s->kind.stmt == ReturnK && s->child[0] == found)
+        mode = ToReturn;
+    else if (!tailReturns(fn->child[2]->child[1], TRUE))
+        return FALSE;
+    else
+        mode = s == found ? ToDiscard : ToResult;
+    growth = codeCost(fn->child[2]) - CALL_COST;
+    /* the last call of a function takes its code along */
+    if (callCount[i] == 1 && fn != funcs[0])
+        growth -= nodeCost(fn);
+    else if (growth > InlineLimit * callWeight(found, depth))
+        return FALSE;
+    if (growth > 0 && programSize + growth > MAX_CODE)
+        return FALSE;
+    substitute(s, found, scope);
+    programSize += growth;
+    callCount[i]--;
+    inlined[i] = TRUE;
+    nInlined++;
+    return TRUE;
+}
+
+/* Procedure inlineStmt inlines calls of statement
+ * t, whose locals live in scope, at loop depth
+ * depth. Inlined code is visited in the next round
+ */
+static void inlineStmt(TreeNode *t, ScopeList scope, int depth)
+{
+    TreeNode *s;
+    if (t->nodekind == ExpK)
+    {
+        tryInline(t, t, scope, depth);
+        return;
+    }
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        if (t->scope != NULL)
+            scope = t->scope;
+        for (s = t->child[1]; s != NULL; s = s->sibling)
+            inlineStmt(s, scope, depth);
+        break;
+    case IfK:
+        if (!tryInline(t, t->child[0], scope, depth))
+        {
+            inlineStmt(t->child[1], scope, depth);
+            if (t->child[2] != NULL)
+                inlineStmt(t->child[2], scope, depth);
+        }
+        break;
+    case WhileK:
+        inlineStmt(t->child[1], scope, depth + 1);
+        break;
+    case ReturnK:
+        tryInline(t, t->child[0], scope, depth);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Procedure removeUncalled unlinks the functions
+ * whose every call was inlined
+ */
+static void removeUncalled(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int i, removed;
+    do
+    {
+        removed = FALSE;
+        for (i = 0; i < nFuncs; i++)
+            callCount[i] = 0;
+        countCalls(syntaxTree);
+        for (t = syntaxTree; t->sibling != NULL;)
+        {
+            i = funcIndex(t->sibling);
+            if (i >= 0 && inlined[i] && callCount[i] == 0)
+            {
+                t->sibling = t->sibling->sibling;
+                inlined[i] = FALSE;
+                removed = TRUE;
+                nRemoved++;
+            }
+            else
+                t = t->sibling;
+        }
+    } while (removed);
+}
+
+/* Function inlineCalls substitutes the bodies of
+ * non-recursive functions at the calls whose
+ * estimated code growth the cost model accepts,
+ * removes the functions left without callers, and
+ * returns the number of calls and functions
+ */
+int inlineCalls(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int i, round, before;
+    nInlined = nRemoved = nFuncs = 0;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+        if (isFunction(t))
+            nFuncs++;
+    funcs = malloc(nFuncs * sizeof(TreeNode *));
+    recursive = malloc(nFuncs * sizeof(int));
+    callCount = malloc(nFuncs * sizeof(int));
+    inlined = calloc(nFuncs, sizeof(int));
+    visited = malloc(nFuncs * sizeof(int));
+    nFuncs = 0;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+        if (isFunction(t))
+            funcs[nFuncs++] = t;
+    for (i = 0; i < nFuncs; i++)
+    {
+        memset(visited, 0, nFuncs * sizeof(int));
+        recursive[i] = reaches(funcs[i]->child[2], funcs[i]);
+    }
+    programSize = codeCost(syntaxTree);
+    for (round = 0; round < MAX_ROUNDS; round++)
+    {
+        before = nInlined;
+        for (i = 0; i < nFuncs; i++)
+            callCount[i] = 0;
+        countCalls(syntaxTree);
+        for (t = syntaxTree; t != NULL; t = t->sibling)
+            if (isFunction(t))
+                inlineStmt(t->child[2], t->child[2]->scope, 0);
+        if (nInlined == before)
+            break;
+    }
+    removeUncalled(syntaxTree);
+    free(funcs);
+    free(recursive);
+    free(callCount);
+    free(inlined);
+    free(visited);
+    if (TraceAnalyze)
+        fprintf(listing, "\nInlining: %d calls inlined, %d functions removed\n",
+                nInlined, nRemoved);
+    return nInlined + nRemoved;
+}
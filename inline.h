@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: inline.h                                   */
+/* Function inlining                                */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _INLINE_H_
+#define _INLINE_H_
+
+/* Function inlineCalls substitutes the bodies of
+ * non-recursive functions at the calls whose
+ * estimated code growth the cost model accepts,
+ * removes the functions left without callers, and
+ * returns the number of calls and functions
+ */
+int inlineCalls(TreeNode *syntaxTree);
+
+#endif
@@ -0,0 +1,636 @@
+/****************************************************/
+/* File: ir.c                                       */
+/* Three-address IR construction, printing and      */
+/* verification for the TINY compiler               */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "bitset.h"
+#include "ir.h"
+
+IrFunc *irNewFunc(TreeNode *fn)
+{
+    IrFunc *f = (IrFunc *)calloc(1, sizeof(IrFunc));
+    f->fn = fn;
+    return f;
+}
+
+/* Function irNewBlock adds an empty block at the
+ * end of the layout of f
+ */
+IrBlock *irNewBlock(IrFunc *f)
+{
+    IrBlock *b = (IrBlock *)calloc(1, sizeof(IrBlock));
+    b->id = f->nBlocks++;
+    if (f->entry == NULL)
+        f->entry = b;
+    else
+        f->last->next = b;
+    f->last = b;
+    return b;
+}
+
+int irNewReg(IrFunc *f)
+{
+    return f->nRegs++;
+}
+
+IrInst *irNewInst(IrOp op)
+{
+    IrInst *i = (IrInst *)calloc(1, sizeof(IrInst));
+    i->op = op;
+    i->dst = NO_REG;
+    i->src[0] = i->src[1] = NO_REG;
+    return i;
+}
+
+void irAppend(IrBlock *b, IrInst *i)
+{
+    i->prev = b->last;
+    i->next = NULL;
+    if (b->last == NULL)
+        b->first = i;
+    else
+        b->last->next = i;
+    b->last = i;
+}
+
+void irInsertBefore(IrBlock *b, IrInst *pos, IrInst *i)
+{
+    if (pos == NULL)
+    {
+        irAppend(b, i);
+        return;
+    }
+    i->next = pos;
+    i->prev = pos->prev;
+    if (pos->prev == NULL)
+        b->first = i;
+    else
+        pos->prev->next = i;
+    pos->prev = i;
+}
+
+void irRemove(IrBlock *b, IrInst *i)
+{
+    if (i->prev == NULL)
+        b->first = i->next;
+    else
+        i->prev->next = i->next;
+    if (i->next == NULL)
+        b->last = i->prev;
+    else
+        i->next->prev = i->prev;
+    i->prev = i->next = NULL;
+}
+
+int irIsTerminator(IrOp op)
+{
+    return op == IrJump || op == IrBranch || op == IrRet;
+}
+
+/* Function irUses stores the registers instruction
+ * i reads into uses and returns their number
+ */
+int irUses(IrInst *i, int *uses)
+{
+    int n = 0, k;
+    for (k = 0; k < 2; k++)
+        if (i->src[k] != NO_REG)
+            uses[n++] = i->src[k];
+    for (k = 0; k < i->nargs; k++)
+        uses[n++] = i->args[k];
+    return n;
+}
+
+/* Function irMaxUses returns the room irUses needs */
+int irMaxUses(IrInst *i)
+{
+    return 2 + i->nargs;
+}
+
+static void freeBlock(IrBlock *b)
+{
+    IrInst *i = b->first;
+    while (i != NULL)
+    {
+        IrInst *next = i->next;
+        free(i->args);
+        free(i);
+        i = next;
+    }
+    free(b->pred);
+    free(b);
+}
+
+static void addPred(IrBlock *b, IrBlock *p)
+{
+    if (b->npred == b->maxPred)
+    {
+        b->maxPred = b->maxPred ? 2 * b->maxPred : 2;
+        b->pred = realloc(b->pred, b->maxPred * sizeof(IrBlock *));
+    }
+    b->pred[b->npred++] = p;
+}
+
+static void markReachable(IrBlock *b)
+{
+    int k;
+    if (b == NULL || b->mark)
+        return;
+    b->mark = TRUE;
+    for (k = 0; k < b->nsucc; k++)
+        markReachable(b->succ[k]);
+}
+
+/* Procedure irComputeCfg drops the blocks the
+ * entry cannot reach and recomputes the successor
+ * and predecessor lists from the terminators
+ */
+void irComputeCfg(IrFunc *f)
+{
+    IrBlock *b, *prev;
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        IrInst *t = b->last;
+        b->nsucc = 0;
+        b->npred = 0;
+        b->mark = FALSE;
+        if (t == NULL)
+            continue;
+        if (t->op == IrJump || t->op == IrBranch)
+            b->succ[b->nsucc++] = t->target[0];
+        if (t->op == IrBranch && t->target[1] != t->target[0])
+            b->succ[b->nsucc++] = t->target[1];
+    }
+    markReachable(f->entry);
+    prev = NULL;
+    b = f->entry;
+    while (b != NULL)
+    {
+        IrBlock *next = b->next;
+        if (!b->mark)
+        {
+            if (prev == NULL)
+                f->entry = next;
+            else
+                prev->next = next;
+            freeBlock(b);
+        }
+        else
+            prev = b;
+        b = next;
+    }
+    f->last = prev;
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        int k;
+        b->mark = FALSE;
+        for (k = 0; k < b->nsucc; k++)
+            addPred(b->succ[k], b);
+    }
+}
+
+static int removable(IrOp op)
+{
+    switch (op)
+    {
+    case IrConst:
+    case IrMove:
+    case IrAddI:
+    case IrAdd:
+    case IrSub:
+    case IrMul:
+    case IrLoad:
+    case IrAddr:
+    case IrLen:
+        return TRUE;
+    default:
+        return op >= IrLt && op <= IrNe;
+    }
+}
+
+/* Procedure irSweep removes the computations of f
+ * left without readers
+ */
+void irSweep(IrFunc *f)
+{
+    int *count = (int *)malloc((f->nRegs > 0 ? f->nRegs : 1) * sizeof(int));
+    int *uses = NULL, maxUses = 0;
+    IrBlock *b;
+    IrInst *i, *next;
+    int k, n, changed;
+    do
+    {
+        changed = FALSE;
+        for (k = 0; k < f->nRegs; k++)
+            count[k] = 0;
+        for (b = f->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = i->next)
+            {
+                if (irMaxUses(i) > maxUses)
+                {
+                    maxUses = irMaxUses(i);
+                    uses = realloc(uses, maxUses * sizeof(int));
+                }
+                n = irUses(i, uses);
+                for (k = 0; k < n; k++)
+                    count[uses[k]]++;
+            }
+        for (b = f->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = next)
+            {
+                next = i->next;
+                if (i->dst != NO_REG && removable(i->op) && count[i->dst] == 0)
+                {
+                    irRemove(b, i);
+                    free(i);
+                    changed = TRUE;
+                }
+            }
+    } while (changed);
+    free(count);
+    free(uses);
+}
+
+/**************************************************/
+/*************   printing   ***********************/
+/**************************************************/
+
+static char *symName(TreeNode *d)
+{
+    if (d == NULL)
+        return "?";
+    if (d->nodekind == ExpK && d->kind.exp == VarArrayK)
+        return d->attr.arr.name;
+    return d->attr.name;
+}
+
+static char *opName[] = {
+    "const", "move", "addi", "add", "sub", "mul", "div",
+    "lt", "le", "gt", "ge", "eq", "ne",
+    "load", "store", "loadx", "storex", "loadp", "storep", "addr", "len", "check",
+    "in", "out", "call", "jump", "branch", "ret"};
+
+static void printInst(FILE *out, IrInst *i)
+{
+    int k;
+    fprintf(out, "    ");
+    if (i->dst != NO_REG)
+        fprintf(out, "t%d = ", i->dst);
+    fprintf(out, "%s", opName[i->op]);
+    switch (i->op)
+    {
+    case IrConst:
+        fprintf(out, " %d", i->imm);
+        break;
+    case IrLoad:
+    case IrAddr:
+    case IrLen:
+        fprintf(out, " %s", symName(i->sym));
+        break;
+    case IrStore:
+        fprintf(out, " %s, t%d", symName(i->sym), i->src[0]);
+        break;
+    case IrLoadX:
+    case IrCheck:
+        fprintf(out, " %s[t%d]", symName(i->sym), i->src[0]);
+        break;
+    case IrStoreX:
+        fprintf(out, " %s[t%d], t%d", symName(i->sym), i->src[0], i->src[1]);
+        break;
+    case IrAddI:
+        fprintf(out, " t%d, %d", i->src[0], i->imm);
+        break;
+    case IrLoadP:
+        fprintf(out, " %s@[t%d%+d]", symName(i->sym), i->src[0], i->imm);
+        break;
+    case IrStoreP:
+        fprintf(out, " %s@[t%d%+d], t%d", symName(i->sym), i->src[0], i->imm, i->src[1]);
+        break;
+    case IrCall:
+        fprintf(out, " %s(", symName(i->sym));
+        for (k = 0; k < i->nargs; k++)
+            fprintf(out, "%st%d", k ? ", " : "", i->args[k]);
+        fprintf(out, ")");
+        break;
+    case IrJump:
+        fprintf(out, " B%d", i->target[0]->id);
+        break;
+    case IrBranch:
+        fprintf(out, " t%d, B%d, B%d", i->src[0],
+                i->target[0]->id, i->target[1]->id);
+        break;
+    default:
+        for (k = 0; k < 2; k++)
+            if (i->src[k] != NO_REG)
+                fprintf(out, "%st%d", k ? ", " : " ", i->src[k]);
+        break;
+    }
+    fprintf(out, "\n");
+}
+
+/* Procedure irPrint writes the IR of every
+ * function of the program to the file out
+ */
+void irPrint(FILE *out, IrFunc *prog)
+{
+    IrFunc *f;
+    for (f = prog; f != NULL; f = f->next)
+    {
+        IrBlock *b;
+        fprintf(out, "\nfunction %s (%d registers)\n", f->fn->attr.name, f->nRegs);
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            IrInst *i;
+            int k;
+            fprintf(out, "B%d:", b->id);
+            if (b->npred > 0)
+            {
+                fprintf(out, "%*s; preds", b->id < 10 ? 6 : 5, "");
+                for (k = 0; k < b->npred; k++)
+                    fprintf(out, " B%d", b->pred[k]->id);
+            }
+            fprintf(out, "\n");
+            for (i = b->first; i != NULL; i = i->next)
+                printInst(out, i);
+        }
+    }
+}
+
+/**************************************************/
+/*************   verification   *******************/
+/**************************************************/
+
+static int nErrors;
+
+static void irError(IrFunc *f, IrBlock *b, char *message)
+{
+    fprintf(listing, "IR error in %s, block B%d: %s\n",
+            f->fn->attr.name, b->id, message);
+    nErrors++;
+}
+
+static int isArray(TreeNode *d)
+{
+    return d != NULL && d->nodekind == ExpK &&
+           (d->kind.exp == VarArrayK || d->kind.exp == ArrayParamK);
+}
+
+/* the number of argument words a call of fn passes */
+static int argWords(TreeNode *fn)
+{
+    TreeNode *p;
+    int n = 0;
+    for (p = fn->child[1]; p != NULL; p = p->sibling)
+        if (p->nodekind == ExpK && p->kind.exp == SingleParamK)
+            n++;
+        else if (p->nodekind == ExpK && p->kind.exp == ArrayParamK)
+            n += CheckBounds ? 2 : 1;
+    return n;
+}
+
+static int definesReg(IrOp op)
+{
+    switch (op)
+    {
+    case IrStore:
+    case IrStoreX:
+    case IrStoreP:
+    case IrCheck:
+    case IrOut:
+    case IrCall:
+    case IrJump:
+    case IrBranch:
+    case IrRet:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+/* the number of source registers i takes */
+static int srcCount(IrInst *i)
+{
+    switch (i->op)
+    {
+    case IrConst:
+    case IrLoad:
+    case IrAddr:
+    case IrLen:
+    case IrIn:
+    case IrCall:
+    case IrJump:
+        return 0;
+    case IrRet:
+        return i->src[0] != NO_REG;
+    case IrStoreX:
+    case IrStoreP:
+        return 2;
+    default:
+        return i->op >= IrAdd && i->op <= IrNe ? 2 : 1;
+    }
+}
+
+/* checks the fields of one instruction */
+static void verifyInst(IrFunc *f, IrBlock *b, IrInst *i)
+{
+    int n, k;
+    if (i->dst != NO_REG && (i->dst < 0 || i->dst >= f->nRegs))
+        irError(f, b, "destination register out of range");
+    if (definesReg(i->op) && i->dst == NO_REG)
+        irError(f, b, "missing destination register");
+    if (!definesReg(i->op) && i->op != IrCall && i->dst != NO_REG)
+        irError(f, b, "unexpected destination register");
+    for (k = 0; k < 2; k++)
+        if (i->src[k] != NO_REG && (i->src[k] < 0 || i->src[k] >= f->nRegs))
+            irError(f, b, "source register out of range");
+    for (k = 0; k < i->nargs; k++)
+        if (i->args[k] < 0 || i->args[k] >= f->nRegs)
+            irError(f, b, "argument register out of range");
+    n = srcCount(i);
+    for (k = 0; k < 2; k++)
+        if ((k < n) != (i->src[k] != NO_REG))
+        {
+            irError(f, b, "wrong number of source registers");
+            break;
+        }
+    switch (i->op)
+    {
+    case IrLoad:
+    case IrStore:
+        if (!isScalar(i->sym))
+            irError(f, b, "scalar access to a non-scalar");
+        break;
+    case IrLoadX:
+    case IrStoreX:
+    case IrLoadP:
+    case IrStoreP:
+    case IrAddr:
+    case IrLen:
+    case IrCheck:
+        if (!isArray(i->sym))
+            irError(f, b, "array access to a non-array");
+        break;
+    case IrCall:
+        if (i->sym == NULL || i->sym->nodekind != StmtK ||
+            i->sym->kind.stmt != FunctionK || i->sym->child[2] == NULL)
+            irError(f, b, "call of something that is not a function");
+        else if (argWords(i->sym) != i->nargs)
+            irError(f, b, "wrong number of arguments");
+        break;
+    case IrJump:
+    case IrBranch:
+        for (k = 0; k < (i->op == IrBranch ? 2 : 1); k++)
+            if (i->target[k] == NULL || i->target[k]->mark != 1)
+                irError(f, b, "jump to a block outside the function");
+        break;
+    default:
+        break;
+    }
+}
+
+/* checks that every register is written on each
+ * path before it is read
+ */
+static void verifyDefs(IrFunc *f)
+{
+    IrBlock *b;
+    Bitset *in, cur;
+    int *uses = NULL, maxUses = 0;
+    int changed, k, n;
+    in = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    for (k = 0; k < f->nBlocks; k++)
+    {
+        in[k] = bsNew(f->nRegs);
+        bsFill(in[k]);
+    }
+    bsClear(in[f->entry->id]);
+    cur = bsNew(f->nRegs);
+    do
+    {
+        changed = FALSE;
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            IrInst *i;
+            bsCopy(cur, in[b->id]);
+            for (i = b->first; i != NULL; i = i->next)
+                if (i->dst != NO_REG)
+                    bsSet(cur, i->dst);
+            for (k = 0; k < b->nsucc; k++)
+                if (bsIntersect(in[b->succ[k]->id], cur))
+                    changed = TRUE;
+        }
+    } while (changed);
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        IrInst *i;
+        bsCopy(cur, in[b->id]);
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            if (irMaxUses(i) > maxUses)
+            {
+                maxUses = irMaxUses(i);
+                uses = realloc(uses, maxUses * sizeof(int));
+            }
+            n = irUses(i, uses);
+            for (k = 0; k < n; k++)
+                if (uses[k] >= 0 && uses[k] < f->nRegs && !bsTest(cur, uses[k]))
+                {
+                    irError(f, b, "register read before it is written");
+                    break;
+                }
+            if (i->dst >= 0 && i->dst < f->nRegs)
+                bsSet(cur, i->dst);
+        }
+    }
+    for (k = 0; k < f->nBlocks; k++)
+        bsFree(in[k]);
+    free(in);
+    free(uses);
+    bsFree(cur);
+}
+
+/* Function irVerify checks the structure of every
+ * function, reports each problem to the listing
+ * and returns the number found
+ */
+int irVerify(IrFunc *prog)
+{
+    IrFunc *f;
+    nErrors = 0;
+    for (f = prog; f != NULL; f = f->next)
+    {
+        IrBlock *b;
+        int errors = nErrors;
+        if (f->entry == NULL)
+        {
+            fprintf(listing, "IR error in %s: no entry block\n", f->fn->attr.name);
+            nErrors++;
+            continue;
+        }
+        /* blocks of this function are marked 1 */
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            if (b->id < 0 || b->id >= f->nBlocks)
+                irError(f, b, "block number out of range");
+            b->mark = 1;
+        }
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            IrInst *i;
+            int k, nsucc;
+            if (b->first == NULL || !irIsTerminator(b->last->op))
+                irError(f, b, "block does not end in a jump or return");
+            for (i = b->first; i != NULL; i = i->next)
+            {
+                if (i->next != NULL && i->next->prev != i)
+                    irError(f, b, "broken instruction links");
+                if (i != b->last && irIsTerminator(i->op))
+                    irError(f, b, "jump or return inside a block");
+                verifyInst(f, b, i);
+            }
+            if (b->last == NULL)
+                continue;
+            nsucc = b->last->op == IrJump ? 1
+                    : b->last->op == IrBranch
+                        ? 1 + (b->last->target[1] != b->last->target[0])
+                        : 0;
+            if (nsucc != b->nsucc)
+                irError(f, b, "successors do not match the terminator");
+            for (k = 0; k < b->nsucc; k++)
+            {
+                int j, found = FALSE;
+                for (j = 0; j < b->succ[k]->npred; j++)
+                    found |= b->succ[k]->pred[j] == b;
+                if (!found)
+                    irError(f, b, "successor does not list the block as predecessor");
+            }
+        }
+        if (nErrors == errors)
+            verifyDefs(f);
+        for (b = f->entry; b != NULL; b = b->next)
+            b->mark = 0;
+    }
+    return nErrors;
+}
+
+/* Procedure irFree releases a program */
+void irFree(IrFunc *prog)
+{
+    while (prog != NULL)
+    {
+        IrFunc *next = prog->next;
+        IrBlock *b = prog->entry;
+        while (b != NULL)
+        {
+            IrBlock *nb = b->next;
+            freeBlock(b);
+            b = nb;
+        }
+        free(prog);
+        prog = next;
+    }
+}
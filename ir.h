@@ -0,0 +1,132 @@
+/****************************************************/
+/* File: ir.h                                       */
+/* Three-address intermediate representation        */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _IR_H_
+#define _IR_H_
+
+typedef enum
+{
+    IrConst,  /* dst = imm */
+    IrMove,   /* dst = src0 */
+    IrAddI,   /* dst = src0 + imm */
+    IrAdd,    /* dst = src0 op src1 */
+    IrSub,
+    IrMul,
+    IrDiv,
+    IrLt,     /* dst = 1 if src0 rel src1, else 0 */
+    IrLe,
+    IrGt,
+    IrGe,
+    IrEq,
+    IrNe,
+    IrLoad,   /* dst = scalar sym */
+    IrStore,  /* scalar sym = src0 */
+    IrLoadX,  /* dst = sym[src0] */
+    IrStoreX, /* sym[src0] = src1 */
+    IrLoadP,  /* dst = word at address src0 + imm in sym */
+    IrStoreP, /* word at address src0 + imm in sym = src1 */
+    IrAddr,   /* dst = address of sym[0] */
+    IrLen,    /* dst = length of array sym */
+    IrCheck,  /* trap unless 0 <= src0 < length of sym */
+    IrIn,     /* dst = input() */
+    IrOut,    /* output(src0) */
+    IrCall,   /* dst = sym(args), dst is -1 for void */
+    IrJump,   /* goto target0 */
+    IrBranch, /* if src0 != 0 goto target0 else target1 */
+    IrRet     /* return src0, src0 is -1 for void */
+} IrOp;
+
+/* NO_REG marks an unused register field */
+#define NO_REG (-1)
+
+typedef struct IrInstRec
+{
+    IrOp op;
+    int dst;
+    int src[2];
+    int imm;
+    TreeNode *sym; /* declaration accessed or called */
+    int nargs;
+    int *args;     /* argument registers in frame order */
+    struct IrBlockRec *target[2];
+    TreeNode *tree; /* source node */
+    struct IrInstRec *prev, *next;
+} IrInst;
+
+typedef struct IrBlockRec
+{
+    int id;
+    IrInst *first, *last;
+    int nsucc;
+    struct IrBlockRec *succ[2];
+    int npred, maxPred;
+    struct IrBlockRec **pred;
+    int mark; /* scratch field for passes */
+    struct IrBlockRec *next; /* layout order */
+} IrBlock;
+
+/* A function: blocks in layout order starting at
+ * the entry block, registers numbered 0..nRegs-1.
+ * Functions of a program are chained by next.
+ */
+typedef struct IrFuncRec
+{
+    TreeNode *fn;
+    IrBlock *entry;
+    IrBlock *last; /* end of the layout */
+    int nBlocks;
+    int nRegs;
+    struct IrFuncRec *next;
+} IrFunc;
+
+IrFunc *irNewFunc(TreeNode *fn);
+IrBlock *irNewBlock(IrFunc *f);
+int irNewReg(IrFunc *f);
+IrInst *irNewInst(IrOp op);
+
+/* Procedures irAppend and irInsertBefore link an
+ * instruction into a block, irRemove unlinks it
+ */
+void irAppend(IrBlock *b, IrInst *i);
+void irInsertBefore(IrBlock *b, IrInst *pos, IrInst *i);
+void irRemove(IrBlock *b, IrInst *i);
+
+int irIsTerminator(IrOp op);
+
+/* Function irUses stores the registers instruction
+ * i reads into uses and returns their number
+ */
+int irUses(IrInst *i, int *uses);
+
+/* Function irMaxUses returns the room irUses needs */
+int irMaxUses(IrInst *i);
+
+/* Procedure irComputeCfg drops the blocks the
+ * entry cannot reach and recomputes the successor
+ * and predecessor lists from the terminators
+ */
+void irComputeCfg(IrFunc *f);
+
+/* Procedure irSweep removes the computations of f
+ * left without readers
+ */
+void irSweep(IrFunc *f);
+
+/* Procedure irPrint writes the IR of every
+ * function of the program to the file out
+ */
+void irPrint(FILE *out, IrFunc *prog);
+
+/* Function irVerify checks the structure of every
+ * function, reports each problem to the listing
+ * and returns the number found
+ */
+int irVerify(IrFunc *prog);
+
+/* Procedure irFree releases a program */
+void irFree(IrFunc *prog);
+
+#endif
@@ -0,0 +1,426 @@
+/****************************************************/
+/* File: irgen.c                                    */
+/* Lowering of the syntax tree to the IR            */
+/* for the TINY compiler                            */
+/* Every expression value gets a fresh register;    */
+/* scalars and array elements are only accessed by  */
+/* explicit loads and stores                        */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "symtab.h"
+#include "alias.h"
+#include "range.h"
+#include "cgen.h"
+#include "ir.h"
+#include "irgen.h"
+
+static IrFunc *func; /* function being lowered */
+static IrBlock *cur; /* block instructions go to */
+static IrBlock *top; /* start of the body, for self tail calls */
+static int unchecked; /* TRUE in the guarded copy of a loop */
+
+static IrInst *emit(IrOp op, int dst, int a, int b, TreeNode *tree)
+{
+    IrInst *i = irNewInst(op);
+    i->dst = dst;
+    i->src[0] = a;
+    i->src[1] = b;
+    i->tree = tree;
+    irAppend(cur, i);
+    return i;
+}
+
+static int newReg(void)
+{
+    return irNewReg(func);
+}
+
+static void emitJump(IrBlock *target)
+{
+    IrInst *i = emit(IrJump, NO_REG, NO_REG, NO_REG, NULL);
+    i->target[0] = target;
+}
+
+static void emitBranch(int c, IrBlock *t, IrBlock *f, TreeNode *tree)
+{
+    IrInst *i = emit(IrBranch, NO_REG, c, NO_REG, tree);
+    i->target[0] = t;
+    i->target[1] = f;
+}
+
+static IrOp binaryOp(TokenType op)
+{
+    switch (op)
+    {
+    case PLUS:
+        return IrAdd;
+    case MINUS:
+        return IrSub;
+    case TIMES:
+        return IrMul;
+    case OVER:
+        return IrDiv;
+    case LT:
+        return IrLt;
+    case LE:
+        return IrLe;
+    case GT:
+        return IrGt;
+    case GE:
+        return IrGe;
+    case EQ:
+        return IrEq;
+    default:
+        return IrNe;
+    }
+}
+
+/* register holding the length of the array decl */
+static int genLength(TreeNode *decl, TreeNode *tree)
+{
+    int r = newReg();
+    if (decl->kind.exp == VarArrayK)
+        emit(IrConst, r, NO_REG, NO_REG, tree)->imm = decl->attr.arr.length;
+    else
+        emit(IrLen, r, NO_REG, NO_REG, tree)->sym = decl;
+    return r;
+}
+
+static int genExp(TreeNode *t);
+
+/* register holding the checked subscript of the
+ * ArrayIdK node t
+ */
+static int genIndex(TreeNode *t)
+{
+    int idx = genExp(t->child[0]);
+    if (CheckBounds && !unchecked && !boundsSafe(t))
+        emit(IrCheck, NO_REG, idx, NO_REG, t)->sym = declOf(t);
+    return idx;
+}
+
+static int genCall(TreeNode *t)
+{
+    TreeNode *fn = declOf(t);
+    TreeNode *formal, *arg;
+    IrInst *call;
+    int n = 0, r;
+    if (fn->child[2] == NULL) /* built in input and output */
+    {
+        if (strcmp(t->attr.name, "input") == 0)
+            return emit(IrIn, newReg(), NO_REG, NO_REG, t)->dst;
+        emit(IrOut, NO_REG, genExp(t->child[0]), NO_REG, t);
+        return NO_REG;
+    }
+    call = irNewInst(IrCall);
+    call->sym = fn;
+    call->tree = t;
+    for (formal = fn->child[1]; formal != NULL; formal = formal->sibling)
+        if (formal->nodekind == ExpK)
+            n += formal->kind.exp == ArrayParamK && CheckBounds ? 2 : 1;
+    call->args = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    formal = fn->child[1];
+    for (arg = t->child[0]; arg != NULL; arg = arg->sibling)
+    {
+        if (formal->kind.exp == ArrayParamK)
+        {
+            r = newReg();
+            emit(IrAddr, r, NO_REG, NO_REG, arg)->sym = declOf(arg);
+            call->args[call->nargs++] = r;
+            if (CheckBounds)
+                call->args[call->nargs++] = genLength(declOf(arg), arg);
+        }
+        else
+            call->args[call->nargs++] = genExp(arg);
+        formal = formal->sibling;
+    }
+    if (fn->child[0] != NULL && fn->child[0]->type != Void)
+        call->dst = newReg();
+    irAppend(cur, call);
+    return call->dst;
+}
+
+/* Function genExp lowers expression t and returns
+ * the register holding its value
+ */
+static int genExp(TreeNode *t)
+{
+    int a, b, r;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        r = newReg();
+        emit(IrConst, r, NO_REG, NO_REG, t)->imm = t->attr.val;
+        return r;
+    case IdK:
+        r = newReg();
+        /* a whole array is passed by its address */
+        emit(t->type == IntegerArray ? IrAddr : IrLoad, r, NO_REG, NO_REG, t)->sym = declOf(t);
+        return r;
+    case ArrayIdK:
+        a = genIndex(t);
+        r = newReg();
+        emit(IrLoadX, r, a, NO_REG, t)->sym = declOf(t);
+        return r;
+    case AssignK:
+        if (t->child[0]->kind.exp == ArrayIdK)
+        {
+            /* the subscript is evaluated first */
+            a = genIndex(t->child[0]);
+            b = genExp(t->child[1]);
+            emit(IrStoreX, NO_REG, a, b, t)->sym = declOf(t->child[0]);
+        }
+        else
+        {
+            b = genExp(t->child[1]);
+            emit(IrStore, NO_REG, b, NO_REG, t)->sym = declOf(t->child[0]);
+        }
+        return b;
+    case CallK:
+        return genCall(t);
+    case OpK:
+        a = genExp(t->child[0]);
+        b = genExp(t->child[1]);
+        r = newReg();
+        emit(binaryOp(t->attr.op), r, a, b, t);
+        return r;
+    default:
+        return NO_REG;
+    }
+}
+
+/* Function selfTail returns TRUE if the ReturnK
+ * node t returns a call of the function being
+ * lowered that passes each array parameter on in
+ * its own place, so that it can become stores to
+ * the scalar parameters and a jump back to top
+ */
+static int selfTail(TreeNode *t)
+{
+    TreeNode *call = t->child[0], *arg, *formal;
+    if (call == NULL || call->nodekind != ExpK || call->kind.exp != CallK ||
+        declOf(call) != func->fn || !tailCall(call))
+        return FALSE;
+    formal = func->fn->child[1];
+    for (arg = call->child[0]; arg != NULL; arg = arg->sibling)
+    {
+        if (formal->kind.exp == ArrayParamK && !passedOn(arg, formal))
+            return FALSE;
+        formal = formal->sibling;
+    }
+    return TRUE;
+}
+
+/* Function hasSelfTail returns TRUE if a statement
+ * of t is a self tail call
+ */
+static int hasSelfTail(TreeNode *t)
+{
+    int k;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == StmtK && t->kind.stmt == ReturnK && selfTail(t))
+            return TRUE;
+        if (t->nodekind == StmtK)
+            for (k = 0; k < MAXCHILDREN; k++)
+                if (hasSelfTail(t->child[k]))
+                    return TRUE;
+    }
+    return FALSE;
+}
+
+/* Procedure genSelfTail lowers the self tail call
+ * call as the stores of its arguments to the
+ * parameters that do not keep their value, all
+ * evaluated first, and a jump to top
+ */
+static void genSelfTail(TreeNode *call)
+{
+    TreeNode *arg, *formal = func->fn->child[1];
+    int n = 0, k = 0, *regs;
+    for (arg = call->child[0]; arg != NULL; arg = arg->sibling)
+        n++;
+    regs = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+    for (arg = call->child[0]; arg != NULL; arg = arg->sibling, formal = formal->sibling)
+        regs[k++] = passedOn(arg, formal) ? NO_REG : genExp(arg);
+    formal = func->fn->child[1];
+    for (k = 0; k < n; k++, formal = formal->sibling)
+        if (regs[k] != NO_REG)
+            emit(IrStore, NO_REG, regs[k], NO_REG, call)->sym = formal;
+    free(regs);
+    emitJump(top);
+}
+
+static void genStmt(TreeNode *t);
+
+static void genWhile(TreeNode *t)
+{
+    IrBlock *join, *latch, *body;
+    IrInst *guard;
+    int c;
+    /* rotated: the guard in the current block, the
+     * test again in the latch at the end of the body
+     */
+    c = genExp(t->child[0]);
+    guard = emit(IrBranch, NO_REG, c, NO_REG, t);
+    body = irNewBlock(func);
+    guard->target[0] = body;
+    cur = body;
+    genStmt(t->child[1]);
+    latch = irNewBlock(func);
+    emitJump(latch);
+    cur = latch;
+    c = genExp(t->child[0]);
+    join = irNewBlock(func);
+    emitBranch(c, body, join, t);
+    guard->target[1] = join;
+    cur = join;
+}
+
+/* register holding the value in register a
+ * combined by op with the constant val
+ */
+static int genConstOp(IrOp op, int a, int val, TreeNode *tree)
+{
+    int b = newReg(), r = newReg();
+    emit(IrConst, b, NO_REG, NO_REG, tree)->imm = val;
+    emit(op, r, a, b, tree);
+    return r;
+}
+
+/* Function genGuardedLoop lowers the loop t twice
+ * behind a test of its counter and bound on entry,
+ * without bounds checks for when the test proves
+ * them all in bounds, and returns FALSE if the
+ * subscripts do not allow such a test
+ */
+static int genGuardedLoop(TreeNode *t)
+{
+    LoopGuard g;
+    IrInst *test[MAX_GUARDED + 2], *skip;
+    IrBlock *slow, *join;
+    int nTests = 0, c, cmp, k;
+    if (unchecked || !guardLoop(t, &g))
+        return FALSE;
+    c = genConstOp(IrGe, genExp(g.counter), g.low, t);
+    test[nTests++] = emit(IrBranch, NO_REG, c, NO_REG, t);
+    cur = test[nTests - 1]->target[0] = irNewBlock(func);
+    if (g.high < INT_MAX)
+    {
+        c = genConstOp(IrLe, genExp(g.bound), g.high, t);
+        test[nTests++] = emit(IrBranch, NO_REG, c, NO_REG, t);
+        cur = test[nTests - 1]->target[0] = irNewBlock(func);
+    }
+    for (k = 0; k < g.nParams; k++)
+    {
+        c = genConstOp(IrAdd, genExp(g.bound), g.slack[k], t);
+        cmp = newReg();
+        emit(IrLe, cmp, c, genLength(declOf(g.param[k]), t), t);
+        test[nTests++] = emit(IrBranch, NO_REG, cmp, NO_REG, t);
+        cur = test[nTests - 1]->target[0] = irNewBlock(func);
+    }
+    unchecked = TRUE;
+    genWhile(t);
+    unchecked = FALSE;
+    skip = emit(IrJump, NO_REG, NO_REG, NO_REG, NULL);
+    slow = irNewBlock(func);
+    for (k = 0; k < nTests; k++)
+        test[k]->target[1] = slow;
+    cur = slow;
+    genWhile(t);
+    join = irNewBlock(func);
+    emitJump(join);
+    skip->target[0] = join;
+    cur = join;
+    return TRUE;
+}
+
+static void genStmt(TreeNode *t)
+{
+    IrBlock *thenB, *elseB, *join;
+    int c;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK)
+        {
+            genExp(t);
+            continue;
+        }
+        switch (t->kind.stmt)
+        {
+        case CompoundK:
+            genStmt(t->child[1]);
+            break;
+        case IfK:
+            c = genExp(t->child[0]);
+            thenB = irNewBlock(func);
+            elseB = t->child[2] != NULL ? irNewBlock(func) : NULL;
+            join = irNewBlock(func);
+            emitBranch(c, thenB, elseB != NULL ? elseB : join, t);
+            cur = thenB;
+            genStmt(t->child[1]);
+            emitJump(join);
+            if (elseB != NULL)
+            {
+                cur = elseB;
+                genStmt(t->child[2]);
+                emitJump(join);
+            }
+            cur = join;
+            break;
+        case WhileK:
+            if (!Optimize || OptimizeSize || !CheckBounds || !genGuardedLoop(t))
+                genWhile(t);
+            break;
+        case ReturnK:
+            if (selfTail(t))
+                genSelfTail(t->child[0]);
+            else
+            {
+                c = t->child[0] != NULL ? genExp(t->child[0]) : NO_REG;
+                emit(IrRet, NO_REG, c, NO_REG, t);
+            }
+            /* statements after a return are unreachable */
+            cur = irNewBlock(func);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Function irGen lowers every function of the
+ * analyzed syntax tree to the IR and returns
+ * them chained in source order
+ */
+IrFunc *irGen(TreeNode *syntaxTree)
+{
+    IrFunc *prog = NULL, *last = NULL;
+    TreeNode *t;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind != StmtK || t->kind.stmt != FunctionK)
+            continue;
+        func = irNewFunc(t);
+        cur = irNewBlock(func);
+        top = NULL;
+        if (hasSelfTail(t->child[2]))
+        {
+            /* the entry block stays free of back edges */
+            top = irNewBlock(func);
+            emitJump(top);
+            cur = top;
+        }
+        genStmt(t->child[2]);
+        emit(IrRet, NO_REG, NO_REG, NO_REG, NULL);
+        irComputeCfg(func);
+        if (last == NULL)
+            prog = func;
+        else
+            last->next = func;
+        last = func;
+    }
+    return prog;
+}
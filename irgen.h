@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: irgen.h                                    */
+/* Lowering of the syntax tree to the IR            */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _IRGEN_H_
+#define _IRGEN_H_
+
+#include "ir.h"
+
+/* Function irGen lowers every function of the
+ * analyzed syntax tree to the IR and returns
+ * them chained in source order
+ */
+IrFunc *irGen(TreeNode *syntaxTree);
+
+#endif
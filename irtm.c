@@ -0,0 +1,604 @@
+/****************************************************/
+/* File: irtm.c                                     */
+/* TM code generation from the IR                   */
+/* for the TINY compiler                            */
+/* The activation records are those of cgen.c.      */
+/* The linear scan of regalloc.c puts IR registers  */
+/* in the free TM registers; the others, and those  */
+/* that must survive a call, get a frame word below */
+/* the locals, unless one is only a copy of a local */
+/* that is never written, which is left in place    */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "code.h"
+#include "cgen.h"
+#include "ir.h"
+#include "irtm.h"
+#include "regalloc.h"
+
+/* TM registers FIRST_REG..LAST_REG hold IR
+ * registers; ac and ac1 are left as scratch
+ */
+#define FIRST_REG 2
+#define LAST_REG (FIRST_REG + IR_REGS - 1)
+
+/* a jump whose target was not placed yet */
+typedef struct PatchRec
+{
+    int loc;
+    char *op;
+    int r;
+    IrBlock *block;  /* target block, or NULL for a call */
+    TreeNode *fn;    /* called function */
+    struct PatchRec *next;
+} * PatchList;
+
+/* the entry location of every generated function */
+typedef struct EntryRec
+{
+    TreeNode *fn;
+    int entry;
+    struct EntryRec *next;
+} * EntryList;
+
+static EntryList entries = NULL;
+static PatchList blockPatches = NULL;
+static PatchList callPatches = NULL;
+
+static RegAlloc *alloc;
+static int nRegs;
+static int *regOf;    /* TM register of every IR register, or -1 */
+static int *slotOf;   /* frame offset of every IR register, or 0 */
+static int *blockLoc; /* code location of every block */
+static int frameTop;  /* offset of the first word below the locals */
+static int nSlots;
+static int position;  /* of the instruction in the layout */
+static int trapLoc = 0;
+
+static int funcEntry(TreeNode *fn)
+{
+    EntryList e = entries;
+    while (e != NULL && e->fn != fn)
+        e = e->next;
+    return e == NULL ? -1 : e->entry;
+}
+
+static void addPatch(PatchList *list, char *op, int r, IrBlock *block, TreeNode *fn)
+{
+    PatchList p = (PatchList)malloc(sizeof(struct PatchRec));
+    p->loc = emitSkip(1);
+    p->op = op;
+    p->r = r;
+    p->block = block;
+    p->fn = fn;
+    p->next = *list;
+    *list = p;
+}
+
+static void freePatches(PatchList p)
+{
+    while (p != NULL)
+    {
+        PatchList next = p->next;
+        free(p);
+        p = next;
+    }
+}
+
+/**************************************************/
+/*************   register assignment   ************/
+/**************************************************/
+
+static int newSlot(void)
+{
+    return frameTop - nSlots++;
+}
+
+/* Function homeSlot returns the frame word of the
+ * local scalar loaded into v, if that load is the
+ * only def of v and nothing else reads or writes
+ * the scalar, so that v can stay there; else 0
+ */
+static int homeSlot(IrFunc *f, int v)
+{
+    IrInst *def = alloc->def[v], *i;
+    TreeNode *d;
+    IrBlock *b;
+    if (def == NULL || def->op != IrLoad || frameBase(def->sym) != mp)
+        return 0;
+    d = def->sym;
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if ((i->op == IrLoad || i->op == IrStore) && i->sym == d && i->dst != v)
+                return 0;
+    return frameOffset(d);
+}
+
+/* Function remat returns TRUE if IR register v is
+ * a constant loaded where it is read
+ */
+static int remat(int v)
+{
+    return regOf[v] < 0 && alloc->def[v] != NULL && alloc->def[v]->op == IrConst;
+}
+
+/* Procedure assignRegs decides where every IR
+ * register of f lives: in the TM register the
+ * linear scan gives it, in the frame otherwise,
+ * and in the frame too across the calls it spans
+ */
+static void assignRegs(IrFunc *f)
+{
+    int v;
+    alloc = linearScan(f, FIRST_REG, IR_REGS, ac, ac1);
+    regOf = alloc->reg;
+    for (v = 0; v < f->nRegs; v++)
+    {
+        slotOf[v] = 0;
+        if (alloc->start[v] >= 0 && !remat(v) && (regOf[v] < 0 || alloc->calls[v] > 0))
+        {
+            slotOf[v] = homeSlot(f, v);
+            if (slotOf[v] == 0)
+                slotOf[v] = newSlot();
+        }
+    }
+}
+
+/* Procedure saveAcross stores with op ST, or loads
+ * with op LD, the registers that live across the
+ * call at position pos
+ */
+static void saveAcross(char *op, int pos)
+{
+    int v;
+    for (v = 0; v < nRegs; v++)
+        if (regOf[v] >= 0 && alloc->start[v] < pos && pos < alloc->end[v])
+            emitRM(op, regOf[v], slotOf[v], mp,
+                   op[0] == 'S' ? "call: save register" : "call: restore register");
+}
+
+/* Function inHome returns TRUE if the load i
+ * reads a frame word its register stays in
+ */
+static int inHome(IrInst *i)
+{
+    return regOf[i->dst] < 0 && frameBase(i->sym) == mp &&
+           slotOf[i->dst] == frameOffset(i->sym);
+}
+
+/* Function useReg returns the TM register holding
+ * IR register v, loading it into scratch if it
+ * lives in the frame or is a constant
+ */
+static int useReg(int v, int scratch)
+{
+    if (regOf[v] >= 0)
+        return regOf[v];
+    if (remat(v))
+    {
+        emitRM("LDC", scratch, alloc->def[v]->imm, 0, "load const");
+        return scratch;
+    }
+    emitRM("LD", scratch, slotOf[v], mp, "load value from frame");
+    return scratch;
+}
+
+/* Function defReg returns the TM register the
+ * value of IR register v is computed into
+ */
+static int defReg(int v)
+{
+    return v != NO_REG && regOf[v] >= 0 ? regOf[v] : ac;
+}
+
+/* Procedure saveReg stores v, computed into r,
+ * if it lives in the frame
+ */
+static void saveReg(int v, int r)
+{
+    if (v != NO_REG && regOf[v] < 0 && slotOf[v] != 0)
+        emitRM("ST", r, slotOf[v], mp, "store value to frame");
+}
+
+/**************************************************/
+/*************   instruction selection   **********/
+/**************************************************/
+
+static char *relJump[] = {"JLT", "JLE", "JGT", "JGE", "JEQ", "JNE"};
+static char *relSkip[] = {"JGE", "JGT", "JLE", "JLT", "JNE", "JEQ"};
+static char *aluOp[] = {"ADD", "SUB", "MUL", "DIV"};
+
+/* Function fusedCompare returns TRUE if i is a
+ * comparison only the branch after it reads,
+ * which then tests the difference left in ac
+ */
+static int fusedCompare(IrInst *i)
+{
+    return i != NULL && i->op >= IrLt && i->op <= IrNe && regOf[i->dst] == ac &&
+           i->next != NULL && i->next->op == IrBranch && i->next->src[0] == i->dst;
+}
+
+static void jumpTo(char *op, int r, IrBlock *target, IrBlock *next)
+{
+    if (strcmp(op, "LDA") == 0 && target == next)
+        return; /* falls through */
+    if (blockLoc[target->id] >= 0)
+        emitRM_Abs(op, r, blockLoc[target->id], "jump");
+    else
+        addPatch(&blockPatches, op, r, target, NULL);
+}
+
+/* Procedure genArgs stores the arguments of call i
+ * into the parameter words of the frame at offset
+ * frame from mp
+ */
+static void genArgs(IrInst *i, int frame)
+{
+    TreeNode *formal = i->sym->child[1];
+    int loc = 0, arg = 0, slot, r;
+    for (; arg < i->nargs; formal = formal->sibling)
+    {
+        slot = frame - FRAME_HEADER - loc;
+        r = useReg(i->args[arg++], ac);
+        emitRM("ST", r, slot, mp, "call: store argument");
+        if (formal->kind.exp == ArrayParamK && CheckBounds)
+        {
+            r = useReg(i->args[arg++], ac);
+            emitRM("ST", r, slot - 1, mp, "call: store array length");
+        }
+        loc += st_size(formal);
+    }
+}
+
+/* Function isTail returns TRUE if call i is only
+ * followed by the return of its result and may
+ * run in the frame of its caller
+ */
+static int isTail(IrInst *i)
+{
+    IrInst *r = i->next;
+    return r != NULL && r->op == IrRet && r->src[0] == i->dst &&
+           i->tree != NULL && tailCall(i->tree) && funcEntry(i->sym) >= 0;
+}
+
+/* Procedure genTailCall stores the arguments of
+ * call i over the parameters of the current frame
+ * and enters the callee past the store of the
+ * return address, which is already in place. The
+ * arguments go through the temps first if one of
+ * them lives in a frame word a parameter takes.
+ */
+static void genTailCall(IrInst *i)
+{
+    TreeNode *formal;
+    int words = 0, frame = frameTop - nSlots, loc, k;
+    int staged = FALSE;
+    for (formal = i->sym->child[1]; formal != NULL; formal = formal->sibling)
+        if (formal->nodekind == ExpK)
+            words += st_size(formal);
+    for (k = 0; k < i->nargs; k++)
+        if (regOf[i->args[k]] < 0 && slotOf[i->args[k]] != 0 &&
+            slotOf[i->args[k]] > -(FRAME_HEADER + words))
+            staged = TRUE;
+    if (staged)
+    {
+        genArgs(i, frame);
+        formal = i->sym->child[1];
+        for (k = loc = 0; k < i->nargs; k++, formal = formal->sibling)
+        {
+            emitRM("LD", ac, frame - FRAME_HEADER - loc, mp, "tail call: load argument");
+            emitRM("ST", ac, -FRAME_HEADER - loc, mp, "tail call: store parameter");
+            if (formal->kind.exp == ArrayParamK && CheckBounds)
+            {
+                k++;
+                emitRM("LD", ac, frame - FRAME_HEADER - loc - 1, mp, "tail call: load length");
+                emitRM("ST", ac, -FRAME_HEADER - loc - 1, mp, "tail call: store length");
+            }
+            loc += st_size(formal);
+        }
+    }
+    else
+        genArgs(i, 0);
+    emitRM_Abs("LDA", pc, funcEntry(i->sym) + 1, "tail call: jump past function entry");
+}
+
+static void genCall(IrInst *i)
+{
+    int frame = frameTop - nSlots, entry;
+    saveAcross("ST", position);
+    genArgs(i, frame);
+    emitRM("ST", mp, frame, mp, "call: store control link");
+    emitRM("LDA", mp, frame, mp, "call: push frame");
+    emitRM("LDA", ac, 1, pc, "call: return address");
+    entry = funcEntry(i->sym);
+    if (entry >= 0)
+        emitRM_Abs("LDA", pc, entry, "call: jump to function");
+    else
+        addPatch(&callPatches, "LDA", pc, NULL, i->sym);
+    emitRM("LD", mp, 0, mp, "call: pop frame");
+    saveAcross("LD", position);
+    if (i->dst != NO_REG && defReg(i->dst) != ac)
+        emitRM("LDA", defReg(i->dst), 0, ac, "call: move result");
+    saveReg(i->dst, ac);
+}
+
+static void genInst(IrInst *i, IrBlock *next)
+{
+    TreeNode *d = i->sym;
+    int a, b, r = defReg(i->dst);
+    switch (i->op)
+    {
+    case IrConst:
+        if (remat(i->dst))
+            return;
+        emitRM("LDC", r, i->imm, 0, "load const");
+        break;
+    case IrMove:
+        /* straight from or to the frame */
+        a = i->src[0];
+        if (regOf[a] < 0)
+            useReg(a, r);
+        else if (regOf[i->dst] < 0)
+            r = regOf[a];
+        else if (regOf[a] != r)
+            emitRM("LDA", r, 0, regOf[a], "move");
+        break;
+    case IrAddI:
+        a = useReg(i->src[0], ac);
+        emitRM("LDA", r, i->imm, a, "add immediate");
+        break;
+    case IrAdd:
+    case IrSub:
+    case IrMul:
+    case IrDiv:
+        a = useReg(i->src[0], ac);
+        b = useReg(i->src[1], ac1);
+        emitRO(aluOp[i->op - IrAdd], r, a, b, "op");
+        break;
+    case IrLt:
+    case IrLe:
+    case IrGt:
+    case IrGe:
+    case IrEq:
+    case IrNe:
+        a = useReg(i->src[0], ac);
+        b = useReg(i->src[1], ac1);
+        emitRO("SUB", ac, a, b, "compare");
+        if (fusedCompare(i))
+            return;
+        emitRM(relJump[i->op - IrLt], ac, 2, pc, "br if true");
+        emitRM("LDC", r, 0, 0, "false case");
+        emitRM("LDA", pc, 1, pc, "unconditional jmp");
+        emitRM("LDC", r, 1, 0, "true case");
+        break;
+    case IrLoad:
+        if (inHome(i))
+            return;
+        emitRM("LD", r, frameOffset(d), frameBase(d), "load variable");
+        break;
+    case IrStore:
+        a = useReg(i->src[0], ac);
+        emitRM("ST", a, frameOffset(d), frameBase(d), "store variable");
+        break;
+    case IrAddr:
+        if (d->kind.exp == ArrayParamK)
+            emitRM("LD", r, frameOffset(d), mp, "load array parameter");
+        else
+            emitRM("LDA", r, frameOffset(d), frameBase(d), "array address");
+        break;
+    case IrLen:
+        if (d->kind.exp == ArrayParamK)
+            emitRM("LD", r, frameOffset(d) - 1, mp, "load array length");
+        else
+            emitRM("LDC", r, d->attr.arr.length, 0, "array length");
+        break;
+    case IrLoadX:
+    case IrStoreX:
+        /* element address: offset from register a */
+        if (d->kind.exp == ArrayParamK)
+        {
+            emitRM("LD", ac1, frameOffset(d), mp, "load array parameter");
+            a = useReg(i->src[0], ac);
+            emitRO("ADD", ac1, ac1, a, "element address");
+            b = 0;
+            a = ac1;
+        }
+        else if (frameBase(d) == mp)
+        {
+            a = useReg(i->src[0], ac);
+            emitRO("ADD", ac1, mp, a, "add frame pointer");
+            b = frameOffset(d);
+            a = ac1;
+        }
+        else
+        {
+            a = useReg(i->src[0], ac1);
+            b = frameOffset(d);
+        }
+        if (i->op == IrLoadX)
+            emitRM("LD", r, b, a, "load array element");
+        else
+            emitRM("ST", useReg(i->src[1], ac), b, a, "store array element");
+        break;
+    case IrLoadP:
+        a = useReg(i->src[0], ac1);
+        emitRM("LD", r, i->imm, a, "load through pointer");
+        break;
+    case IrStoreP:
+        a = useReg(i->src[0], ac1);
+        emitRM("ST", useReg(i->src[1], ac), i->imm, a, "store through pointer");
+        break;
+    case IrCheck:
+        a = useReg(i->src[0], ac);
+        emitRM_Abs("JLT", a, trapLoc, "check: index below 0");
+        if (d->kind.exp == ArrayParamK)
+        {
+            emitRM("LD", ac1, frameOffset(d) - 1, mp, "check: load length");
+            emitRO("SUB", ac1, a, ac1, "check: index - length");
+        }
+        else
+            emitRM("LDA", ac1, -d->attr.arr.length, a, "check: index - length");
+        emitRM_Abs("JGE", ac1, trapLoc, "check: index past end");
+        break;
+    case IrIn:
+        emitRO("IN", r, 0, 0, "input integer value");
+        break;
+    case IrOut:
+        emitRO("OUT", useReg(i->src[0], ac), 0, 0, "output value");
+        break;
+    case IrCall:
+        if (isTail(i))
+            genTailCall(i);
+        else
+            genCall(i);
+        return;
+    case IrJump:
+        jumpTo("LDA", pc, i->target[0], next);
+        return;
+    case IrBranch:
+        if (fusedCompare(i->prev))
+        {
+            a = i->prev->op - IrLt;
+            if (i->target[0] == next)
+                jumpTo(relSkip[a], ac, i->target[1], next);
+            else
+            {
+                jumpTo(relJump[a], ac, i->target[0], next);
+                jumpTo("LDA", pc, i->target[1], next);
+            }
+            return;
+        }
+        a = useReg(i->src[0], ac);
+        if (i->target[0] == next)
+            jumpTo("JEQ", a, i->target[1], next);
+        else
+        {
+            jumpTo("JNE", a, i->target[0], next);
+            jumpTo("LDA", pc, i->target[1], next);
+        }
+        return;
+    case IrRet:
+        if (i->prev != NULL && i->prev->op == IrCall && isTail(i->prev))
+            return; /* the callee returns for us */
+        if (i->src[0] != NO_REG)
+        {
+            a = useReg(i->src[0], ac);
+            if (a != ac)
+                emitRM("LDA", ac, 0, a, "return value");
+        }
+        emitRM("LD", pc, RA_OFFSET, mp, "return: jump to caller");
+        return;
+    default:
+        emitComment("BUG: unknown IR instruction");
+        return;
+    }
+    saveReg(i->dst, r);
+}
+
+static void genFunc(IrFunc *f)
+{
+    EntryList e = (EntryList)malloc(sizeof(struct EntryRec));
+    PatchList p;
+    IrBlock *b;
+    IrInst *i;
+    int k;
+    if (TraceCode)
+    {
+        emitComment("-> function");
+        emitComment(f->fn->attr.name);
+    }
+    e->fn = f->fn;
+    e->entry = emitSkip(0);
+    e->next = entries;
+    entries = e;
+
+    nRegs = f->nRegs;
+    slotOf = (int *)malloc((f->nRegs > 0 ? f->nRegs : 1) * sizeof(int));
+    blockLoc = (int *)malloc(f->nBlocks * sizeof(int));
+    for (k = 0; k < f->nBlocks; k++)
+        blockLoc[k] = -1;
+    frameTop = -(FRAME_HEADER + frameSize(f->fn));
+    nSlots = 0;
+    position = 0;
+    assignRegs(f);
+
+    emitRM("ST", ac, RA_OFFSET, mp, "function: store return address");
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        blockLoc[b->id] = emitSkip(0);
+        for (i = b->first; i != NULL; i = i->next, position++)
+            genInst(i, b->next);
+    }
+    for (p = blockPatches; p != NULL; p = p->next)
+    {
+        emitBackup(p->loc);
+        emitRM_Abs(p->op, p->r, blockLoc[p->block->id], "jump");
+        emitRestore();
+    }
+    freePatches(blockPatches);
+    blockPatches = NULL;
+    freeRegAlloc(alloc);
+    free(slotOf);
+    free(blockLoc);
+    if (TraceCode)
+        emitComment("<- function");
+}
+
+/**********************************************/
+/* the primary function of the IR back end    */
+/**********************************************/
+/* Procedure irCodeGen selects TM instructions for
+ * every function of the IR program prog and writes
+ * them to the code file named codefile
+ */
+void irCodeGen(IrFunc *prog, char *codefile)
+{
+    char *s = malloc(strlen(codefile) + 7);
+    IrFunc *f;
+    PatchList p;
+    int mainLoc, mainEntry = -1;
+    strcpy(s, "File: ");
+    strcat(s, codefile);
+    entries = NULL;
+    emitComment("TINY Compilation to TM Code");
+    emitComment(s);
+    /* generate standard prelude */
+    emitComment("Standard prelude:");
+    emitRM("LD", mp, 0, ac, "load maxaddress from location 0");
+    emitRM("ST", ac, 0, ac, "clear location 0");
+    emitRM("LDA", ac, 1, pc, "return address of main");
+    mainLoc = emitSkip(1);
+    emitComment("End of execution.");
+    emitRO("HALT", 0, 0, 0, "");
+    if (CheckBounds)
+    {
+        /* a failed check faults like an access outside dMem */
+        trapLoc = emitSkip(0);
+        emitRM("LD", ac, -1, gp, "bounds check failed");
+    }
+    emitComment("End of standard prelude.");
+    for (f = prog; f != NULL; f = f->next)
+        if (f->fn->child[2] != NULL)
+        {
+            genFunc(f);
+            if (strcmp(f->fn->attr.name, "main") == 0)
+                mainEntry = funcEntry(f->fn);
+        }
+    for (p = callPatches; p != NULL; p = p->next)
+    {
+        emitBackup(p->loc);
+        emitRM_Abs(p->op, p->r, funcEntry(p->fn), "call: jump to function");
+        emitRestore();
+    }
+    freePatches(callPatches);
+    callPatches = NULL;
+    emitBackup(mainLoc);
+    if (mainEntry >= 0)
+        emitRM_Abs("LDA", pc, mainEntry, "jump to main");
+    else
+        emitRO("HALT", 0, 0, 0, "no main function");
+    emitRestore();
+    free(s);
+}
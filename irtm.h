@@ -0,0 +1,23 @@
+/****************************************************/
+/* File: irtm.h                                     */
+/* TM code generation from the IR                   */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _IRTM_H_
+#define _IRTM_H_
+
+#include "ir.h"
+
+/* IR_REGS is the number of TM registers that
+ * hold IR registers
+ */
+#define IR_REGS 3
+
+/* Procedure irCodeGen selects TM instructions for
+ * every function of the IR program prog and writes
+ * them to the code file named codefile
+ */
+void irCodeGen(IrFunc *prog, char *codefile);
+
+#endif
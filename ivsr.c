@@ -0,0 +1,762 @@
+/****************************************************/
+/* File: ivsr.c                                     */
+/* Induction variable strength reduction on the IR  */
+/* for the TINY compiler                            */
+/* A local scalar a loop changes only by constant   */
+/* steps is a counter. Every local or parameter     */
+/* array it subscripts gets a pointer to the        */
+/* element it selects, moved by the same steps, and */
+/* the elements are read at fixed offsets from the  */
+/* pointers. The counter is then only kept as the   */
+/* distance of the first pointer from its array,    */
+/* and stored back at the exit if it is read later. */
+/* Comparing pointers assumes that adding an array  */
+/* address to the bound of the loop cannot          */
+/* overflow. Only code from -i is rewritten; the    */
+/* tree code generator still computes each address  */
+/* from its subscript                               */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "ir.h"
+#include "ivsr.h"
+
+/* MAX_POINTERS bounds the arrays one counter subscripts */
+#define MAX_POINTERS 4
+
+/* the trips a loop is assumed to make when its
+ * savings are weighed against setting it up
+ */
+#define TRIPS 8
+
+static int nCounters; /* counters replaced */
+static int nPointers; /* running pointers introduced */
+static int nAccesses; /* element accesses through a pointer */
+
+static IrFunc *func;
+static IrBlock **blocks; /* layout order */
+static int *position;    /* layout position of every block */
+static int nBlocks;
+static int *useCount; /* reads of every register */
+static int *uses, maxUses;
+
+/* the loop being processed: layout positions first
+ * to last, entered from the preheader and left to
+ * the exit block
+ */
+static int first, last;
+static IrBlock *pre, *head, *latch, *exitB;
+static int hasCall;
+
+/* the ways the loop uses its counter */
+typedef enum
+{
+    AddressSite, /* subscript, at offset delta */
+    StepSite,    /* store of counter + delta */
+    ValueSite    /* any other read */
+} SiteKind;
+
+typedef struct
+{
+    SiteKind kind;
+    IrBlock *block;
+    IrInst *inst;
+    int delta;
+} Site;
+
+static Site *sites;
+static int nSites, maxSites;
+
+static TreeNode *arrays[MAX_POINTERS];
+static int nArrays;
+
+/* half instructions a trip saves, apart from the
+ * steps of the pointers
+ */
+static int saved;
+
+/* the test of the latch, if it can compare a
+ * pointer instead of the counter
+ */
+static IrInst *compare, *testLoad;
+static int boundSide;
+
+static int isCounter(TreeNode *d)
+{
+    return d->nodekind == ExpK && d->scope != globalScope &&
+           (d->kind.exp == VarK || d->kind.exp == SingleParamK);
+}
+
+static int inLoop(IrBlock *b)
+{
+    return position[b->id] >= first && position[b->id] <= last;
+}
+
+static int readsOf(IrInst *i)
+{
+    if (irMaxUses(i) > maxUses)
+    {
+        maxUses = irMaxUses(i);
+        uses = realloc(uses, maxUses * sizeof(int));
+    }
+    return irUses(i, uses);
+}
+
+/* the number of times i reads register r */
+static int readCount(IrInst *i, int r)
+{
+    int n = readsOf(i), k, c = 0;
+    for (k = 0; k < n; k++)
+        c += uses[k] == r;
+    return c;
+}
+
+static void countUses(void)
+{
+    IrBlock *b;
+    IrInst *i;
+    int k, n;
+    useCount = realloc(useCount, (func->nRegs > 0 ? func->nRegs : 1) * sizeof(int));
+    for (k = 0; k < func->nRegs; k++)
+        useCount[k] = 0;
+    for (b = func->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+                useCount[uses[k]]++;
+        }
+}
+
+static IrInst *defIn(IrBlock *b, int r)
+{
+    IrInst *i;
+    for (i = b->first; i != NULL; i = i->next)
+        if (i->dst == r)
+            return i;
+    return NULL;
+}
+
+/* TRUE if an instruction between from and to, of
+ * the same block, stores the scalar sym
+ */
+static int storedBetween(IrInst *from, IrInst *to, TreeNode *sym)
+{
+    for (from = from->next; from != to; from = from->next)
+        if (from->op == IrStore && from->sym == sym)
+            return TRUE;
+    return FALSE;
+}
+
+static int storedInLoop(TreeNode *sym)
+{
+    IrInst *i;
+    int p;
+    for (p = first; p <= last; p++)
+        for (i = blocks[p]->first; i != NULL; i = i->next)
+            if (i->op == IrStore && i->sym == sym)
+                return TRUE;
+    return FALSE;
+}
+
+/* Function invariant returns TRUE if register r of
+ * block b holds the same value on every trip and
+ * can be computed again before the loop
+ */
+static int invariant(IrBlock *b, int r)
+{
+    IrInst *d = defIn(b, r);
+    if (d == NULL)
+        return FALSE;
+    switch (d->op)
+    {
+    case IrConst:
+        return TRUE;
+    case IrLoad:
+        return !storedInLoop(d->sym) && (d->sym->scope != globalScope || !hasCall);
+    case IrAdd:
+    case IrSub:
+    case IrMul:
+        return invariant(b, d->src[0]) && invariant(b, d->src[1]);
+    default:
+        return FALSE;
+    }
+}
+
+/* Function emitPre adds an instruction to the end
+ * of the preheader, before its jump
+ */
+static IrInst *emitPre(IrOp op, int a, int b)
+{
+    IrInst *i = irNewInst(op);
+    i->dst = irNewReg(func);
+    i->src[0] = a;
+    i->src[1] = b;
+    irInsertBefore(pre, pre->last, i);
+    return i;
+}
+
+/* Function copyToPre computes the invariant
+ * register r of block b again in the preheader
+ */
+static int copyToPre(IrBlock *b, int r)
+{
+    IrInst *d = defIn(b, r), *c;
+    int x = NO_REG, y = NO_REG;
+    if (d->op != IrConst && d->op != IrLoad)
+    {
+        x = copyToPre(b, d->src[0]);
+        y = copyToPre(b, d->src[1]);
+    }
+    c = emitPre(d->op, x, y);
+    c->imm = d->imm;
+    c->sym = d->sym;
+    return c->dst;
+}
+
+/**************************************************/
+/*************   loops   **************************/
+/**************************************************/
+
+static void layoutBlocks(void)
+{
+    IrBlock *b;
+    blocks = realloc(blocks, (func->nBlocks > 0 ? func->nBlocks : 1) * sizeof(IrBlock *));
+    position = realloc(position, (func->nBlocks > 0 ? func->nBlocks : 1) * sizeof(int));
+    nBlocks = 0;
+    for (b = func->entry; b != NULL; b = b->next)
+    {
+        position[b->id] = nBlocks;
+        blocks[nBlocks++] = b;
+    }
+}
+
+/* Function newBlockAfter adds a block ending in a
+ * jump to target to the layout right after b
+ */
+static IrBlock *newBlockAfter(IrBlock *b, IrBlock *target)
+{
+    IrBlock *end = func->last, *n = irNewBlock(func);
+    IrInst *j = irNewInst(IrJump);
+    j->target[0] = target;
+    irAppend(n, j);
+    if (end != b)
+    {
+        end->next = NULL;
+        func->last = end;
+        n->next = b->next;
+        b->next = n;
+    }
+    return n;
+}
+
+/* Function findLoop returns TRUE if block l is the
+ * latch of a loop of the shape irgen.c gives a
+ * rotated while loop, and makes it current
+ */
+static int findLoop(IrBlock *l)
+{
+    IrInst *t = l->last, *i;
+    IrBlock *b;
+    int p, k;
+    if (t->op != IrBranch || t->target[0] == t->target[1])
+        return FALSE;
+    head = t->target[0];
+    exitB = t->target[1];
+    first = position[head->id];
+    last = position[l->id];
+    if (first == 0 || first > last || inLoop(exitB))
+        return FALSE;
+    latch = l;
+    pre = blocks[first - 1];
+    if (pre->last->op != IrBranch || pre->last->target[0] != head ||
+        pre->last->target[1] != exitB)
+        return FALSE;
+    /* entered only from the preheader, and the exit
+     * is reached only from the guard and the latch
+     */
+    for (p = first; p <= last; p++)
+        for (k = 0; k < blocks[p]->npred; k++)
+        {
+            b = blocks[p]->pred[k];
+            if (!inLoop(b) && (blocks[p] != head || b != pre))
+                return FALSE;
+        }
+    for (k = 0; k < exitB->npred; k++)
+        if (exitB->pred[k] != pre && exitB->pred[k] != latch)
+            return FALSE;
+    hasCall = FALSE;
+    for (p = first; p <= last; p++)
+        for (i = blocks[p]->first; i != NULL; i = i->next)
+            if (i->op == IrCall)
+                hasCall = TRUE;
+    return TRUE;
+}
+
+static int reachesLatch(IrBlock *b)
+{
+    int k;
+    if (b == latch)
+        return TRUE;
+    if (b->mark || !inLoop(b))
+        return FALSE;
+    b->mark = TRUE;
+    for (k = 0; k < b->nsucc; k++)
+        if (reachesLatch(b->succ[k]))
+            return TRUE;
+    return FALSE;
+}
+
+/* Function weight returns 2 for a block every trip
+ * runs and 1 for one only some trips run
+ */
+static int weight(IrBlock *b)
+{
+    int p;
+    if (b == head || b == latch)
+        return 2;
+    for (p = first; p <= last; p++)
+        blocks[p]->mark = FALSE;
+    b->mark = TRUE;
+    return reachesLatch(head) ? 1 : 2;
+}
+
+/* Function readFirst returns TRUE if a path from b
+ * reads the scalar sym before storing it
+ */
+static int readFirst(IrBlock *b, TreeNode *sym)
+{
+    IrInst *i;
+    int k;
+    if (b->mark)
+        return FALSE;
+    b->mark = TRUE;
+    for (i = b->first; i != NULL; i = i->next)
+        if (i->op == IrLoad && i->sym == sym)
+            return TRUE;
+        else if (i->op == IrStore && i->sym == sym)
+            return FALSE;
+    for (k = 0; k < b->nsucc; k++)
+        if (readFirst(b->succ[k], sym))
+            return TRUE;
+    return FALSE;
+}
+
+/* TRUE if block b ends in a branch back to the
+ * head of a loop
+ */
+static int isLatch(IrBlock *b)
+{
+    IrInst *t = b->last;
+    return t->op == IrBranch && position[t->target[0]->id] <= position[b->id];
+}
+
+/* TRUE if block b leaves a loop, directly or
+ * through the block storing its counter back
+ */
+static int leavesLoop(IrBlock *b)
+{
+    if (b->last->op == IrJump && b->npred == 1)
+        return isLatch(b->pred[0]);
+    return isLatch(b);
+}
+
+/* Function continues returns TRUE if the loop goes
+ * on counting where the loop before it stopped, as
+ * the one left for the trips unrolling cannot
+ * group does, and so makes few trips
+ */
+static int continues(TreeNode *counter)
+{
+    IrInst *i;
+    int k;
+    for (i = pre->first; i != NULL; i = i->next)
+        if (i->op == IrStore && i->sym == counter)
+            return FALSE;
+    for (k = 0; k < pre->npred; k++)
+        if (leavesLoop(pre->pred[k]))
+            return TRUE;
+    return FALSE;
+}
+
+/**************************************************/
+/*************   counters   ***********************/
+/**************************************************/
+
+static void addSite(SiteKind kind, IrBlock *b, IrInst *i, int delta)
+{
+    if (nSites == maxSites)
+    {
+        maxSites = maxSites ? 2 * maxSites : 16;
+        sites = realloc(sites, maxSites * sizeof(Site));
+    }
+    sites[nSites].kind = kind;
+    sites[nSites].block = b;
+    sites[nSites].inst = i;
+    sites[nSites].delta = delta;
+    nSites++;
+}
+
+static int pointerOf(TreeNode *array)
+{
+    int k;
+    for (k = 0; k < nArrays; k++)
+        if (arrays[k] == array)
+            return k;
+    return -1;
+}
+
+/* TRUE if u uses register r, read from counter by
+ * ld, only to subscript a local or parameter array
+ */
+static int isSubscript(IrInst *ld, IrInst *u, int r)
+{
+    if (u->op != IrLoadX && (u->op != IrStoreX || u->src[1] == r))
+        return FALSE;
+    return u->src[0] == r && u->sym->scope != globalScope &&
+           !storedBetween(ld, u, ld->sym);
+}
+
+/* Function offsetOf returns TRUE if u computes
+ * r + c or r - c, setting delta to +c or -c
+ */
+static int offsetOf(IrBlock *b, IrInst *u, int r, int *delta)
+{
+    IrInst *c;
+    if (u->op == IrAdd && u->src[0] == r && u->src[1] != r)
+        c = defIn(b, u->src[1]);
+    else if ((u->op == IrAdd || u->op == IrSub) && u->src[1] == r && u->src[0] != r)
+        c = u->op == IrAdd ? defIn(b, u->src[0]) : NULL;
+    else if (u->op == IrSub && u->src[0] == r && u->src[1] != r)
+        c = defIn(b, u->src[1]);
+    else
+        return FALSE;
+    if (c == NULL || c->op != IrConst)
+        return FALSE;
+    *delta = u->op == IrSub ? -c->imm : c->imm;
+    return TRUE;
+}
+
+/* an element of an array parameter is found from
+ * its address, which a pointer saves loading
+ */
+static int isParam(TreeNode *array)
+{
+    return array->kind.exp == ArrayParamK;
+}
+
+/* Function classify records the uses of the value
+ * ld reads from the counter in block b, and what
+ * replacing them saves, returning FALSE if some
+ * are outside the block
+ */
+static int classify(IrBlock *b, IrInst *ld)
+{
+    IrInst *u, *v;
+    int r = ld->dst, w = weight(b), value = FALSE, seen = 0;
+    int seenSum, delta, dies;
+    for (u = ld->next; u != NULL; u = u->next)
+    {
+        int n = readCount(u, r);
+        if (n == 0)
+            continue;
+        seen += n;
+        if (isSubscript(ld, u, r))
+        {
+            addSite(AddressSite, b, u, 0);
+            saved += w * isParam(u->sym);
+        }
+        else if (offsetOf(b, u, r, &delta))
+        {
+            seenSum = 0;
+            dies = TRUE;
+            for (v = u->next; v != NULL; v = v->next)
+            {
+                n = readCount(v, u->dst);
+                if (n == 0)
+                    continue;
+                seenSum += n;
+                if (v->op == IrStore && v->sym == ld->sym && !storedBetween(ld, v, ld->sym))
+                    addSite(StepSite, b, v, delta);
+                else if (isSubscript(ld, v, u->dst))
+                {
+                    addSite(AddressSite, b, v, delta);
+                    saved += w * isParam(v->sym);
+                }
+                else
+                {
+                    /* counter + c is read as a value */
+                    value = TRUE;
+                    dies = FALSE;
+                }
+            }
+            if (seenSum != useCount[u->dst])
+                return FALSE;
+            /* the constant and the addition go */
+            if (dies)
+                saved += 2 * w;
+        }
+        else
+            value = TRUE;
+    }
+    /* the load goes, or becomes the difference of
+     * two words
+     */
+    if (value)
+    {
+        addSite(ValueSite, b, ld, 0);
+        saved -= 2 * w;
+    }
+    else
+        saved += w;
+    return seen == useCount[r];
+}
+
+/* Procedure findCompare looks for a latch test of
+ * counter against an invariant bound
+ */
+static void findCompare(TreeNode *counter)
+{
+    IrInst *c = defIn(latch, latch->last->src[0]), *ld;
+    int k;
+    compare = testLoad = NULL;
+    if (c == NULL || c->op < IrLt || c->op > IrNe)
+        return;
+    for (k = 0; k < 2; k++)
+    {
+        ld = defIn(latch, c->src[k]);
+        if (ld != NULL && ld->op == IrLoad && ld->sym == counter &&
+            useCount[ld->dst] == 1 && !storedBetween(ld, c, counter) &&
+            invariant(latch, c->src[1 - k]))
+        {
+            compare = c;
+            testLoad = ld;
+            boundSide = 1 - k;
+            return;
+        }
+    }
+}
+
+/* Function gain estimates, in half instructions,
+ * what one trip saves when counter is replaced
+ */
+static int gain(void)
+{
+    int k, g = saved;
+    /* the store of a step becomes a load, add and
+     * store of every pointer
+     */
+    for (k = 0; k < nSites; k++)
+        if (sites[k].kind == StepSite)
+            g += weight(sites[k].block) * (1 - 3 * nArrays);
+    return g;
+}
+
+/* Procedure replace rewrites the loop to use the
+ * pointers instead of counter, which is stored
+ * back on leaving the loop if live
+ */
+static void replace(TreeNode *counter, int live)
+{
+    int base[MAX_POINTERS], ptr[MAX_POINTERS];
+    int count, k, j;
+    IrInst *i, *s;
+    IrBlock *b;
+
+    /* the pointers are set up in a block of their
+     * own, run only if the guard enters the loop
+     */
+    b = newBlockAfter(pre, head);
+    pre->last->target[0] = b;
+    pre = b;
+    i = emitPre(IrLoad, NO_REG, NO_REG);
+    i->sym = counter;
+    count = i->dst;
+    for (k = 0; k < nArrays; k++)
+    {
+        i = emitPre(IrAddr, NO_REG, NO_REG);
+        i->sym = arrays[k];
+        base[k] = i->dst;
+        ptr[k] = emitPre(IrAdd, base[k], count)->dst;
+    }
+    if (compare != NULL)
+    {
+        k = copyToPre(latch, compare->src[boundSide]);
+        compare->src[boundSide] = emitPre(IrAdd, base[0], k)->dst;
+        compare->src[1 - boundSide] = ptr[0];
+    }
+
+    for (k = 0; k < nSites; k++)
+    {
+        i = sites[k].inst;
+        switch (sites[k].kind)
+        {
+        case AddressSite:
+            i->op = i->op == IrLoadX ? IrLoadP : IrStoreP;
+            i->src[0] = ptr[pointerOf(i->sym)];
+            i->imm = sites[k].delta;
+            nAccesses++;
+            break;
+        case StepSite:
+            for (j = 1; j < nArrays; j++)
+            {
+                s = irNewInst(IrAddI);
+                s->dst = s->src[0] = ptr[j];
+                s->imm = sites[k].delta;
+                irInsertBefore(sites[k].block, i, s);
+            }
+            i->op = IrAddI;
+            i->dst = i->src[0] = ptr[0];
+            i->imm = sites[k].delta;
+            i->sym = NULL;
+            break;
+        case ValueSite:
+            i->op = IrSub;
+            i->src[0] = ptr[0];
+            i->src[1] = base[0];
+            i->sym = NULL;
+            break;
+        }
+    }
+
+    if (live)
+    {
+        b = newBlockAfter(latch, latch->last->target[1]);
+        latch->last->target[1] = b;
+        s = irNewInst(IrSub);
+        s->dst = irNewReg(func);
+        s->src[0] = ptr[0];
+        s->src[1] = base[0];
+        i = irNewInst(IrStore);
+        i->src[0] = s->dst;
+        i->sym = counter;
+        irInsertBefore(b, b->last, s);
+        irInsertBefore(b, b->last, i);
+    }
+    irComputeCfg(func);
+    layoutBlocks();
+    nCounters++;
+    nPointers += nArrays;
+}
+
+/* Function reduceCounter replaces the scalar
+ * counter of the current loop if that pays
+ */
+static int reduceCounter(TreeNode *counter)
+{
+    IrBlock *b;
+    IrInst *i;
+    int p, k, live, setup, stores = 0, steps = 0;
+    countUses();
+    nSites = nArrays = saved = 0;
+    findCompare(counter);
+    for (p = first; p <= last; p++)
+        for (i = blocks[p]->first; i != NULL; i = i->next)
+            if (i->sym != counter)
+                continue;
+            else if (i->op == IrStore)
+                stores++;
+            else if (i->op == IrLoad && i != testLoad && !classify(blocks[p], i))
+                return FALSE;
+    for (k = 0; k < nSites; k++)
+        if (sites[k].kind == StepSite)
+            steps++;
+        else if (sites[k].kind == AddressSite && pointerOf(sites[k].inst->sym) < 0)
+        {
+            if (nArrays == MAX_POINTERS)
+                return FALSE;
+            arrays[nArrays++] = sites[k].inst->sym;
+        }
+    /* every change of the counter must be a step */
+    if (steps != stores || nArrays == 0 || continues(counter))
+        return FALSE;
+    for (b = func->entry; b != NULL; b = b->next)
+        b->mark = FALSE;
+    live = readFirst(exitB, counter);
+    /* instructions run each time the loop is entered */
+    setup = 1 + 4 * nArrays + (compare != NULL ? 4 : 0) + (live ? 4 : 0);
+    if (gain() * TRIPS <= 2 * setup)
+        return FALSE;
+    replace(counter, live);
+    return TRUE;
+}
+
+static int firstStore(IrInst *st)
+{
+    IrInst *i;
+    int p;
+    for (p = first; p <= last; p++)
+        for (i = blocks[p]->first; i != NULL; i = i->next)
+            if (i == st)
+                return TRUE;
+            else if (i->op == IrStore && i->sym == st->sym)
+                return FALSE;
+    return FALSE;
+}
+
+/* Function reduceLoop tries every scalar the
+ * current loop stores as a counter
+ */
+static int reduceLoop(void)
+{
+    IrInst *i;
+    int p, changed = FALSE;
+    for (p = first; p <= last; p++)
+        for (i = blocks[p]->first; i != NULL; i = i->next)
+            if (i->op == IrStore && isCounter(i->sym) && firstStore(i) &&
+                reduceCounter(i->sym))
+            {
+                /* the layout changed: start over */
+                first = position[head->id];
+                last = position[latch->id];
+                p = first - 1;
+                changed = TRUE;
+                break;
+            }
+    return changed;
+}
+
+/* Function reduceInductions replaces the element
+ * addresses a loop computes from a counter by
+ * running pointers, and the counter by one of them,
+ * and returns the number of counters and accesses
+ * replaced
+ */
+int reduceInductions(IrFunc *prog)
+{
+    IrBlock *b;
+    int p, changed;
+    nCounters = nPointers = nAccesses = 0;
+    for (func = prog; func != NULL; func = func->next)
+    {
+        layoutBlocks();
+        /* inner loops end first in the layout */
+        changed = FALSE;
+        for (p = 0; p < nBlocks; p++)
+            if (findLoop(blocks[p]) && reduceLoop())
+            {
+                changed = TRUE;
+                p = position[latch->id];
+            }
+        if (changed)
+            irSweep(func);
+        for (b = func->entry; b != NULL; b = b->next)
+            b->mark = FALSE;
+    }
+    free(blocks);
+    free(position);
+    free(useCount);
+    free(uses);
+    free(sites);
+    blocks = NULL;
+    position = useCount = uses = NULL;
+    sites = NULL;
+    maxUses = maxSites = 0;
+    if (TraceAnalyze)
+        fprintf(listing, "\nInduction variables: %d counters replaced by %d pointers, "
+                         "%d element accesses through pointers\n",
+                nCounters, nPointers, nAccesses);
+    return nCounters + nAccesses;
+}
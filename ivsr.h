@@ -0,0 +1,20 @@
+/****************************************************/
+/* File: ivsr.h                                     */
+/* Induction variable strength reduction on the IR  */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _IVSR_H_
+#define _IVSR_H_
+
+#include "ir.h"
+
+/* Function reduceInductions replaces the element
+ * addresses a loop computes from a counter by
+ * running pointers, and the counter by one of them,
+ * and returns the number of counters and accesses
+ * replaced
+ */
+int reduceInductions(IrFunc *prog);
+
+#endif
@@ -0,0 +1,314 @@
+/****************************************************/
+/* File: licm.c                                     */
+/* Loop-invariant code motion                       */
+/* for the TINY compiler                            */
+/* A while loop that computes values it cannot      */
+/* change is wrapped in a block that computes them  */
+/* once into new locals before the loop. Only what  */
+/* cannot trap is moved out of the body, which may  */
+/* never run; array elements are moved only out of  */
+/* a test without side effects                      */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "licm.h"
+
+static int nHoisted; /* expressions hoisted */
+static int nLoops;   /* loops given a preheader */
+
+/* what the loop being processed changes */
+static TreeNode **written; /* scalar declarations assigned */
+static int nWritten, maxWritten;
+static TreeNode **stores; /* array elements assigned */
+static int nStores, maxStores;
+static int hasCall; /* the loop calls a user function */
+
+/* the preheader being built */
+static ScopeList preScope;
+static TreeNode *preDecls;
+static TreeNode *preStmts;
+
+static TreeNode **push(TreeNode **list, int *n, int *max, TreeNode *t)
+{
+    if (*n == *max)
+    {
+        *max = *max ? 2 * *max : 16;
+        list = realloc(list, *max * sizeof(TreeNode *));
+    }
+    list[(*n)++] = t;
+    return list;
+}
+
+static int isNonzero(TreeNode *t)
+{
+    return t->nodekind == ExpK && t->kind.exp == ConstK && t->attr.val != 0;
+}
+
+/* Procedure collect records the variables and
+ * array elements the code t assigns and whether
+ * it calls a user function
+ */
+static void collect(TreeNode *t)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == AssignK)
+        {
+            if (t->child[0]->kind.exp == ArrayIdK)
+                stores = push(stores, &nStores, &maxStores, t->child[0]);
+            else
+                written = push(written, &nWritten, &maxWritten, declOf(t->child[0]));
+        }
+        else if (t->nodekind == ExpK && t->kind.exp == CallK &&
+                 t->bucket != NULL && t->bucket->treeNode->child[2] != NULL)
+            hasCall = TRUE;
+        for (i = 0; i < MAXCHILDREN; i++)
+            collect(t->child[i]);
+    }
+}
+
+/* Function invariant returns TRUE if the value of
+ * t cannot change while the loop runs. Array
+ * elements count only if arrays is TRUE
+ */
+static int invariant(TreeNode *t, int arrays)
+{
+    TreeNode *d;
+    int i;
+    if (t->nodekind != ExpK)
+        return FALSE;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return TRUE;
+    case IdK:
+        d = declOf(t);
+        if (d == NULL || (d->kind.exp != VarK && d->kind.exp != SingleParamK))
+            return FALSE;
+        if (hasCall && d->scope == globalScope)
+            return FALSE;
+        for (i = 0; i < nWritten; i++)
+            if (written[i] == d)
+                return FALSE;
+        return TRUE;
+    case OpK:
+        /* a division is moved only if it cannot trap */
+        if (t->attr.op == OVER && !isNonzero(t->child[1]))
+            return FALSE;
+        return invariant(t->child[0], arrays) && invariant(t->child[1], arrays);
+    case ArrayIdK:
+        if (!arrays || hasCall || !invariant(t->child[0], arrays))
+            return FALSE;
+        for (i = 0; i < nStores; i++)
+            if (mayAlias(t, stores[i]))
+                return FALSE;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static int sameExp(TreeNode *a, TreeNode *b)
+{
+    if (a->nodekind != b->nodekind || a->kind.exp != b->kind.exp)
+        return FALSE;
+    switch (a->kind.exp)
+    {
+    case ConstK:
+        return a->attr.val == b->attr.val;
+    case IdK:
+        return a->bucket == b->bucket;
+    case ArrayIdK:
+        return a->bucket == b->bucket && sameExp(a->child[0], b->child[0]);
+    case OpK:
+        return a->attr.op == b->attr.op && sameExp(a->child[0], b->child[0]) &&
+               sameExp(a->child[1], b->child[1]);
+    default:
+        return FALSE;
+    }
+}
+
+/* Procedure hoist moves the invariant expression t
+ * to the preheader, or reuses the local an equal
+ * expression was moved to, and reads that local
+ */
+static void hoist(TreeNode *t)
+{
+    TreeNode *h, *d, *e;
+    for (h = preStmts; h != NULL; h = h->sibling)
+        if (sameExp(h->child[1], t))
+            break;
+    if (h == NULL)
+    {
+        d = newExpNode(VarK);
+        d->attr.name = "inv";
+        d->type = Integer;
+        d->lineno = t->lineno;
+        st_declare(preScope, d);
+        preDecls = dangleTree(preDecls, d);
+        e = allocTree();
+        *e = *t;
+        e->sibling = NULL;
+        h = newExpNode(AssignK);
+        h->child[0] = newExpNode(IdK);
+        h->child[0]->attr.name = d->attr.name;
+        h->child[0]->bucket = d->bucket;
+        h->child[0]->type = Integer;
+        h->child[1] = e;
+        h->type = Integer;
+        h->lineno = t->lineno;
+        preStmts = dangleTree(preStmts, h);
+        nHoisted++;
+    }
+    t->kind.exp = IdK;
+    t->child[0] = t->child[1] = NULL;
+    t->attr.name = h->child[0]->attr.name;
+    t->bucket = h->child[0]->bucket;
+    t->type = Integer;
+}
+
+static void hoistExp(TreeNode *t, int arrays)
+{
+    TreeNode *c;
+    int i;
+    if (t == NULL || t->nodekind != ExpK)
+        return;
+    switch (t->kind.exp)
+    {
+    case OpK:
+    case ArrayIdK:
+        if (invariant(t, arrays))
+        {
+            hoist(t);
+            return;
+        }
+        break;
+    case AssignK:
+        if (t->child[0]->kind.exp == ArrayIdK)
+            hoistExp(t->child[0]->child[0], arrays);
+        hoistExp(t->child[1], arrays);
+        return;
+    default:
+        break;
+    }
+    for (i = 0; i < MAXCHILDREN; i++)
+        for (c = t->child[i]; c != NULL; c = c->sibling)
+            hoistExp(c, arrays);
+}
+
+static void hoistStmts(TreeNode *t)
+{
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK)
+        {
+            hoistExp(t, FALSE);
+            continue;
+        }
+        switch (t->kind.stmt)
+        {
+        case CompoundK:
+            hoistStmts(t->child[1]);
+            break;
+        case IfK:
+            hoistExp(t->child[0], FALSE);
+            hoistStmts(t->child[1]);
+            hoistStmts(t->child[2]);
+            break;
+        case WhileK:
+            hoistExp(t->child[0], FALSE);
+            hoistStmts(t->child[1]);
+            break;
+        case ReturnK:
+            hoistExp(t->child[0], FALSE);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Procedure hoistLoop gives the while loop w, whose
+ * locals live in scope, a preheader holding its
+ * invariant expressions
+ */
+static void hoistLoop(TreeNode *w, ScopeList scope)
+{
+    TreeNode *loop;
+    nWritten = nStores = 0;
+    hasCall = FALSE;
+    collect(w->child[0]);
+    collect(w->child[1]);
+    preScope = sc_create(scope->name);
+    preScope->loc = scope->loc;
+    preDecls = preStmts = NULL;
+    /* the test always runs, so it may read elements */
+    hoistExp(w->child[0], isPureExp(w->child[0]));
+    hoistStmts(w->child[1]);
+    if (preStmts == NULL)
+        return;
+    loop = allocTree();
+    *loop = *w;
+    loop->sibling = NULL;
+    sc_shift(loop, preScope->loc - scope->loc);
+    w->kind.stmt = CompoundK;
+    w->child[0] = preDecls;
+    w->child[1] = dangleTree(preStmts, loop);
+    w->child[2] = NULL;
+    w->scope = preScope;
+    nLoops++;
+}
+
+static void licmStmt(TreeNode *t, ScopeList scope)
+{
+    TreeNode *s;
+    if (t == NULL || t->nodekind != StmtK)
+        return;
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        if (t->scope != NULL)
+            scope = t->scope;
+        for (s = t->child[1]; s != NULL; s = s->sibling)
+            licmStmt(s, scope);
+        break;
+    case IfK:
+        licmStmt(t->child[1], scope);
+        licmStmt(t->child[2], scope);
+        break;
+    case WhileK:
+        licmStmt(t->child[1], scope);
+        hoistLoop(t, scope);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Function hoistInvariants computes the values a
+ * while loop cannot change once, in a preheader
+ * block run before the loop, innermost loops first,
+ * and returns the number of expressions hoisted
+ */
+int hoistInvariants(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    nHoisted = nLoops = 0;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+        if (t->nodekind == StmtK && t->kind.stmt == FunctionK && t->child[2] != NULL)
+            licmStmt(t->child[2], t->child[2]->scope);
+    free(written);
+    free(stores);
+    written = stores = NULL;
+    maxWritten = maxStores = 0;
+    if (TraceAnalyze)
+        fprintf(listing, "\nLoop-invariant code motion: %d expressions hoisted "
+                         "out of %d loops\n",
+                nHoisted, nLoops);
+    return nHoisted;
+}
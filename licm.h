@@ -0,0 +1,17 @@
+/****************************************************/
+/* File: licm.h                                     */
+/* Loop-invariant code motion                       */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _LICM_H_
+#define _LICM_H_
+
+/* Function hoistInvariants computes the values a
+ * while loop cannot change once, in a preheader
+ * block run before the loop, innermost loops first,
+ * and returns the number of expressions hoisted
+ */
+int hoistInvariants(TreeNode *syntaxTree);
+
+#endif
@@ -6,6 +6,7 @@
 /****************************************************/
 
 #include "globals.h"
+#include <time.h>
 
 /* set NO_PARSE to TRUE to get a scanner-only compiler */
 #define NO_PARSE FALSE
@@ -22,10 +23,29 @@
 #include "scan.h"
 #else
 #include "parse.h"
+#include "profile.h"
 #if !NO_ANALYZE
 #include "analyze.h"
+#include "alias.h"
+#include "range.h"
+#include "dataflow.h"
+#include "fold.h"
+#include "dce.h"
+#include "inline.h"
+#include "spec.h"
+#include "licm.h"
+#include "unroll.h"
+#include "memo.h"
+#include "ir.h"
+#include "ivsr.h"
+#include "strength.h"
+#include "gvn.h"
+#include "regalloc.h"
 #if !NO_CODE
+#include "code.h"
 #include "cgen.h"
+#include "irgen.h"
+#include "irtm.h"
 #endif
 #endif
 #endif
@@ -35,6 +55,7 @@ int lineno = 0;
 FILE *source;
 FILE *listing;
 FILE *code;
+FILE *map = NULL;
 
 /* allocate and set tracing flags */
 int EchoSource = FALSE;
@@ -43,20 +64,400 @@ int TraceParse = FALSE;
 int TraceAnalyze = TRUE;
 int TraceCode = FALSE;
 
+/* set by the -b, -i, -d, -O<level> and -c options */
+int CheckBounds = FALSE;
+int GenIR = FALSE;
+int TraceIR = FALSE;
+int Optimize = FALSE;
+int OptimizeSize = FALSE;
+int CycleCost = FALSE;
+
+/* set by the -p, -P and -s options */
+static int WriteMap = FALSE;
+static int UseProfile = FALSE;
+static int PassStats = FALSE;
+
+/* the -O level: 0 to 2, -O meaning -O2 and -Os
+ * -O2 without the passes that grow code
+ */
+static int OptLevel = 0;
+#define MAX_LEVEL 2
+
+/* set by the -I<n>, -U<n> and -M<n> options */
+int InlineLimit = 12;
+int UnrollFactor = 4;
+int MemoSize = 0;
+
 int Error = FALSE;
 
+#if !NO_PARSE && !NO_ANALYZE
+/* Function codeSize returns the number of TM
+ * instructions the selected code generator
+ * produces for the syntax tree
+ */
+static int codeSize(TreeNode *syntaxTree)
+{
+    int size = 0;
+#if !NO_CODE
+    FILE *saved = code;
+    code = NULL;
+    emitReset();
+    if (GenIR)
+    {
+        IrFunc *ir = irGen(syntaxTree);
+        irCodeGen(ir, "");
+        irFree(ir);
+    }
+    else
+        codeGen(syntaxTree, "");
+    size = emitSize();
+    emitReset();
+    code = saved;
+#endif
+    return size;
+}
+
+static long treeSize(TreeNode *t)
+{
+    long n = 0;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        n++;
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += treeSize(t->child[i]);
+    }
+    return n;
+}
+
+static long irSize(IrFunc *prog)
+{
+    IrBlock *b;
+    IrInst *i;
+    long n = 0;
+    for (; prog != NULL; prog = prog->next)
+        for (b = prog->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = i->next)
+                n++;
+    return n;
+}
+
+/* Function now returns the time in milliseconds
+ * on the monotonic clock, which setting the system
+ * clock does not move
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double msSince(double start)
+{
+    return now() - start;
+}
+
+/**************************************************/
+/*****************   analyses   *******************/
+/**************************************************/
+
+/* the analyses the passes consult, computed when
+ * first needed and kept until a pass changes what
+ * they describe
+ */
+#define ALIAS_INFO 1
+#define RANGE_INFO 2
+#define ALL_INFO (ALIAS_INFO | RANGE_INFO)
+
+typedef struct
+{
+    char *title;
+    int info;
+    void (*run)(TreeNode *);
+    int runs;
+    double ms;
+} Analysis;
+
+static Analysis analyses[] = {
+    {.title = "Alias analysis", .info = ALIAS_INFO, .run = aliasAnalysis},
+    {.title = "Range analysis", .info = RANGE_INFO, .run = rangeAnalysis},
+};
+
+#define N_ANALYSES ((int)(sizeof(analyses) / sizeof(analyses[0])))
+
+static int validInfo = 0; /* the analyses still valid */
+
+/* Procedure ensureInfo recomputes the analyses in
+ * needs that are not valid
+ */
+static void ensureInfo(TreeNode *syntaxTree, int needs)
+{
+    double start;
+    int k;
+    for (k = 0; k < N_ANALYSES; k++)
+        if ((needs & analyses[k].info) && !(validInfo & analyses[k].info))
+        {
+            start = now();
+            analyses[k].run(syntaxTree);
+            analyses[k].ms += msSince(start);
+            analyses[k].runs++;
+            validInfo |= analyses[k].info;
+        }
+}
+
+/**************************************************/
+/******************   passes   ********************/
+/**************************************************/
+
+/* a step of the pipeline, on the syntax tree or
+ * on the IR, returning the changes it made
+ */
+typedef struct
+{
+    char *name;                  /* as in -f<name> and -fno-<name> */
+    char *title;                 /* as in the listing */
+    int (*treePass)(TreeNode *); /* NULL for a pass on the IR */
+    int (*irPass)(IrFunc *);
+    int level;   /* the lowest -O level that runs it */
+    int forSize; /* -Os runs it */
+    int needs;   /* the analyses it consults */
+    int keeps;   /* the analyses still valid after it */
+    int forced, disabled; /* by -f<name> and -fno-<name> */
+    int runs, changes;
+    long treeDelta, irDelta;
+    double ms;
+} Pass;
+
+static Pass passes[] = {
+    /* evaluates the calls with constant arguments
+       before they are inlined or specialized */
+    {.name = "fold", .title = "Constant folding", .treePass = constantFold,
+     .level = 2, .forSize = TRUE, .needs = 0, .keeps = ALIAS_INFO},
+    {.name = "inline", .title = "Inlining", .treePass = inlineCalls, .level = 2,
+     .forSize = TRUE, .needs = 0, .keeps = 0},
+    {.name = "spec", .title = "Specialization", .treePass = specializeCalls,
+     .level = 2, .forSize = FALSE, .needs = 0, .keeps = 0},
+    {.name = "fold", .title = "Constant folding", .treePass = constantFold,
+     .level = 1, .forSize = TRUE, .needs = 0, .keeps = ALIAS_INFO},
+    {.name = "dce", .title = "Dead code elimination", .treePass = deadCodeElim,
+     .level = 1, .forSize = TRUE, .needs = 0, .keeps = ALIAS_INFO},
+    {.name = "unroll", .title = "Loop unrolling", .treePass = unrollLoops,
+     .level = 2, .forSize = FALSE, .needs = ALIAS_INFO, .keeps = 0},
+    /* the copies of a body see the values of their trip */
+    {.name = "fold", .title = "Constant folding", .treePass = constantFold,
+     .level = 1, .forSize = TRUE, .needs = 0, .keeps = ALIAS_INFO},
+    {.name = "dce", .title = "Dead code elimination", .treePass = deadCodeElim,
+     .level = 1, .forSize = TRUE, .needs = 0, .keeps = ALIAS_INFO},
+    {.name = "licm", .title = "Loop-invariant code motion",
+     .treePass = hoistInvariants, .level = 1, .forSize = TRUE,
+     .needs = ALIAS_INFO, .keeps = ALIAS_INFO},
+    /* after folding, which evaluates calls of pure functions;
+       only with -M<n> or -fmemo */
+    {.name = "memo", .title = "Memoization", .treePass = memoizeFunctions,
+     .level = MAX_LEVEL + 1, .forSize = TRUE, .needs = 0, .keeps = 0},
+    {.name = "ivsr", .title = "Induction variables", .irPass = reduceInductions,
+     .level = 2, .forSize = TRUE, .needs = 0, .keeps = ALL_INFO},
+    {.name = "gvn", .title = "Value numbering", .irPass = numberValues,
+     .level = 1, .forSize = TRUE, .needs = ALIAS_INFO, .keeps = ALL_INFO},
+    {.name = "strength", .title = "Strength reduction",
+     .irPass = reduceStrength, .level = 1, .forSize = TRUE, .needs = 0,
+     .keeps = ALL_INFO},
+    /* last, for the allocation of irtm.c */
+    {.name = "promote", .title = "Local promotion", .irPass = promoteLocals,
+     .level = 1, .forSize = TRUE, .needs = 0, .keeps = ALL_INFO},
+};
+
+#define N_PASSES ((int)(sizeof(passes) / sizeof(passes[0])))
+
+/* Function switchPass forces the passes named name
+ * on or off, and returns FALSE if there are none
+ */
+static int switchPass(char *name, int on)
+{
+    int k, found = FALSE;
+    for (k = 0; k < N_PASSES; k++)
+        if (strcmp(passes[k].name, name) == 0)
+        {
+            if (on)
+                passes[k].forced = TRUE;
+            else
+                passes[k].disabled = TRUE;
+            found = TRUE;
+        }
+    return found;
+}
+
+static int enabled(Pass *p)
+{
+    if (p->disabled)
+        return FALSE;
+    return p->forced || (OptLevel >= p->level && (p->forSize || !OptimizeSize));
+}
+
+/* Procedure runPass runs the tree optimization
+ * pass p after the analyses it needs and, when
+ * tracing, reports how many TM instructions it
+ * saved
+ */
+static void runPass(Pass *p, TreeNode *syntaxTree)
+{
+    int size;
+    long nodes;
+    double start;
+    if (!enabled(p))
+        return;
+    ensureInfo(syntaxTree, p->needs);
+    size = TraceAnalyze ? codeSize(syntaxTree) : 0;
+    nodes = treeSize(syntaxTree);
+    start = now();
+    p->changes += p->treePass(syntaxTree);
+    p->ms += msSince(start);
+    p->runs++;
+    p->treeDelta += treeSize(syntaxTree) - nodes;
+    validInfo &= p->keeps;
+    if (TraceAnalyze)
+        fprintf(listing, "%s saved %d TM instructions\n",
+                p->title, size - codeSize(syntaxTree));
+}
+
+/* Procedure runIRPass runs the IR optimization
+ * pass p on ir after the analyses it needs
+ */
+static void runIRPass(Pass *p, TreeNode *syntaxTree, IrFunc *ir)
+{
+    long insts;
+    double start;
+    if (!enabled(p))
+        return;
+    ensureInfo(syntaxTree, p->needs);
+    insts = irSize(ir);
+    start = now();
+    p->changes += p->irPass(ir);
+    p->ms += msSince(start);
+    p->runs++;
+    p->irDelta += irSize(ir) - insts;
+    validInfo &= p->keeps;
+}
+
+/* Procedure printStats lists, for every pass that
+ * ran, its time, the nodes or IR instructions it
+ * added and the changes it made, and the time of
+ * the analyses
+ */
+static void printStats(void)
+{
+    Pass *p;
+    int k;
+    fprintf(listing, "\nPass statistics:\n\n");
+    fprintf(listing, "%-28s %4s %9s %10s %9s %7s\n",
+            "Pass", "Runs", "Time (ms)", "Tree nodes", "IR insts", "Changes");
+    for (k = 0; k < N_PASSES; k++)
+    {
+        p = &passes[k];
+        if (p->runs == 0)
+            continue;
+        fprintf(listing, "%-28s %4d %9.2f ", p->title, p->runs, p->ms);
+        if (p->treePass != NULL)
+            fprintf(listing, "%+10ld %9s ", p->treeDelta, "-");
+        else
+            fprintf(listing, "%10s %+9ld ", "-", p->irDelta);
+        fprintf(listing, "%7d\n", p->changes);
+    }
+    for (k = 0; k < N_ANALYSES; k++)
+        if (analyses[k].runs > 0)
+            fprintf(listing, "%-28s %4d %9.2f %10s %9s %7s\n", analyses[k].title,
+                    analyses[k].runs, analyses[k].ms, "-", "-", "-");
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     TreeNode *syntaxTree;
+#if !NO_PARSE && !NO_ANALYZE && !NO_CODE
+    IrFunc *ir = NULL;
+#endif
     char pgm[120]; /* source code file name */
-    if (argc != 2)
+    char base[120]; /* pgm without its extension */
+    char mapfile[130], proffile[130];
+    int argi, k, limitSet = FALSE;
+    for (argi = 1; argi < argc && argv[argi][0] == '-'; argi++)
+    {
+        if (strcmp(argv[argi], "-b") == 0)
+            CheckBounds = TRUE;
+        else if (strcmp(argv[argi], "-i") == 0)
+            GenIR = TRUE;
+        else if (strcmp(argv[argi], "-d") == 0)
+            GenIR = TraceIR = TRUE;
+        else if (strcmp(argv[argi], "-O") == 0)
+            OptLevel = MAX_LEVEL;
+        else if (strncmp(argv[argi], "-O", 2) == 0 && argv[argi][2] >= '0' &&
+                 argv[argi][2] <= '0' + MAX_LEVEL && argv[argi][3] == '\0')
+            OptLevel = argv[argi][2] - '0';
+        else if (strcmp(argv[argi], "-Os") == 0)
+        {
+            OptLevel = MAX_LEVEL;
+            OptimizeSize = TRUE;
+        }
+        else if (strcmp(argv[argi], "-c") == 0)
+            CycleCost = TRUE;
+        else if (strcmp(argv[argi], "-p") == 0)
+            WriteMap = TRUE;
+        else if (strcmp(argv[argi], "-P") == 0)
+            UseProfile = TRUE;
+        else if (strcmp(argv[argi], "-s") == 0)
+            PassStats = TRUE;
+#if !NO_PARSE && !NO_ANALYZE
+        else if (strncmp(argv[argi], "-fno-", 5) == 0 && switchPass(argv[argi] + 5, FALSE))
+            ;
+        else if (strncmp(argv[argi], "-f", 2) == 0 && switchPass(argv[argi] + 2, TRUE))
+            ;
+#endif
+        else if (strncmp(argv[argi], "-I", 2) == 0 && isdigit(argv[argi][2]))
+        {
+            InlineLimit = atoi(argv[argi] + 2);
+            limitSet = TRUE;
+        }
+        else if (strncmp(argv[argi], "-U", 2) == 0 && isdigit(argv[argi][2]))
+            UnrollFactor = atoi(argv[argi] + 2);
+        else if (strncmp(argv[argi], "-M", 2) == 0 && isdigit(argv[argi][2]))
+            MemoSize = atoi(argv[argi] + 2);
+        else
+            break;
+    }
+    if (argi != argc - 1)
     {
-        fprintf(stderr, "usage: %s <filename>\n", argv[0]);
+        fprintf(stderr, "usage: %s [-b] [-i] [-d] [-O[0|1|2|s]] [-c] [-p] [-P] [-s] "
+                        "[-f[no-]<pass>] [-I<n>] [-U<n>] [-M<n>] <filename>\n",
+                argv[0]);
         exit(1);
     }
-    strcpy(pgm, argv[1]);
+    Optimize = OptLevel > 0;
+    /* -Os inlines only calls that do not grow the code */
+    if (OptimizeSize && !limitSet)
+        InlineLimit = 0;
+#if !NO_PARSE && !NO_ANALYZE
+    if (MemoSize > 0)
+        switchPass("memo", TRUE);
+    /* the IR passes rewrite only the code -i generates */
+    if (!GenIR)
+        for (k = 0; k < N_PASSES; k++)
+            if (passes[k].irPass != NULL && passes[k].forced)
+                fprintf(stderr, "-f%s has no effect without -i\n", passes[k].name);
+#endif
+    /* only the tree code generator maps its code to the source */
+    if (GenIR && WriteMap)
+    {
+        fprintf(stderr, "-p has no effect with -i\n");
+        WriteMap = FALSE;
+    }
+    strcpy(pgm, argv[argi]);
     if (strchr(pgm, '.') == NULL)
         strcat(pgm, ".tny");
+    strncpy(base, pgm, strcspn(pgm, "."));
+    base[strcspn(pgm, ".")] = '\0';
+    sprintf(mapfile, "%s.map", base);
+    sprintf(proffile, "%s.prof", base);
     source = fopen(pgm, "r");
     if (source == NULL)
     {
@@ -70,6 +471,7 @@ int main(int argc, char *argv[])
         ;
 #else
     syntaxTree = parse();
+    numberTree(syntaxTree);
     if (TraceParse)
     {
         fprintf(listing, "\nSyntax tree:\n");
@@ -87,7 +489,34 @@ int main(int argc, char *argv[])
         if (TraceAnalyze)
             fprintf(listing, "\nType Checking Finished\n");
     }
+    if (!Error)
+        ensureInfo(syntaxTree, ALIAS_INFO);
+    if (!Error)
+        checkAssignment(syntaxTree);
+    /* before the passes that consult it */
+    if (!Error && UseProfile && !readProfile(mapfile, proffile))
+        fprintf(stderr, "Profile %s or %s not found, optimizing without it\n",
+                mapfile, proffile);
+    for (k = 0; k < N_PASSES && !Error; k++)
+        if (passes[k].treePass != NULL)
+            runPass(&passes[k], syntaxTree);
+    if (!Error)
+        ensureInfo(syntaxTree, CheckBounds ? ALL_INFO : ALIAS_INFO);
 #if !NO_CODE
+    if (!Error && GenIR)
+    {
+        ir = irGen(syntaxTree);
+        for (k = 0; k < N_PASSES; k++)
+            if (passes[k].irPass != NULL)
+                runIRPass(&passes[k], syntaxTree, ir);
+        if (TraceIR)
+        {
+            fprintf(listing, "\nIntermediate code:\n");
+            irPrint(listing, ir);
+        }
+        if (irVerify(ir) > 0)
+            Error = TRUE;
+    }
     if (!Error)
     {
         char *codefile;
@@ -101,10 +530,27 @@ int main(int argc, char *argv[])
             printf("Unable to open %s\n", codefile);
             exit(1);
         }
-        codeGen(syntaxTree, codefile);
+        if (WriteMap)
+        {
+            map = fopen(mapfile, "w");
+            if (map == NULL)
+            {
+                printf("Unable to open %s\n", mapfile);
+                exit(1);
+            }
+        }
+        if (GenIR)
+            irCodeGen(ir, codefile);
+        else
+            codeGen(syntaxTree, codefile);
         fclose(code);
+        if (map != NULL)
+            fclose(map);
     }
+    irFree(ir);
 #endif
+    if (PassStats)
+        printStats();
 #endif
 #endif
     fclose(source);
@@ -0,0 +1,346 @@
+/****************************************************/
+/* File: memo.c                                     */
+/* Memoization of pure recursive functions          */
+/* for the TINY compiler                            */
+/* A function is pure if neither it nor anything it */
+/* calls touches a global, reads input or writes    */
+/* output. One with one or two integer parameters   */
+/* that calls itself twice, or in a loop, solves    */
+/* the same subproblems again and again; it gets    */
+/* two global arrays, f_memo for the results and    */
+/* f_known for the flags saying which are set, and  */
+/* a local key: the parameter, or the parameters as */
+/* row and column of a square table, or -1 if they  */
+/* fall outside it                                  */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "code.h"
+#include "memo.h"
+
+/* the tables take at most MEMO_WORDS words of
+ * global memory, leaving the rest to the frames
+ */
+#define MEMO_WORDS (DADDR_SIZE / 2)
+
+static int nMemoized; /* functions given a table */
+static int nWords;    /* words of the tables */
+
+/* the functions of the program */
+static int nFuncs;
+static TreeNode **funcs;
+static int *pure;
+
+static int funcIndex(TreeNode *fn)
+{
+    int i;
+    for (i = 0; i < nFuncs; i++)
+        if (funcs[i] == fn)
+            return i;
+    return -1;
+}
+
+/* Function touchesState returns TRUE if the code t
+ * accesses a global, does input or output, or
+ * calls a function not known to be pure
+ */
+static int touchesState(TreeNode *t)
+{
+    TreeNode *d;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->bucket != NULL)
+        {
+            d = t->bucket->treeNode;
+            if (t->kind.exp == CallK && (funcIndex(d) < 0 || !pure[funcIndex(d)]))
+                return TRUE;
+            if ((t->kind.exp == IdK || t->kind.exp == ArrayIdK) && d->scope == globalScope)
+                return TRUE;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (touchesState(t->child[i]))
+                return TRUE;
+    }
+    return FALSE;
+}
+
+/* Procedure findPure marks the pure functions,
+ * assuming every function is until shown otherwise
+ * so that recursive ones can be
+ */
+static void findPure(void)
+{
+    int i, changed;
+    for (i = 0; i < nFuncs; i++)
+        pure[i] = TRUE;
+    do
+    {
+        changed = FALSE;
+        for (i = 0; i < nFuncs; i++)
+            if (pure[i] && touchesState(funcs[i]->child[2]))
+            {
+                pure[i] = FALSE;
+                changed = TRUE;
+            }
+    } while (changed);
+}
+
+/* Function selfCalls counts the calls of fn in the
+ * code t, a call in a loop counting twice
+ */
+static int selfCalls(TreeNode *t, TreeNode *fn, int inLoop)
+{
+    int n = 0, i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == CallK && t->bucket != NULL &&
+            t->bucket->treeNode == fn)
+            n += inLoop ? 2 : 1;
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += selfCalls(t->child[i], fn,
+                           inLoop || (t->nodekind == StmtK && t->kind.stmt == WhileK));
+    }
+    return n;
+}
+
+/* Function intParams returns the number of
+ * parameters of fn, or 0 if one is an array
+ */
+static int intParams(TreeNode *fn)
+{
+    TreeNode *p;
+    int n = 0;
+    for (p = fn->child[1]; p != NULL && p->nodekind == ExpK; p = p->sibling)
+    {
+        if (p->kind.exp != SingleParamK)
+            return 0;
+        n++;
+    }
+    return n;
+}
+
+/**************************************************/
+/*************   building the code   **************/
+/**************************************************/
+
+static int line; /* line number of the new nodes */
+
+static TreeNode *newId(TreeNode *d)
+{
+    TreeNode *t = newExpNode(IdK);
+    t->attr.name = d->attr.name;
+    t->bucket = d->bucket;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+static TreeNode *newElem(TreeNode *arr, TreeNode *index)
+{
+    TreeNode *t = newExpNode(ArrayIdK);
+    t->attr.name = arr->attr.name;
+    t->bucket = arr->bucket;
+    t->child[0] = index;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+static TreeNode *newAssign(TreeNode *target, TreeNode *e)
+{
+    TreeNode *t = newExpNode(AssignK);
+    t->child[0] = target;
+    t->child[1] = e;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+static TreeNode *newIf(TreeNode *test, TreeNode *then)
+{
+    TreeNode *t = newStmtNode(IfK);
+    t->child[0] = test;
+    t->child[1] = then;
+    t->lineno = line;
+    return t;
+}
+
+/* Function newVar declares in scope sc the scalar
+ * or, if length is not 0, the array named name
+ */
+static TreeNode *newVar(ScopeList sc, char *name, int length)
+{
+    TreeNode *d = newExpNode(length ? VarArrayK : VarK);
+    d->attr.name = name;
+    if (length)
+    {
+        d->attr.arr.length = length;
+        d->type = IntegerArray;
+    }
+    else
+        d->type = Integer;
+    d->lineno = line;
+    st_declare(sc, d);
+    return d;
+}
+
+static char *tableName(TreeNode *fn, char *suffix)
+{
+    char *name = malloc(strlen(fn->attr.name) + strlen(suffix) + 1);
+    sprintf(name, "%s%s", fn->attr.name, suffix);
+    return name;
+}
+
+/* the table of the function being rewritten */
+static TreeNode *memo, *known, *key, *res;
+
+/* Procedure storeReturns makes every return of the
+ * statements t record its value in the table
+ */
+static void storeReturns(TreeNode *t)
+{
+    TreeNode *stmts;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind != StmtK)
+            continue;
+        switch (t->kind.stmt)
+        {
+        case CompoundK:
+            storeReturns(t->child[1]);
+            break;
+        case IfK:
+            storeReturns(t->child[1]);
+            storeReturns(t->child[2]);
+            break;
+        case WhileK:
+            storeReturns(t->child[1]);
+            break;
+        case ReturnK:
+            if (t->child[0] == NULL)
+                break;
+            line = t->lineno;
+            /* res = e; if (key >= 0) { memo[key] = res; known[key] = 1; } return res; */
+            stmts = newAssign(newId(res), t->child[0]);
+            stmts->sibling = newIf(newOp(GE, newId(key), newConst(0, line)),
+                                   newStmtNode(CompoundK));
+            stmts->sibling->child[1]->child[1] =
+                newAssign(newElem(memo, newId(key)), newId(res));
+            stmts->sibling->child[1]->child[1]->sibling =
+                newAssign(newElem(known, newId(key)), newConst(1, line));
+            stmts->sibling->sibling = newStmtNode(ReturnK);
+            stmts->sibling->sibling->child[0] = newId(res);
+            stmts->sibling->sibling->lineno = line;
+            t->kind.stmt = CompoundK;
+            t->child[0] = NULL;
+            t->child[1] = stmts;
+            t->scope = NULL;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Procedure memoize gives fn a table of size
+ * entries, found from its params parameters
+ */
+static void memoize(TreeNode *fn, int params, int size)
+{
+    TreeNode *body = fn->child[2], *p = fn->child[1], *q = p->sibling;
+    TreeNode *block = newStmtNode(CompoundK), *entry, *test;
+    ScopeList sc = sc_create(body->scope->name);
+    int side = 1;
+    line = fn->lineno;
+    if (params == 2)
+        while ((side + 1) * (side + 1) <= size)
+            side++;
+    memo = newVar(globalScope, tableName(fn, "_memo"), params == 2 ? side * side : size);
+    known = newVar(globalScope, tableName(fn, "_known"), memo->attr.arr.length);
+    /* the tables follow fn, which may head the program */
+    known->sibling = fn->sibling;
+    memo->sibling = known;
+    fn->sibling = memo;
+    /* the locals go below those of the body */
+    sc->loc = body->scope->loc;
+    key = newVar(sc, "key", 0);
+    res = newVar(sc, "res", 0);
+    key->sibling = res;
+    sc_shift(body->child[1], sc->loc - body->scope->loc);
+    storeReturns(body->child[1]);
+    /* key = -1; if (p >= 0) if (p < size) key = p; */
+    entry = newAssign(newId(key), newConst(-1, line));
+    if (params == 1)
+        test = newIf(newOp(LT, newId(p), newConst(size, line)), newAssign(newId(key), newId(p)));
+    else
+        test = newIf(newOp(LT, newId(p), newConst(side, line)),
+                     newIf(newOp(GE, newId(q), newConst(0, line)),
+                           newIf(newOp(LT, newId(q), newConst(side, line)),
+                                 newAssign(newId(key),
+                                           newOp(PLUS, newOp(TIMES, newId(p), newConst(side, line)),
+                                                 newId(q))))));
+    entry->sibling = newIf(newOp(GE, newId(p), newConst(0, line)), test);
+    /* if (key >= 0) if (known[key]) return memo[key]; */
+    entry->sibling->sibling = newIf(newOp(GE, newId(key), newConst(0, line)),
+                                    newIf(newElem(known, newId(key)), newStmtNode(ReturnK)));
+    entry->sibling->sibling->child[1]->child[1]->child[0] = newElem(memo, newId(key));
+    entry->sibling->sibling->child[1]->child[1]->lineno = line;
+    entry->sibling->sibling->sibling = body->child[1];
+    block->child[0] = key;
+    block->child[1] = entry;
+    block->scope = sc;
+    block->lineno = line;
+    body->child[1] = block;
+    nMemoized++;
+    nWords += 2 * memo->attr.arr.length;
+}
+
+/* Function memoizeFunctions gives every pure
+ * function of one or two integer parameters that
+ * calls itself more than once a table of MemoSize
+ * results in global memory, consulted on entry and
+ * filled at every return, and returns the number
+ * of functions memoized
+ */
+int memoizeFunctions(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    int i, n, size;
+    nMemoized = nWords = nFuncs = 0;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+        if (isFunction(t))
+            nFuncs++;
+    funcs = malloc(nFuncs * sizeof(TreeNode *));
+    pure = malloc(nFuncs * sizeof(int));
+    nFuncs = 0;
+    for (t = syntaxTree; t != NULL; t = t->sibling)
+        if (isFunction(t))
+            funcs[nFuncs++] = t;
+    findPure();
+    /* keep the candidates in pure */
+    for (i = n = 0; i < nFuncs; i++)
+    {
+        t = funcs[i];
+        pure[i] = pure[i] && strcmp(t->attr.name, "main") != 0 &&
+                  t->child[0]->type == Integer && intParams(t) > 0 &&
+                  intParams(t) <= 2 && selfCalls(t->child[2], t, FALSE) >= 2;
+        n += pure[i];
+    }
+    /* the results and the flags of all must fit */
+    size = MemoSize;
+    if (n > 0 && 2 * n * size > MEMO_WORDS - globalScope->loc)
+        size = (MEMO_WORDS - globalScope->loc) / (2 * n);
+    for (i = 0; i < nFuncs; i++)
+        if (pure[i] && size >= 2 * intParams(funcs[i]))
+            memoize(funcs[i], intParams(funcs[i]), size);
+    free(funcs);
+    free(pure);
+    if (TraceAnalyze)
+        fprintf(listing, "\nMemoization: %d functions memoized in %d words\n",
+                nMemoized, nWords);
+    return nMemoized;
+}
@@ -0,0 +1,19 @@
+/****************************************************/
+/* File: memo.h                                     */
+/* Memoization of pure recursive functions          */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _MEMO_H_
+#define _MEMO_H_
+
+/* Function memoizeFunctions gives every pure
+ * function of one or two integer parameters that
+ * calls itself more than once a table of MemoSize
+ * results in global memory, consulted on entry and
+ * filled at every return, and returns the number
+ * of functions memoized
+ */
+int memoizeFunctions(TreeNode *syntaxTree);
+
+#endif
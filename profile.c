@@ -0,0 +1,115 @@
+/****************************************************/
+/* File: profile.c                                  */
+/* Execution profiles of the TM simulator           */
+/* for the TINY compiler                            */
+/* Compiled with -p, the code generator writes a    */
+/* profile map next to the code: a line             */
+/*     location node role                           */
+/* for each instruction whose counts tell what a    */
+/* node did. The simulator's f command writes a     */
+/* line                                             */
+/*     location runs taken                          */
+/* for each instruction run, taken counting jumps.  */
+/* With -P both are read back and summed per node.  */
+/* Only the tree code generator writes the map, so  */
+/* -p is ignored with -i, but a profile of a tree   */
+/* build guides the tree passes of a -i build as    */
+/* well                                             */
+/****************************************************/
+
+#include "globals.h"
+#include "code.h"
+#include "profile.h"
+
+static int nNodes; /* nodes numbered */
+static NodeProfile *profiles; /* indexed by node number */
+static int *mapped;           /* the map names the node */
+
+/* the node and role of each code location */
+static int mapNode[IADDR_SIZE];
+static int mapRole[IADDR_SIZE];
+
+static void numberNodes(TreeNode *t)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        t->id = ++nNodes;
+        for (i = 0; i < MAXCHILDREN; i++)
+            numberNodes(t->child[i]);
+    }
+}
+
+void numberTree(TreeNode *syntaxTree)
+{
+    nNodes = 0;
+    numberNodes(syntaxTree);
+}
+
+int readProfile(char *mapName, char *profileName)
+{
+    FILE *f;
+    int loc, id;
+    long runs, taken;
+    char role;
+    NodeProfile *p;
+    f = fopen(mapName, "r");
+    if (f == NULL)
+        return FALSE;
+    profiles = calloc(nNodes + 1, sizeof(NodeProfile));
+    mapped = calloc(nNodes + 1, sizeof(int));
+    while (fscanf(f, "%d %d %c", &loc, &id, &role) == 3)
+        if (loc >= 0 && loc < IADDR_SIZE && id > 0 && id <= nNodes)
+        {
+            mapNode[loc] = id;
+            mapRole[loc] = role;
+            mapped[id] = TRUE;
+        }
+    fclose(f);
+    f = fopen(profileName, "r");
+    if (f == NULL)
+    {
+        free(profiles);
+        free(mapped);
+        profiles = NULL;
+        return FALSE;
+    }
+    while (fscanf(f, "%d %ld %ld", &loc, &runs, &taken) == 3)
+    {
+        if (loc < 0 || loc >= IADDR_SIZE || mapNode[loc] == 0)
+            continue;
+        p = &profiles[mapNode[loc]];
+        switch (mapRole[loc])
+        {
+        case PROFILE_ENTRY:
+            p->entries += runs;
+            break;
+        case PROFILE_TRIP:
+            p->trips += runs;
+            break;
+        case PROFILE_TEST:
+            p->entries += taken;
+            p->trips += runs - taken;
+            break;
+        case PROFILE_ELSE:
+            p->entries += runs;
+            p->trips += runs - taken;
+            p->elses += taken;
+            break;
+        case PROFILE_THEN:
+            p->entries += runs;
+            p->trips += taken;
+            p->elses += runs - taken;
+            break;
+        }
+    }
+    fclose(f);
+    return TRUE;
+}
+
+NodeProfile *nodeProfile(TreeNode *t)
+{
+    if (profiles == NULL || t->id <= 0 || t->id > nNodes || !mapped[t->id])
+        return NULL;
+    return &profiles[t->id];
+}
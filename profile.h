@@ -0,0 +1,46 @@
+/****************************************************/
+/* File: profile.h                                  */
+/* Execution profiles of the TM simulator           */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/* the roles of the instructions the profile map
+ * names, each counting runs of its node
+ */
+#define PROFILE_ENTRY 'e' /* runs once per entry of the node */
+#define PROFILE_TRIP 'l'  /* runs once per trip of a loop */
+#define PROFILE_TEST 'w'  /* tests a loop at its top, taken to leave */
+#define PROFILE_ELSE 'f'  /* taken when the test of an if fails */
+#define PROFILE_THEN 't'  /* taken when the test of an if holds */
+
+/* what the training runs did at a node */
+typedef struct
+{
+    long entries; /* runs of the node, or calls of a call */
+    long trips;   /* trips of a loop, or runs of a then part */
+    long elses;   /* runs of an else part */
+} NodeProfile;
+
+/* Procedure numberTree numbers the nodes of the
+ * parsed tree, so a profile taken with one set of
+ * options finds them in a compilation with another
+ */
+void numberTree(TreeNode *syntaxTree);
+
+/* Function readProfile reads the profile map the
+ * compiler wrote for the training code and the
+ * counts the simulator wrote while running it,
+ * and returns FALSE if either cannot be read
+ */
+int readProfile(char *mapName, char *profileName);
+
+/* Function nodeProfile returns what the training
+ * runs did at node t, or NULL if the map does
+ * not name it
+ */
+NodeProfile *nodeProfile(TreeNode *t);
+
+#endif
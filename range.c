@@ -0,0 +1,1079 @@
+/****************************************************/
+/* File: range.c                                    */
+/* Value-range analysis implementation              */
+/* for the TINY compiler                            */
+/* Every scalar is approximated by an interval of   */
+/* ints. Loops are iterated to a fixed point with   */
+/* widening, conditions narrow the intervals of     */
+/* the variables they compare, and parameters and   */
+/* return values are summarized across all calls    */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "range.h"
+
+/* RANGE_SIZE is the size of the node hash tables */
+#define RANGE_SIZE 211
+
+/* WIDEN_AFTER is the number of rounds a loop head
+ * or a summary may grow before its bounds are
+ * pushed to the limits of int
+ */
+#define WIDEN_AFTER 2
+
+/* NARROW_STEPS is the number of extra rounds run on
+ * a loop after widening to win back precision
+ */
+#define NARROW_STEPS 2
+
+/* verdicts recorded for checked nodes */
+#define SAFE 1
+#define UNSAFE 2
+
+/* an interval of ints, empty when lo > hi */
+typedef struct
+{
+    int lo;
+    int hi;
+} Interval;
+
+/* the abstract state at a program point;
+ * v is indexed by variable number
+ */
+typedef struct
+{
+    int live; /* FALSE when the point is unreachable */
+    Interval *v;
+} Env;
+
+/* maps a tree node to a number */
+typedef struct NodeRec
+{
+    TreeNode *node;
+    int index;
+    struct NodeRec *next;
+} * NodeList;
+
+static NodeList varHash[RANGE_SIZE];   /* scalar declarations */
+static NodeList fnHash[RANGE_SIZE];    /* function declarations */
+static NodeList checkHash[RANGE_SIZE]; /* verdicts of ArrayIdK nodes */
+
+static int nVars = 0, maxVars = 0;
+static int *isGlobalVar = NULL;
+static Interval *paramIn = NULL; /* summary of every parameter */
+
+static int nFns = 0, maxFns = 0;
+static TreeNode **fnDecl = NULL;
+static Interval *retRange = NULL; /* summary of every return value */
+static int *called = NULL;
+
+static int nArrays = 0, maxArrays = 0;
+static TreeNode **arrayDecl = NULL;
+
+/* sorted constants of the program; widening stops
+ * at the next one before giving up on a bound
+ */
+static int nThresholds = 0, maxThresholds = 0;
+static int *thresholds = NULL;
+
+static int curFn;        /* function being interpreted */
+static int pass;         /* interprocedural iteration */
+static int changed;      /* a summary grew in this round */
+static int recording;    /* verdicts are recorded on the final pass */
+
+/* the loop guardLoop examines */
+static TreeNode *guardVar; /* declaration of its counter */
+static int lastTrip;       /* 1 if the last trip runs with the bound, 0 with bound - 1 */
+static int guardStep;      /* steps of the counter before the statement guarded */
+
+static const Interval empty = {1, 0};
+static const Interval top = {INT_MIN, INT_MAX};
+
+/**************************************************/
+/*************   node tables    *******************/
+/**************************************************/
+
+static int hashNode(TreeNode *t)
+{
+    return (int)(((unsigned long)t >> 4) % RANGE_SIZE);
+}
+
+static int nodeIndex(NodeList *tab, TreeNode *t)
+{
+    NodeList l = tab[hashNode(t)];
+    while (l != NULL && l->node != t)
+        l = l->next;
+    return l == NULL ? -1 : l->index;
+}
+
+static void nodeSet(NodeList *tab, TreeNode *t, int index)
+{
+    int h = hashNode(t);
+    NodeList l = tab[h];
+    while (l != NULL && l->node != t)
+        l = l->next;
+    if (l == NULL)
+    {
+        l = (NodeList)malloc(sizeof(struct NodeRec));
+        l->node = t;
+        l->next = tab[h];
+        tab[h] = l;
+    }
+    l->index = index;
+}
+
+static void nodeClear(NodeList *tab)
+{
+    int i;
+    for (i = 0; i < RANGE_SIZE; i++)
+    {
+        while (tab[i] != NULL)
+        {
+            NodeList l = tab[i];
+            tab[i] = l->next;
+            free(l);
+        }
+    }
+}
+
+/**************************************************/
+/*************   interval arithmetic   ************/
+/**************************************************/
+
+static int isEmpty(Interval a)
+{
+    return a.lo > a.hi;
+}
+
+/* Function mk builds the interval [lo,hi]; a result
+ * that leaves the range of int may wrap around on
+ * the TM and so is approximated by the full range
+ */
+static Interval mk(long long lo, long long hi)
+{
+    Interval r;
+    if (lo > hi)
+        return empty;
+    if (lo < INT_MIN || hi > INT_MAX)
+        return top;
+    r.lo = (int)lo;
+    r.hi = (int)hi;
+    return r;
+}
+
+static Interval join(Interval a, Interval b)
+{
+    if (isEmpty(a))
+        return b;
+    if (isEmpty(b))
+        return a;
+    return mk(a.lo < b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi);
+}
+
+static Interval meet(Interval a, Interval b)
+{
+    if (isEmpty(a) || isEmpty(b))
+        return empty;
+    return mk(a.lo > b.lo ? a.lo : b.lo, a.hi < b.hi ? a.hi : b.hi);
+}
+
+/* Function widen lets a growing bound jump to the
+ * next threshold, so loops over constant ranges keep
+ * finite bounds while every chain stays short
+ */
+static Interval widen(Interval old, Interval new)
+{
+    Interval r;
+    int i;
+    if (isEmpty(old))
+        return new;
+    if (isEmpty(new))
+        return old;
+    r = old;
+    if (new.lo < old.lo)
+    {
+        r.lo = INT_MIN;
+        for (i = nThresholds - 1; i >= 0; i--)
+            if (thresholds[i] <= new.lo)
+            {
+                r.lo = thresholds[i];
+                break;
+            }
+    }
+    if (new.hi > old.hi)
+    {
+        r.hi = INT_MAX;
+        for (i = 0; i < nThresholds; i++)
+            if (thresholds[i] >= new.hi)
+            {
+                r.hi = thresholds[i];
+                break;
+            }
+    }
+    return r;
+}
+
+static int contains(Interval a, int x)
+{
+    return a.lo <= x && x <= a.hi;
+}
+
+static int same(Interval a, Interval b)
+{
+    if (isEmpty(a) || isEmpty(b))
+        return isEmpty(a) && isEmpty(b);
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+/* Function within returns TRUE if a lies inside b */
+static int within(Interval a, Interval b)
+{
+    return isEmpty(a) || (!isEmpty(b) && b.lo <= a.lo && a.hi <= b.hi);
+}
+
+static Interval addRange(Interval a, Interval b)
+{
+    if (isEmpty(a) || isEmpty(b))
+        return empty;
+    return mk((long long)a.lo + b.lo, (long long)a.hi + b.hi);
+}
+
+static Interval subRange(Interval a, Interval b)
+{
+    if (isEmpty(a) || isEmpty(b))
+        return empty;
+    return mk((long long)a.lo - b.hi, (long long)a.hi - b.lo);
+}
+
+static Interval corners(long long c0, long long c1, long long c2, long long c3)
+{
+    long long lo = c0, hi = c0;
+    if (c1 < lo) lo = c1;
+    if (c1 > hi) hi = c1;
+    if (c2 < lo) lo = c2;
+    if (c2 > hi) hi = c2;
+    if (c3 < lo) lo = c3;
+    if (c3 > hi) hi = c3;
+    return mk(lo, hi);
+}
+
+static Interval mulRange(Interval a, Interval b)
+{
+    if (isEmpty(a) || isEmpty(b))
+        return empty;
+    return corners((long long)a.lo * b.lo, (long long)a.lo * b.hi,
+                   (long long)a.hi * b.lo, (long long)a.hi * b.hi);
+}
+
+/* quotient for a divisor range of one sign; the
+ * truncating division is monotone in both operands
+ * there, so the extremes are found at the corners
+ */
+static Interval divPart(Interval a, Interval b)
+{
+    return corners((long long)a.lo / b.lo, (long long)a.lo / b.hi,
+                   (long long)a.hi / b.lo, (long long)a.hi / b.hi);
+}
+
+static Interval divRange(Interval a, Interval b)
+{
+    Interval r = empty;
+    Interval neg = meet(b, mk(INT_MIN, -1));
+    Interval pos = meet(b, mk(1, INT_MAX));
+    if (isEmpty(a))
+        return empty;
+    if (!isEmpty(neg))
+        r = join(r, divPart(a, neg));
+    if (!isEmpty(pos))
+        r = join(r, divPart(a, pos));
+    return r;
+}
+
+/* Function relRange gives [1,1] for a comparison that
+ * always holds, [0,0] for one that never holds and
+ * [0,1] otherwise
+ */
+static Interval relRange(TokenType op, Interval a, Interval b)
+{
+    int yes = FALSE, no = FALSE;
+    if (isEmpty(a) || isEmpty(b))
+        return empty;
+    switch (op)
+    {
+    case LT:
+        yes = a.hi < b.lo;
+        no = a.lo >= b.hi;
+        break;
+    case LE:
+        yes = a.hi <= b.lo;
+        no = a.lo > b.hi;
+        break;
+    case GT:
+        yes = a.lo > b.hi;
+        no = a.hi <= b.lo;
+        break;
+    case GE:
+        yes = a.lo >= b.hi;
+        no = a.hi < b.lo;
+        break;
+    case EQ:
+    case NE:
+        yes = a.lo == a.hi && b.lo == b.hi && a.lo == b.lo;
+        no = a.hi < b.lo || b.hi < a.lo;
+        if (op == NE)
+        {
+            int t = yes;
+            yes = no;
+            no = t;
+        }
+        break;
+    default:
+        break;
+    }
+    if (yes)
+        return mk(1, 1);
+    if (no)
+        return mk(0, 0);
+    return mk(0, 1);
+}
+
+static int isRelop(TokenType op)
+{
+    return op == LT || op == LE || op == GT || op == GE || op == EQ || op == NE;
+}
+
+/* the relation that holds when op fails */
+static TokenType negateOp(TokenType op)
+{
+    switch (op)
+    {
+    case LT: return GE;
+    case LE: return GT;
+    case GT: return LE;
+    case GE: return LT;
+    case EQ: return NE;
+    default: return EQ;
+    }
+}
+
+/* the relation seen from the right operand */
+static TokenType swapOp(TokenType op)
+{
+    switch (op)
+    {
+    case LT: return GT;
+    case LE: return GE;
+    case GT: return LT;
+    case GE: return LE;
+    default: return op;
+    }
+}
+
+/**************************************************/
+/*************   abstract states   ****************/
+/**************************************************/
+
+static Env envNew(void)
+{
+    Env e;
+    int i;
+    e.live = TRUE;
+    e.v = (Interval *)malloc((nVars > 0 ? nVars : 1) * sizeof(Interval));
+    for (i = 0; i < nVars; i++)
+        e.v[i] = top;
+    return e;
+}
+
+static Env envCopy(Env *src)
+{
+    Env e = envNew();
+    e.live = src->live;
+    memcpy(e.v, src->v, nVars * sizeof(Interval));
+    return e;
+}
+
+static void envFree(Env *e)
+{
+    free(e->v);
+    e->v = NULL;
+}
+
+/* Procedure envJoin merges src into dst */
+static void envJoin(Env *dst, Env *src)
+{
+    int i;
+    if (!src->live)
+        return;
+    if (!dst->live)
+    {
+        dst->live = TRUE;
+        memcpy(dst->v, src->v, nVars * sizeof(Interval));
+        return;
+    }
+    for (i = 0; i < nVars; i++)
+        dst->v[i] = join(dst->v[i], src->v[i]);
+}
+
+/* Procedure envWiden replaces dst by old widened with dst */
+static void envWiden(Env *dst, Env *old)
+{
+    int i;
+    if (!old->live || !dst->live)
+        return;
+    for (i = 0; i < nVars; i++)
+        dst->v[i] = widen(old->v[i], dst->v[i]);
+}
+
+static int envWithin(Env *a, Env *b)
+{
+    int i;
+    if (!a->live)
+        return TRUE;
+    if (!b->live)
+        return FALSE;
+    for (i = 0; i < nVars; i++)
+        if (!within(a->v[i], b->v[i]))
+            return FALSE;
+    return TRUE;
+}
+
+/* Procedure killGlobals forgets every global
+ * scalar, as a callee may have assigned it
+ */
+static void killGlobals(Env *e)
+{
+    int i;
+    for (i = 0; i < nVars; i++)
+        if (isGlobalVar[i])
+            e->v[i] = top;
+}
+
+/**************************************************/
+/*************   interpretation   *****************/
+/**************************************************/
+
+/* variable number of a scalar reference, or -1 */
+static int varOf(TreeNode *t)
+{
+    TreeNode *d = declOf(t);
+    if (d == NULL)
+        return -1;
+    return nodeIndex(varHash, d);
+}
+
+static void record(TreeNode *t, int safe, Env *env)
+{
+    if (!recording || !env->live)
+        return;
+    if (!safe || nodeIndex(checkHash, t) != UNSAFE)
+        nodeSet(checkHash, t, safe ? SAFE : UNSAFE);
+}
+
+/* Function arrayLength returns the number of
+ * elements every array bound to decl has at least
+ */
+static int arrayLength(TreeNode *decl)
+{
+    int i, len = -1;
+    if (decl == NULL)
+        return 0;
+    if (decl->kind.exp == VarArrayK)
+        return decl->attr.arr.length;
+    for (i = 0; i < nArrays; i++)
+        if (mayReach(decl, arrayDecl[i]))
+            if (len < 0 || arrayDecl[i]->attr.arr.length < len)
+                len = arrayDecl[i]->attr.arr.length;
+    return len < 0 ? 0 : len;
+}
+
+static void updateSummary(Interval *s, Interval a)
+{
+    Interval n = join(*s, a);
+    if (pass > WIDEN_AFTER)
+        n = widen(*s, n);
+    if (!same(n, *s))
+    {
+        *s = n;
+        changed = TRUE;
+    }
+}
+
+static Interval eval(TreeNode *t, Env *env);
+
+static Interval evalCall(TreeNode *t, Env *env)
+{
+    TreeNode *fn = declOf(t);
+    TreeNode *formal = fn != NULL ? fn->child[1] : NULL;
+    TreeNode *arg;
+    int f = fn != NULL ? nodeIndex(fnHash, fn) : -1;
+    for (arg = t->child[0]; arg != NULL; arg = arg->sibling)
+    {
+        Interval a = eval(arg, env);
+        if (f >= 0 && formal != NULL && formal->nodekind == ExpK &&
+            formal->kind.exp == SingleParamK)
+            updateSummary(&paramIn[nodeIndex(varHash, formal)], a);
+        if (formal != NULL)
+            formal = formal->sibling;
+    }
+    if (f < 0) /* input() may read any value */
+        return top;
+    killGlobals(env);
+    return retRange[f];
+}
+
+/* Function eval returns the interval of expression t
+ * and applies its assignments to env
+ */
+static Interval eval(TreeNode *t, Env *env)
+{
+    Interval a, b;
+    int v;
+    if (t == NULL || !env->live)
+        return empty;
+    if (t->nodekind != ExpK)
+        return top;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return mk(t->attr.val, t->attr.val);
+    case IdK:
+        v = varOf(t);
+        return v >= 0 ? env->v[v] : top;
+    case ArrayIdK:
+        a = eval(t->child[0], env);
+        record(t, !isEmpty(a) && a.lo >= 0 && a.hi < arrayLength(declOf(t)), env);
+        return top;
+    case OpK:
+        a = eval(t->child[0], env);
+        b = eval(t->child[1], env);
+        switch (t->attr.op)
+        {
+        case PLUS:
+            return addRange(a, b);
+        case MINUS:
+            return subRange(a, b);
+        case TIMES:
+            return mulRange(a, b);
+        case OVER:
+            return divRange(a, b);
+        default:
+            return isRelop(t->attr.op) ? relRange(t->attr.op, a, b) : top;
+        }
+    case AssignK:
+        if (t->child[0]->kind.exp == ArrayIdK)
+        {
+            eval(t->child[0], env);
+            return eval(t->child[1], env);
+        }
+        b = eval(t->child[1], env);
+        v = varOf(t->child[0]);
+        if (v >= 0 && env->live)
+        {
+            env->v[v] = b;
+            if (isEmpty(b))
+                env->live = FALSE;
+        }
+        return b;
+    case CallK:
+        return evalCall(t, env);
+    default:
+        return top;
+    }
+}
+
+/* Function peek evaluates a pure expression
+ * without recording any verdict
+ */
+static Interval peek(TreeNode *t, Env *env)
+{
+    int saved = recording;
+    Interval r;
+    recording = FALSE;
+    r = eval(t, env);
+    recording = saved;
+    return r;
+}
+
+static void setVar(Env *env, int v, Interval x)
+{
+    env->v[v] = x;
+    if (isEmpty(x))
+        env->live = FALSE;
+}
+
+/* Procedure narrowVar narrows the variable named by
+ * side to the values for which "side op other" holds
+ */
+static void narrowVar(Env *env, TreeNode *side, TokenType op, Interval other)
+{
+    Interval x;
+    int v;
+    if (side->nodekind != ExpK || side->kind.exp != IdK)
+        return;
+    v = varOf(side);
+    if (v < 0 || isEmpty(other))
+        return;
+    x = env->v[v];
+    switch (op)
+    {
+    case LT:
+        x = meet(x, mk(INT_MIN, (long long)other.hi - 1));
+        break;
+    case LE:
+        x = meet(x, mk(INT_MIN, other.hi));
+        break;
+    case GT:
+        x = meet(x, mk((long long)other.lo + 1, INT_MAX));
+        break;
+    case GE:
+        x = meet(x, mk(other.lo, INT_MAX));
+        break;
+    case EQ:
+        x = meet(x, other);
+        break;
+    case NE:
+        if (other.lo == other.hi && !isEmpty(x))
+        {
+            if (x.lo == other.lo)
+                x = mk((long long)x.lo + 1, x.hi);
+            else if (x.hi == other.lo)
+                x = mk(x.lo, (long long)x.hi - 1);
+        }
+        break;
+    default:
+        break;
+    }
+    setVar(env, v, x);
+}
+
+/* Procedure refine narrows env to the states in
+ * which the (already evaluated) condition c has
+ * the given truth value
+ */
+static void refine(Env *env, TreeNode *c, int truth)
+{
+    Interval v;
+    if (!env->live || c == NULL || !isPureExp(c))
+        return;
+    v = peek(c, env);
+    if (truth ? (v.lo == 0 && v.hi == 0) : !contains(v, 0))
+    {
+        env->live = FALSE;
+        return;
+    }
+    if (c->nodekind != ExpK)
+        return;
+    if (c->kind.exp == OpK && isRelop(c->attr.op))
+    {
+        TokenType op = truth ? c->attr.op : negateOp(c->attr.op);
+        narrowVar(env, c->child[0], op, peek(c->child[1], env));
+        if (env->live)
+            narrowVar(env, c->child[1], swapOp(op), peek(c->child[0], env));
+    }
+    else if (c->kind.exp == IdK)
+        narrowVar(env, c, truth ? NE : EQ, mk(0, 0));
+}
+
+static void interpStmt(TreeNode *t, Env *env);
+
+static void interpList(TreeNode *t, Env *env)
+{
+    for (; t != NULL; t = t->sibling)
+        interpStmt(t, env);
+}
+
+/* one trip around a while loop starting at head */
+static Env loopTrip(TreeNode *t, Env *head, Env *entry)
+{
+    Env cur = envCopy(head);
+    eval(t->child[0], &cur);
+    refine(&cur, t->child[0], TRUE);
+    interpStmt(t->child[1], &cur);
+    envJoin(&cur, entry);
+    return cur;
+}
+
+static void interpWhile(TreeNode *t, Env *env)
+{
+    Env head = envCopy(env), cur;
+    int saved = recording;
+    int iter;
+    recording = FALSE;
+    for (iter = 0;; iter++)
+    {
+        cur = loopTrip(t, &head, env);
+        envJoin(&cur, &head);
+        if (iter >= WIDEN_AFTER)
+            envWiden(&cur, &head);
+        if (envWithin(&cur, &head))
+        {
+            envFree(&cur);
+            break;
+        }
+        envFree(&head);
+        head = cur;
+    }
+    for (iter = 0; iter < NARROW_STEPS; iter++)
+    {
+        cur = loopTrip(t, &head, env);
+        envFree(&head);
+        head = cur;
+    }
+    recording = saved;
+    /* the final trip runs in the loop invariant state */
+    eval(t->child[0], &head);
+    cur = envCopy(&head);
+    refine(&cur, t->child[0], TRUE);
+    interpStmt(t->child[1], &cur);
+    envFree(&cur);
+    refine(&head, t->child[0], FALSE);
+    envFree(env);
+    *env = head;
+}
+
+/* Procedure interpStmt interprets one statement */
+static void interpStmt(TreeNode *t, Env *env)
+{
+    Env other;
+    TreeNode *d;
+    int v;
+    if (t == NULL || !env->live)
+        return;
+    if (t->nodekind == ExpK)
+    {
+        eval(t, env);
+        return;
+    }
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        /* locals are undefined on every entry */
+        for (d = t->child[0]; d != NULL; d = d->sibling)
+            if ((v = nodeIndex(varHash, d)) >= 0)
+                env->v[v] = top;
+        interpList(t->child[1], env);
+        break;
+    case IfK:
+        eval(t->child[0], env);
+        other = envCopy(env);
+        refine(env, t->child[0], TRUE);
+        refine(&other, t->child[0], FALSE);
+        interpStmt(t->child[1], env);
+        interpStmt(t->child[2], &other);
+        envJoin(env, &other);
+        envFree(&other);
+        break;
+    case WhileK:
+        interpWhile(t, env);
+        break;
+    case ReturnK:
+        if (t->child[0] != NULL)
+        {
+            Interval a = eval(t->child[0], env);
+            if (env->live)
+                updateSummary(&retRange[curFn], a);
+        }
+        env->live = FALSE;
+        break;
+    default:
+        break;
+    }
+}
+
+static void interpFunction(int f)
+{
+    TreeNode *fn = fnDecl[f];
+    TreeNode *p;
+    Env env = envNew();
+    curFn = f;
+    for (p = fn->child[1]; p != NULL; p = p->sibling)
+    {
+        int v = nodeIndex(varHash, p);
+        if (v >= 0 && called[f])
+            setVar(&env, v, paramIn[v]);
+    }
+    interpStmt(fn->child[2], &env);
+    envFree(&env);
+}
+
+/**************************************************/
+/*************   setup   **************************/
+/**************************************************/
+
+static void walk(TreeNode *t, void (*proc)(TreeNode *))
+{
+    int i;
+    while (t != NULL)
+    {
+        proc(t);
+        for (i = 0; i < MAXCHILDREN; i++)
+            walk(t->child[i], proc);
+        t = t->sibling;
+    }
+}
+
+static void numberDecl(TreeNode *t)
+{
+    if (t->nodekind == StmtK && t->kind.stmt == FunctionK)
+    {
+        if (nFns == maxFns)
+        {
+            maxFns = maxFns ? 2 * maxFns : 16;
+            fnDecl = realloc(fnDecl, maxFns * sizeof(TreeNode *));
+        }
+        nodeSet(fnHash, t, nFns);
+        fnDecl[nFns++] = t;
+    }
+    else if (t->nodekind == ExpK &&
+             (t->kind.exp == VarK || t->kind.exp == SingleParamK))
+    {
+        if (nVars == maxVars)
+        {
+            maxVars = maxVars ? 2 * maxVars : 64;
+            isGlobalVar = realloc(isGlobalVar, maxVars * sizeof(int));
+        }
+        nodeSet(varHash, t, nVars);
+        isGlobalVar[nVars++] = t->scope == globalScope;
+    }
+    else if (t->nodekind == ExpK && t->kind.exp == VarArrayK)
+    {
+        if (nArrays == maxArrays)
+        {
+            maxArrays = maxArrays ? 2 * maxArrays : 16;
+            arrayDecl = realloc(arrayDecl, maxArrays * sizeof(TreeNode *));
+        }
+        arrayDecl[nArrays++] = t;
+    }
+}
+
+static void addThreshold(long long c)
+{
+    int i;
+    if (c < INT_MIN || c > INT_MAX)
+        return;
+    for (i = 0; i < nThresholds && thresholds[i] < c; i++)
+        ;
+    if (i < nThresholds && thresholds[i] == c)
+        return;
+    if (nThresholds == maxThresholds)
+    {
+        maxThresholds = maxThresholds ? 2 * maxThresholds : 32;
+        thresholds = realloc(thresholds, maxThresholds * sizeof(int));
+    }
+    memmove(thresholds + i + 1, thresholds + i, (nThresholds - i) * sizeof(int));
+    thresholds[i] = (int)c;
+    nThresholds++;
+}
+
+/* Procedure collectThreshold adds the constants that
+ * loop bounds are usually derived from, and their
+ * neighbours for strict comparisons
+ */
+static void collectThreshold(TreeNode *t)
+{
+    long long c;
+    if (t->nodekind != ExpK)
+        return;
+    if (t->kind.exp == ConstK)
+        c = t->attr.val;
+    else if (t->kind.exp == VarArrayK)
+        c = t->attr.arr.length;
+    else
+        return;
+    addThreshold(c - 1);
+    addThreshold(c);
+    addThreshold(c + 1);
+}
+
+static void markCalled(TreeNode *t)
+{
+    if (t->nodekind == ExpK && t->kind.exp == CallK)
+    {
+        int f = nodeIndex(fnHash, declOf(t));
+        if (f >= 0)
+            called[f] = TRUE;
+    }
+}
+
+static void countVerdicts(int *safe, int *total)
+{
+    int i;
+    NodeList l;
+    *safe = *total = 0;
+    for (i = 0; i < RANGE_SIZE; i++)
+        for (l = checkHash[i]; l != NULL; l = l->next)
+        {
+            (*total)++;
+            if (l->index == SAFE)
+                (*safe)++;
+        }
+}
+
+/* Procedure rangeAnalysis computes an integer
+ * interval for every scalar at every program
+ * point, following loops, conditions, parameters
+ * and return values, and records which subscripts
+ * are proved in bounds
+ */
+void rangeAnalysis(TreeNode *syntaxTree)
+{
+    int f, i;
+    nodeClear(varHash);
+    nodeClear(fnHash);
+    nodeClear(checkHash);
+    nVars = nFns = nArrays = nThresholds = 0;
+    walk(syntaxTree, numberDecl);
+    walk(syntaxTree, collectThreshold);
+    paramIn = realloc(paramIn, (nVars > 0 ? nVars : 1) * sizeof(Interval));
+    for (i = 0; i < nVars; i++)
+        paramIn[i] = empty;
+    retRange = realloc(retRange, (nFns > 0 ? nFns : 1) * sizeof(Interval));
+    called = realloc(called, (nFns > 0 ? nFns : 1) * sizeof(int));
+    for (f = 0; f < nFns; f++)
+    {
+        retRange[f] = empty;
+        called[f] = FALSE;
+    }
+    walk(syntaxTree, markCalled);
+    /* iterate the summaries to a fixed point;
+       widening bounds the number of rounds */
+    recording = FALSE;
+    pass = 0;
+    do
+    {
+        changed = FALSE;
+        for (f = 0; f < nFns; f++)
+            interpFunction(f);
+        pass++;
+    } while (changed);
+    recording = TRUE;
+    for (f = 0; f < nFns; f++)
+        interpFunction(f);
+    recording = FALSE;
+    if (TraceAnalyze)
+    {
+        int safe, total;
+        fprintf(listing, "\nRange analysis:\n");
+        countVerdicts(&safe, &total);
+        fprintf(listing, "  %d of %d subscripts proved in bounds\n", safe, total);
+    }
+}
+
+/* Function boundsSafe returns TRUE if the subscript
+ * of the ArrayIdK node t is proved to lie within
+ * the bounds of every array it can refer to
+ */
+int boundsSafe(TreeNode *t)
+{
+    return nodeIndex(checkHash, t) == SAFE;
+}
+
+/* Function guardSubscript narrows the guard g
+ * to the entries that keep the subscripts in the
+ * tree t not proved in bounds in bounds, and
+ * returns FALSE if one is not the counter plus a
+ * constant
+ */
+static int guardSubscript(TreeNode *t, LoopGuard *g)
+{
+    TreeNode *d;
+    int i, k, offset;
+    if (t == NULL)
+        return TRUE;
+    if (t->nodekind == ExpK && t->kind.exp == ArrayIdK && !boundsSafe(t))
+    {
+        if (!offsetOf(t->child[0], guardVar, &offset))
+            return FALSE;
+        offset += guardStep;
+        if (-offset > g->low)
+            g->low = -offset;
+        /* the last trip's subscript bound - 1 + lastTrip + offset
+           must lie below the length */
+        d = declOf(t);
+        if (d->kind.exp == ArrayParamK)
+        {
+            for (k = 0; k < g->nParams && declOf(g->param[k]) != d; k++)
+                ;
+            if (k == g->nParams)
+            {
+                if (k == MAX_GUARDED)
+                    return FALSE;
+                g->param[k] = t;
+                g->slack[k] = INT_MIN;
+                g->nParams++;
+            }
+            if (offset + lastTrip > g->slack[k])
+                g->slack[k] = offset + lastTrip;
+        }
+        else if (d->attr.arr.length - offset - lastTrip < g->high)
+            g->high = d->attr.arr.length - offset - lastTrip;
+    }
+    for (i = 0; i < MAXCHILDREN; i++)
+        for (d = t->child[i]; d != NULL; d = d->sibling)
+            if (!guardSubscript(d, g))
+                return FALSE;
+    return TRUE;
+}
+
+/* Function guardBody guards the subscripts of the
+ * statement list t, which is a loop body or the
+ * copies of one unrolling made, counting in
+ * guardStep the steps counter = counter + 1 met
+ * on the way, and sets last to its final statement
+ */
+static int guardBody(TreeNode *t, LoopGuard *g, TreeNode **last)
+{
+    int step;
+    for (; t != NULL; t = t->sibling)
+    {
+        *last = t;
+        if (t->nodekind == StmtK && t->kind.stmt == CompoundK)
+        {
+            if (!guardBody(t->child[1], g, last))
+                return FALSE;
+        }
+        else if (t->nodekind == ExpK && t->kind.exp == AssignK &&
+                 isVar(t->child[0], guardVar))
+        {
+            if (!offsetOf(t->child[1], guardVar, &step) || step != 1)
+                return FALSE;
+            guardStep++;
+        }
+        else if (!guardSubscript(t, g))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+int guardLoop(TreeNode *loop, LoopGuard *g)
+{
+    TreeNode *test = loop->child[0], *body = loop->child[1], *last;
+    if (test->nodekind != ExpK || test->kind.exp != OpK ||
+        (test->attr.op != LT && test->attr.op != LE) ||
+        test->child[0]->kind.exp != IdK || !isScalar(guardVar = declOf(test->child[0])) ||
+        !isInvariant(test->child[1], body))
+        return FALSE;
+    if (body->nodekind != StmtK || body->kind.stmt != CompoundK)
+        return FALSE;
+    lastTrip = test->attr.op == LE;
+    guardStep = 0;
+    g->counter = test->child[0];
+    g->low = INT_MIN;
+    g->bound = test->child[1];
+    g->high = INT_MAX;
+    g->nParams = 0;
+    /* the body ends in a step counter = counter + 1
+       and steps the counter nowhere else */
+    last = NULL;
+    if (!guardBody(body->child[1], g, &last) || last == NULL ||
+        last->nodekind != ExpK || last->kind.exp != AssignK ||
+        !isVar(last->child[0], guardVar) || assignCount(body, guardVar) != guardStep)
+        return FALSE;
+    /* a guard no entry passes is no use either */
+    return (g->nParams > 0 || g->high < INT_MAX) && g->high >= g->low;
+}
@@ -0,0 +1,56 @@
+/****************************************************/
+/* File: range.h                                    */
+/* Value-range analysis interface                   */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _RANGE_H_
+#define _RANGE_H_
+
+/* Procedure rangeAnalysis computes an integer
+ * interval for every scalar at every program
+ * point, following loops, conditions, parameters
+ * and return values, and records which subscripts
+ * are proved in bounds
+ */
+void rangeAnalysis(TreeNode *syntaxTree);
+
+/* Function boundsSafe returns TRUE if the subscript
+ * of the ArrayIdK node t is proved to lie within
+ * the bounds of every array it can refer to
+ */
+int boundsSafe(TreeNode *t);
+
+/* MAX_GUARDED is the most array parameters a
+ * loop guard compares with
+ */
+#define MAX_GUARDED 4
+
+/* a loop all of whose checked subscripts are in
+ * bounds if on entry counter >= low, bound <= high
+ * and bound + slack[k] is at most the length of
+ * the array parameter that param[k] subscripts
+ */
+typedef struct
+{
+    TreeNode *counter; /* the counter the loop tests */
+    int low;
+    TreeNode *bound; /* what the counter is compared with */
+    int high;        /* INT_MAX if no declared array limits it */
+    int nParams;
+    TreeNode *param[MAX_GUARDED];
+    int slack[MAX_GUARDED];
+} LoopGuard;
+
+/* Function guardLoop returns TRUE if the WhileK
+ * node loop steps a counter by one up to an
+ * unchanging bound, at the end of its body or of
+ * each copy unrolling made of it, and every
+ * subscript in it that is not proved in bounds is
+ * the counter plus a constant, and then describes
+ * in g the test on entry that proves them all in
+ * bounds
+ */
+int guardLoop(TreeNode *loop, LoopGuard *g);
+
+#endif
@@ -0,0 +1,1001 @@
+/****************************************************/
+/* File: regalloc.c                                 */
+/* Register allocation for the IR back end          */
+/* for the TINY compiler                            */
+/* The scalar locals become IR registers, one for   */
+/* each web of their defs and uses, so that a loop  */
+/* counter is allocated like any temp. Every IR     */
+/* register read gets one live interval, from its   */
+/* first to its last position in the layout, the    */
+/* blocks it is live through included. A register   */
+/* read only by the next instruction passes in ac,  */
+/* or in ac1 when that reads it second; the others  */
+/* are handed the free TM registers in order of     */
+/* start, and when none is left, the one whose defs */
+/* and uses, weighted by loop depth, cost least in  */
+/* the frame gives up its register. How many        */
+/* registers intervals leaving their block may      */
+/* hold, leaving the rest to the temps, is chosen   */
+/* by trying each number. A call clobbers every     */
+/* register, so an interval spanning one is saved   */
+/* and reloaded around it, and a constant in the    */
+/* frame is loaded where it is read. Before the     */
+/* scan, a move whose source is not read again, or  */
+/* whose destination is only a copy, is removed by  */
+/* giving both the same register, and so is a step  */
+/* r = r + c unless the scan costs more with it.    */
+/* Code from the tree code generator keeps values   */
+/* in registers through scalar.c and its temps      */
+/* instead                                          */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "bitset.h"
+#include "ir.h"
+#include "regalloc.h"
+
+/* LOOP_WEIGHT is how many times more often a
+ * position runs than one outside its loop
+ */
+#define LOOP_WEIGHT 8
+
+/* MAX_DEPTH bounds the loop depth counted */
+#define MAX_DEPTH 4
+
+/* LAST_SCAN bounds the TM registers handed out */
+#define LAST_SCAN 8
+
+static int *uses = NULL;
+static int maxUses = 0;
+
+/* Function readsOf stores the registers i reads
+ * into uses and returns their number
+ */
+static int readsOf(IrInst *i)
+{
+    if (irMaxUses(i) > maxUses)
+    {
+        maxUses = irMaxUses(i);
+        uses = realloc(uses, maxUses * sizeof(int));
+    }
+    return irUses(i, uses);
+}
+
+/* the registers live on entry to and on exit
+ * from every block of the function
+ */
+static Bitset *liveIn, *liveOut;
+static int nLive;
+
+/* Procedure liveness computes liveIn and liveOut
+ * for the blocks of f
+ */
+static void liveness(IrFunc *f)
+{
+    Bitset *gen = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    Bitset *kill = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    IrBlock **order = (IrBlock **)malloc(f->nBlocks * sizeof(IrBlock *));
+    IrBlock *b;
+    IrInst *i;
+    int nb = 0, changed, k, n;
+    nLive = f->nBlocks;
+    liveIn = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    liveOut = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    for (k = 0; k < f->nBlocks; k++)
+    {
+        gen[k] = bsNew(f->nRegs);
+        kill[k] = bsNew(f->nRegs);
+        liveIn[k] = bsNew(f->nRegs);
+        liveOut[k] = bsNew(f->nRegs);
+    }
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        order[nb++] = b;
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+                if (!bsTest(kill[b->id], uses[k]))
+                    bsSet(gen[b->id], uses[k]);
+            if (i->dst != NO_REG)
+                bsSet(kill[b->id], i->dst);
+        }
+    }
+    /* backwards, so that most sets settle in one sweep */
+    do
+    {
+        changed = FALSE;
+        for (k = nb - 1; k >= 0; k--)
+        {
+            int s;
+            b = order[k];
+            for (s = 0; s < b->nsucc; s++)
+                bsUnion(liveOut[b->id], liveIn[b->succ[s]->id]);
+            if (bsTransfer(liveIn[b->id], gen[b->id], liveOut[b->id], kill[b->id]))
+                changed = TRUE;
+        }
+    } while (changed);
+    for (k = 0; k < f->nBlocks; k++)
+    {
+        bsFree(gen[k]);
+        bsFree(kill[k]);
+    }
+    free(gen);
+    free(kill);
+    free(order);
+}
+
+static void freeLiveness(void)
+{
+    int k;
+    for (k = 0; k < nLive; k++)
+    {
+        bsFree(liveIn[k]);
+        bsFree(liveOut[k]);
+    }
+    free(liveIn);
+    free(liveOut);
+}
+
+/**************************************************/
+/*************   promotion of locals   ************/
+/**************************************************/
+
+static int isLocal(TreeNode *d)
+{
+    return d != NULL && d->nodekind == ExpK &&
+           (d->kind.exp == VarK || d->kind.exp == SingleParamK) &&
+           d->scope != globalScope;
+}
+
+/* Procedure newEntry puts an empty block ahead of
+ * the entry of f, which a loop may come back to
+ */
+static void newEntry(IrFunc *f)
+{
+    IrBlock *b = irNewBlock(f), *prev = f->entry;
+    IrInst *jump = irNewInst(IrJump);
+    while (prev->next != b)
+        prev = prev->next;
+    prev->next = NULL;
+    f->last = prev;
+    jump->target[0] = f->entry;
+    irAppend(b, jump);
+    b->next = f->entry;
+    f->entry = b;
+    irComputeCfg(f);
+}
+
+static void renameUses(IrInst *i, int from, int to)
+{
+    int k;
+    for (k = 0; k < 2; k++)
+        if (i->src[k] == from)
+            i->src[k] = to;
+    for (k = 0; k < i->nargs; k++)
+        if (i->args[k] == from)
+            i->args[k] = to;
+}
+
+/* the defs of the locals, for splitWebs */
+static int *defVar; /* register the def writes */
+static int *parent; /* union-find forest of the webs */
+
+static int findWeb(int d)
+{
+    while (parent[d] != d)
+        d = parent[d] = parent[parent[d]];
+    return d;
+}
+
+/* Function reachingDef joins the webs of the defs
+ * of v in cur, those reaching the instruction, and
+ * returns one of them, or -1
+ */
+static int reachingDef(Bitset cur, int v)
+{
+    int d, first = -1;
+    for (d = bsNext(cur, 0); d >= 0; d = bsNext(cur, d + 1))
+        if (defVar[d] == v)
+        {
+            if (first < 0)
+                first = d;
+            else
+                parent[findWeb(d)] = findWeb(first);
+        }
+    return first;
+}
+
+/* Procedure splitWebs gives each web of the locals
+ * regs[0..n-1] of f, the defs reaching a common
+ * use and those uses, a register of its own, so
+ * that a local used again for something else makes
+ * two intervals
+ */
+static void splitWebs(IrFunc *f, int *regs, int n)
+{
+    int nOld = f->nRegs, nWebDefs = 0, changed, pass, d, k, m, v;
+    int *local = (int *)malloc(nOld * sizeof(int));
+    int *taken = (int *)calloc(n, sizeof(int));
+    int *webReg;
+    Bitset *defsOf, *in, *out, *gen, *kill, cur;
+    IrBlock *b;
+    IrInst *i;
+    for (v = 0; v < nOld; v++)
+        local[v] = -1;
+    for (k = 0; k < n; k++)
+        local[regs[k]] = k;
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if (i->dst != NO_REG && local[i->dst] >= 0)
+                nWebDefs++;
+    defVar = (int *)malloc((nWebDefs + 1) * sizeof(int));
+    parent = (int *)malloc((nWebDefs + 1) * sizeof(int));
+    webReg = (int *)malloc((nWebDefs + 1) * sizeof(int));
+    defsOf = (Bitset *)malloc(n * sizeof(Bitset));
+    for (k = 0; k < n; k++)
+        defsOf[k] = bsNew(nWebDefs);
+    in = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    out = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    gen = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    kill = (Bitset *)malloc(f->nBlocks * sizeof(Bitset));
+    for (k = 0; k < f->nBlocks; k++)
+    {
+        in[k] = bsNew(nWebDefs);
+        out[k] = bsNew(nWebDefs);
+        gen[k] = bsNew(nWebDefs);
+        kill[k] = bsNew(nWebDefs);
+    }
+    d = 0;
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if (i->dst != NO_REG && local[i->dst] >= 0)
+            {
+                defVar[d] = i->dst;
+                parent[d] = d;
+                webReg[d] = NO_REG;
+                bsSet(defsOf[local[i->dst]], d++);
+            }
+    d = 0;
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if (i->dst != NO_REG && local[i->dst] >= 0)
+            {
+                bsDiff(gen[b->id], defsOf[local[i->dst]]);
+                bsUnion(kill[b->id], defsOf[local[i->dst]]);
+                bsSet(gen[b->id], d++);
+            }
+    /* the defs reaching every block */
+    do
+    {
+        changed = FALSE;
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            for (k = 0; k < b->npred; k++)
+                bsUnion(in[b->id], out[b->pred[k]->id]);
+            if (bsTransfer(out[b->id], gen[b->id], in[b->id], kill[b->id]))
+                changed = TRUE;
+        }
+    } while (changed);
+
+    /* the first pass joins the webs, the second
+     * renames the registers
+     */
+    cur = bsNew(nWebDefs);
+    for (pass = 0; pass < 2; pass++)
+    {
+        d = 0;
+        for (b = f->entry; b != NULL; b = b->next)
+        {
+            bsCopy(cur, in[b->id]);
+            for (i = b->first; i != NULL; i = i->next)
+            {
+                m = readsOf(i);
+                for (k = 0; k < m; k++)
+                    if (uses[k] < nOld && local[uses[k]] >= 0 &&
+                        (v = reachingDef(cur, uses[k])) >= 0 && pass == 1)
+                        renameUses(i, uses[k], webReg[findWeb(v)]);
+                if (i->dst == NO_REG || i->dst >= nOld || local[i->dst] < 0)
+                    continue;
+                bsDiff(cur, defsOf[local[i->dst]]);
+                bsSet(cur, d);
+                if (pass == 1)
+                    i->dst = webReg[findWeb(d)];
+                d++;
+            }
+        }
+        /* the first web of a local keeps its register */
+        for (d = 0; pass == 0 && d < nWebDefs; d++)
+            if (webReg[findWeb(d)] == NO_REG)
+            {
+                k = local[defVar[d]];
+                webReg[findWeb(d)] = taken[k] ? irNewReg(f) : defVar[d];
+                taken[k] = TRUE;
+            }
+    }
+
+    for (k = 0; k < n; k++)
+        bsFree(defsOf[k]);
+    for (k = 0; k < f->nBlocks; k++)
+    {
+        bsFree(in[k]);
+        bsFree(out[k]);
+        bsFree(gen[k]);
+        bsFree(kill[k]);
+    }
+    bsFree(cur);
+    free(defsOf);
+    free(in);
+    free(out);
+    free(gen);
+    free(kill);
+    free(local);
+    free(taken);
+    free(defVar);
+    free(parent);
+    free(webReg);
+}
+
+/* Function promoteFunc turns the loads and stores
+ * of the locals of f into moves from and to a
+ * register for each, and returns their number
+ */
+static int promoteFunc(IrFunc *f)
+{
+    TreeNode **syms = NULL;
+    int *regs = NULL;
+    int n = 0, k;
+    IrBlock *b;
+    IrInst *i;
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            if ((i->op != IrLoad && i->op != IrStore) || !isLocal(i->sym))
+                continue;
+            for (k = 0; k < n && syms[k] != i->sym; k++)
+                ;
+            if (k == n)
+            {
+                syms = realloc(syms, (n + 1) * sizeof(TreeNode *));
+                regs = realloc(regs, (n + 1) * sizeof(int));
+                syms[n] = i->sym;
+                regs[n++] = irNewReg(f);
+            }
+            if (i->op == IrLoad)
+                i->src[0] = regs[k];
+            else
+                i->dst = regs[k];
+            i->op = IrMove;
+            i->sym = NULL;
+        }
+    if (n > 0)
+    {
+        /* what may be read before it is written comes
+         * from the frame, as it did before
+         */
+        liveness(f);
+        b = f->entry;
+        if (b->npred > 0)
+            newEntry(f);
+        for (k = 0; k < n; k++)
+            if (bsTest(liveIn[b->id], regs[k]))
+            {
+                i = irNewInst(IrLoad);
+                i->dst = regs[k];
+                i->sym = syms[k];
+                i->tree = syms[k];
+                irInsertBefore(f->entry, f->entry->first, i);
+            }
+        freeLiveness();
+        splitWebs(f, regs, n);
+    }
+    free(syms);
+    free(regs);
+    return n;
+}
+
+/* Function promoteLocals makes every scalar local
+ * and parameter that a function only loads and
+ * stores an IR register of its own, loading it on
+ * entry if it may be read before it is written,
+ * and returns the number of scalars promoted
+ */
+int promoteLocals(IrFunc *prog)
+{
+    IrFunc *f;
+    int n = 0;
+    for (f = prog; f != NULL; f = f->next)
+        if (f->fn->child[2] != NULL && f->entry != NULL)
+            n += promoteFunc(f);
+    if (TraceAnalyze)
+        fprintf(listing, "\nPromotion: %d locals promoted to IR registers\n", n);
+    return n;
+}
+
+/**************************************************/
+/*************   move coalescing   ****************/
+/**************************************************/
+
+static int reads(IrInst *i, int r)
+{
+    int n = readsOf(i), k;
+    for (k = 0; k < n; k++)
+        if (uses[k] == r)
+            return TRUE;
+    return FALSE;
+}
+
+/* Function readsFirst returns TRUE if the TM code
+ * of op reads the first source before it writes
+ * any register
+ */
+static int readsFirst(IrOp op)
+{
+    switch (op)
+    {
+    case IrMove:
+    case IrAddI:
+    case IrAdd:
+    case IrSub:
+    case IrMul:
+    case IrDiv:
+    case IrLt:
+    case IrLe:
+    case IrGt:
+    case IrGe:
+    case IrEq:
+    case IrNe:
+    case IrStore:
+    case IrCheck:
+    case IrOut:
+    case IrBranch:
+    case IrRet:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+static int *nDefs, *nUses;
+static IrInst **defInst;
+
+/* Function mergeDef removes the move w = t if t
+ * is computed earlier in block b only for it and
+ * w is not touched in between, by computing w
+ * there instead
+ */
+static int mergeDef(IrBlock *b, IrInst *move)
+{
+    int w = move->dst, t = move->src[0];
+    IrInst *d = defInst[t], *i;
+    if (nDefs[t] != 1 || nUses[t] != 1)
+        return FALSE;
+    for (i = move->prev; i != NULL && i != d; i = i->prev)
+        if (i->dst == w || reads(i, w))
+            return FALSE;
+    if (i == NULL)
+        return FALSE;
+    d->dst = w;
+    if (defInst[w] == move)
+        defInst[w] = d;
+    nDefs[t] = nUses[t] = 0;
+    irRemove(b, move);
+    free(move);
+    return TRUE;
+}
+
+/* Function mergeCopy removes the move t = w if
+ * that is the only def of t, all the reads of t
+ * follow in block b and w keeps its value until
+ * the last of them, by reading w instead
+ */
+static int mergeCopy(IrBlock *b, IrInst *move)
+{
+    int t = move->dst, w = move->src[0], left = nUses[t];
+    IrInst *i, *last;
+    if (nDefs[t] != 1)
+        return FALSE;
+    for (i = move->next; i != NULL && left > 0; i = i->next)
+    {
+        int n = readsOf(i), k;
+        for (k = 0; k < n; k++)
+            left -= uses[k] == t;
+        if (left > 0 && i->dst == w)
+            return FALSE;
+    }
+    if (left > 0)
+        return FALSE;
+    last = i;
+    for (i = move->next; i != last; i = i->next)
+        renameUses(i, t, w);
+    nUses[w] += nUses[t] - 1;
+    nDefs[t] = nUses[t] = 0;
+    irRemove(b, move);
+    free(move);
+    return TRUE;
+}
+
+/* Procedure countRegs counts the defs and reads
+ * of every register of f, noting a def of each
+ */
+static void countRegs(IrFunc *f)
+{
+    IrBlock *b;
+    IrInst *i;
+    int k, n;
+    for (k = 0; k < f->nRegs; k++)
+    {
+        nDefs[k] = nUses[k] = 0;
+        defInst[k] = NULL;
+    }
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+                nUses[uses[k]]++;
+            if (i->dst != NO_REG)
+            {
+                nDefs[i->dst]++;
+                defInst[i->dst] = i;
+            }
+        }
+}
+
+/* Procedure coalesce removes the moves of f that
+ * mergeDef or mergeCopy can
+ */
+static void coalesce(IrFunc *f)
+{
+    IrBlock *b;
+    IrInst *i, *next;
+    int changed;
+    nDefs = (int *)malloc(f->nRegs * sizeof(int));
+    nUses = (int *)malloc(f->nRegs * sizeof(int));
+    defInst = (IrInst **)malloc(f->nRegs * sizeof(IrInst *));
+    do
+    {
+        changed = FALSE;
+        countRegs(f);
+        for (b = f->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = next)
+            {
+                next = i->next;
+                if (i->op != IrMove)
+                    continue;
+                if (i->dst == i->src[0])
+                {
+                    irRemove(b, i);
+                    free(i);
+                    changed = TRUE;
+                }
+                else if (mergeDef(b, i) || mergeCopy(b, i))
+                    changed = TRUE;
+            }
+    } while (changed);
+    free(nDefs);
+    free(nUses);
+    free(defInst);
+}
+
+/**************************************************/
+/*************   linear scan   ********************/
+/**************************************************/
+
+static RegAlloc *alloc;
+static int *liveStart; /* start of the interval from a live-in */
+static int *benefit;   /* what the register saves over the frame */
+static int *global;    /* TRUE if the interval leaves its block */
+
+static int byStart(const void *a, const void *b)
+{
+    int u = *(const int *)a, v = *(const int *)b;
+    if (alloc->start[u] != alloc->start[v])
+        return alloc->start[u] - alloc->start[v];
+    return u - v;
+}
+
+/* Procedure touch extends the interval of v to
+ * position pos, which runs weight times
+ */
+static void touch(int v, int pos, int weight)
+{
+    if (pos < alloc->start[v])
+        alloc->start[v] = pos;
+    if (pos > alloc->end[v])
+        alloc->end[v] = pos;
+    benefit[v] += weight;
+}
+
+/* Procedure buildIntervals finds the live interval
+ * of every register of f, the calls it spans and
+ * what keeping it in a register saves
+ */
+static void buildIntervals(IrFunc *f)
+{
+    int *first = (int *)malloc(f->nBlocks * sizeof(int));
+    int *last = (int *)malloc(f->nBlocks * sizeof(int));
+    int *depth, *weight, *read, *callAt;
+    int nInsts = 0, pos, k, n, v;
+    IrBlock *b;
+    IrInst *i;
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        first[b->id] = nInsts;
+        for (i = b->first; i != NULL; i = i->next)
+            nInsts++;
+        last[b->id] = nInsts - 1;
+    }
+    depth = (int *)calloc(nInsts + 1, sizeof(int));
+    weight = (int *)malloc((nInsts + 1) * sizeof(int));
+    callAt = (int *)malloc((nInsts + 1) * sizeof(int));
+    read = (int *)calloc(f->nRegs, sizeof(int));
+    nDefs = (int *)calloc(f->nRegs, sizeof(int));
+    /* a jump back to a block covers a loop */
+    for (b = f->entry; b != NULL; b = b->next)
+        for (k = 0; k < b->nsucc; k++)
+            if (first[b->succ[k]->id] <= first[b->id])
+                for (pos = first[b->succ[k]->id]; pos <= last[b->id]; pos++)
+                    depth[pos]++;
+    for (pos = 0; pos < nInsts; pos++)
+        for (weight[pos] = 1, k = 0; k < depth[pos] && k < MAX_DEPTH; k++)
+            weight[pos] *= LOOP_WEIGHT;
+
+    for (v = 0; v < f->nRegs; v++)
+    {
+        alloc->start[v] = liveStart[v] = nInsts;
+        alloc->end[v] = -1;
+        alloc->calls[v] = benefit[v] = global[v] = 0;
+        alloc->def[v] = NULL;
+    }
+    for (b = f->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+            if (i->dst != NO_REG && nDefs[i->dst]++ == 0)
+                alloc->def[i->dst] = i;
+    for (v = 0; v < f->nRegs; v++)
+        if (nDefs[v] != 1)
+            alloc->def[v] = NULL;
+    pos = 0;
+    for (b = f->entry; b != NULL; b = b->next)
+    {
+        for (v = bsNext(liveIn[b->id], 0); v >= 0; v = bsNext(liveIn[b->id], v + 1))
+        {
+            if (first[b->id] < alloc->start[v])
+                alloc->start[v] = liveStart[v] = first[b->id];
+            if (first[b->id] > alloc->end[v])
+                alloc->end[v] = first[b->id];
+            global[v] = TRUE;
+        }
+        for (v = bsNext(liveOut[b->id], 0); v >= 0; v = bsNext(liveOut[b->id], v + 1))
+        {
+            if (last[b->id] > alloc->end[v])
+                alloc->end[v] = last[b->id];
+            global[v] = TRUE;
+        }
+        for (i = b->first; i != NULL; i = i->next, pos++)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+            {
+                touch(uses[k], pos, weight[pos]);
+                read[uses[k]] = TRUE;
+            }
+            /* a constant in the frame is loaded where it
+             * is read instead
+             */
+            if (i->dst != NO_REG)
+                touch(i->dst, pos, i->op == IrConst && alloc->def[i->dst] == i
+                                       ? -weight[pos] : weight[pos]);
+            callAt[pos] = i->op == IrCall;
+        }
+    }
+    /* a value in the frame costs a store for each def
+     * and a load for each use; one in a register a
+     * store and a load for each call it spans
+     */
+    for (pos = 0; pos < nInsts; pos++)
+        if (callAt[pos])
+            for (v = 0; v < f->nRegs; v++)
+                if (alloc->start[v] < pos && pos < alloc->end[v])
+                    alloc->calls[v] += weight[pos];
+    for (v = 0; v < f->nRegs; v++)
+    {
+        if (!read[v])
+            alloc->start[v] = -1;
+        benefit[v] -= 2 * alloc->calls[v];
+    }
+    free(first);
+    free(last);
+    free(depth);
+    free(weight);
+    free(callAt);
+    free(read);
+    free(nDefs);
+}
+
+/* Function scan hands the TM registers
+ * first..first+count-1 out over the n intervals
+ * of order, taken by start, those that leave their
+ * block only getting one of the first limit, and
+ * returns the cost of the intervals left in the
+ * frame
+ */
+static int scan(int *order, int n, int first, int count, int limit)
+{
+    int active[LAST_SCAN], cost = 0, j, k, u, v, victim;
+    for (k = 0; k < count; k++)
+        active[k] = -1;
+    for (j = 0; j < n; j++)
+        alloc->reg[order[j]] = -1;
+    for (j = 0; j < n; j++)
+    {
+        v = order[j];
+        /* an interval that ends where v starts frees
+         * its register if v is written there, since
+         * the sources are read first
+         */
+        for (k = 0; k < count; k++)
+            if ((u = active[k]) >= 0 &&
+                (alloc->end[u] < alloc->start[v] ||
+                 (alloc->end[u] == alloc->start[v] && liveStart[v] != alloc->start[v])))
+                active[k] = -1;
+        victim = -1;
+        for (k = 0; k < (global[v] ? limit : count); k++)
+            if (active[k] < 0)
+                break;
+            else if (victim < 0 || benefit[active[k]] < benefit[active[victim]])
+                victim = k;
+        if (k == (global[v] ? limit : count))
+        {
+            /* the cheapest interval goes to the frame */
+            if (victim < 0 || benefit[active[victim]] >= benefit[v])
+            {
+                cost += benefit[v];
+                continue;
+            }
+            cost += benefit[active[victim]];
+            alloc->reg[active[victim]] = -1;
+            k = victim;
+        }
+        active[k] = v;
+        alloc->reg[v] = first + k;
+    }
+    return cost;
+}
+
+/* Function passes returns TRUE if v is only read
+ * as the first source of the instruction after its
+ * def, which can find it in the scratch register
+ */
+static int passes(int v)
+{
+    IrInst *d = alloc->def[v];
+    return d != NULL && !global[v] && alloc->end[v] == alloc->start[v] + 1 &&
+           d->next != NULL && d->next->src[0] == v && readsFirst(d->next->op);
+}
+
+/* Function passesSecond returns TRUE if v is only
+ * read as the second source of the operation after
+ * its def, which can find it in the second scratch
+ * register as the first is loaded into the other
+ */
+static int passesSecond(int v)
+{
+    IrInst *d = alloc->def[v];
+    return d != NULL && !global[v] && alloc->end[v] == alloc->start[v] + 1 &&
+           d->next != NULL && d->next->src[1] == v && d->next->src[0] != v &&
+           d->next->op >= IrAdd && d->next->op <= IrNe;
+}
+
+/* Function hasCall returns TRUE if block b calls
+ * a function
+ */
+static int hasCall(IrBlock *b)
+{
+    IrInst *i;
+    for (i = b->first; i != NULL; i = i->next)
+        if (i->op == IrCall)
+            return TRUE;
+    return FALSE;
+}
+
+/* a step mergeStep computed in the register it
+ * reads, and the end of the reads it renamed
+ */
+typedef struct
+{
+    IrInst *def;
+    int reg; /* the register of the result before */
+    IrInst *last;
+} Step;
+
+static Step *steps = NULL;
+static int nSteps, maxSteps = 0;
+
+/* Function mergeStep computes the step d in the
+ * register w it reads if w is not read again
+ * before a later write in its block and all the
+ * reads of the result come before that write or
+ * in it, so that a chain of steps such as the
+ * counter of an unrolled loop takes one register
+ * instead of one for each step. A block with a
+ * call is left alone, as the scan undercounts the
+ * saves around the call a longer life brings
+ */
+static int mergeStep(IrInst *d)
+{
+    int t = d->dst, w = d->src[0], left;
+    IrInst *i, *last;
+    if (t == NO_REG || (!readsFirst(d->op) && d->op != IrLoadX) || t == w ||
+        nDefs[t] != 1)
+        return FALSE;
+    left = nUses[t];
+    for (i = d->next; i != NULL; i = i->next)
+    {
+        int n = readsOf(i), k;
+        for (k = 0; k < n; k++)
+            if (uses[k] == w)
+                return FALSE;
+            else if (uses[k] == t)
+                left--;
+        if (i->dst == w)
+            break;
+    }
+    if (i == NULL || left > 0)
+        return FALSE;
+    last = i->next;
+    d->dst = w;
+    for (i = d->next; i != last; i = i->next)
+        renameUses(i, t, w);
+    nDefs[w]++;
+    nUses[w] += nUses[t];
+    nDefs[t] = nUses[t] = 0;
+    if (nSteps == maxSteps)
+    {
+        maxSteps = maxSteps > 0 ? 2 * maxSteps : 16;
+        steps = realloc(steps, maxSteps * sizeof(Step));
+    }
+    steps[nSteps].def = d;
+    steps[nSteps].reg = t;
+    steps[nSteps++].last = last;
+    return TRUE;
+}
+
+/* Function mergeSteps merges the steps of f that
+ * mergeStep can and returns their number
+ */
+static int mergeSteps(IrFunc *f)
+{
+    IrBlock *b;
+    IrInst *i;
+    nSteps = 0;
+    nDefs = (int *)malloc(f->nRegs * sizeof(int));
+    nUses = (int *)malloc(f->nRegs * sizeof(int));
+    defInst = (IrInst **)malloc(f->nRegs * sizeof(IrInst *));
+    countRegs(f);
+    for (b = f->entry; b != NULL; b = b->next)
+        if (!hasCall(b))
+            for (i = b->first; i != NULL; i = i->next)
+                mergeStep(i);
+    free(nDefs);
+    free(nUses);
+    free(defInst);
+    return nSteps;
+}
+
+/* Procedure splitSteps undoes the merges of
+ * mergeSteps, the last first, so that the reads
+ * each one renamed are again those of its result
+ */
+static void splitSteps(void)
+{
+    IrInst *i, *d;
+    while (nSteps > 0)
+    {
+        d = steps[--nSteps].def;
+        for (i = d->next; i != steps[nSteps].last; i = i->next)
+            renameUses(i, d->dst, steps[nSteps].reg);
+        d->dst = steps[nSteps].reg;
+    }
+}
+
+/* Function assign finds the live intervals of f,
+ * hands the TM registers first..first+count-1 out
+ * over them, using order to sort them, and returns
+ * the cost of the intervals left in the frame
+ */
+static int assign(IrFunc *f, int *order, int first, int count, int scratch,
+                  int second)
+{
+    int n = 0, limit, bestLimit = 0, best = 0, cost, v;
+    liveness(f);
+    buildIntervals(f);
+    freeLiveness();
+    for (v = 0; v < f->nRegs; v++)
+    {
+        alloc->reg[v] = -1;
+        if (alloc->start[v] >= 0 && passes(v))
+            alloc->reg[v] = scratch;
+        else if (alloc->start[v] >= 0 && passesSecond(v))
+            alloc->reg[v] = second;
+        else if (alloc->start[v] >= 0 && benefit[v] > 0)
+            order[n++] = v;
+    }
+    qsort(order, n, sizeof(int), byStart);
+    /* the intervals that leave their block may
+     * only take the first limit registers, leaving
+     * the others to the temps within one; the limit
+     * that leaves the least in the frame wins
+     */
+    if (count > LAST_SCAN)
+        count = LAST_SCAN;
+    for (limit = 0; limit <= count; limit++)
+    {
+        cost = scan(order, n, first, count, limit);
+        if (limit == 0 || cost < best)
+        {
+            best = cost;
+            bestLimit = limit;
+        }
+    }
+    scan(order, n, first, count, bestLimit);
+    return best;
+}
+
+/* Function linearScan merges the IR registers of f
+ * that a move joins where their lives allow it,
+ * then hands the TM registers first..first+count-1
+ * out over the live intervals, and returns where
+ * each IR register lives. An interval that spans
+ * a call only keeps its register if saving it
+ * around the calls costs less than the frame; a
+ * register only the next instruction reads first
+ * passes in scratch, and one only the operation
+ * after it reads second passes in second.
+ */
+RegAlloc *linearScan(IrFunc *f, int first, int count, int scratch, int second)
+{
+    RegAlloc *a = (RegAlloc *)malloc(sizeof(RegAlloc));
+    int size = f->nRegs > 0 ? f->nRegs : 1;
+    int *order = (int *)malloc(size * sizeof(int));
+    int cost;
+    a->reg = (int *)malloc(size * sizeof(int));
+    a->start = (int *)malloc(size * sizeof(int));
+    a->end = (int *)malloc(size * sizeof(int));
+    a->calls = (int *)malloc(size * sizeof(int));
+    a->def = (IrInst **)malloc(size * sizeof(IrInst *));
+    liveStart = (int *)malloc(size * sizeof(int));
+    benefit = (int *)malloc(size * sizeof(int));
+    global = (int *)malloc(size * sizeof(int));
+    alloc = a;
+
+    coalesce(f);
+    cost = assign(f, order, first, count, scratch, second);
+    /* a chain of steps frees registers, but one
+     * merged into a register left in the frame
+     * costs a store and a load more
+     */
+    if (mergeSteps(f) > 0 && assign(f, order, first, count, scratch, second) > cost)
+    {
+        splitSteps();
+        assign(f, order, first, count, scratch, second);
+    }
+    free(order);
+    free(liveStart);
+    free(benefit);
+    free(global);
+    return a;
+}
+
+/* Procedure freeRegAlloc releases an allocation */
+void freeRegAlloc(RegAlloc *a)
+{
+    free(a->reg);
+    free(a->start);
+    free(a->end);
+    free(a->calls);
+    free(a->def);
+    free(a);
+}
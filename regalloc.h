@@ -0,0 +1,50 @@
+/****************************************************/
+/* File: regalloc.h                                 */
+/* Register allocation for the IR back end          */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _REGALLOC_H_
+#define _REGALLOC_H_
+
+#include "ir.h"
+
+/* where the IR registers of a function live; the
+ * instructions are numbered in layout order, and
+ * a constant left in the frame is loaded where it
+ * is read instead
+ */
+typedef struct
+{
+    int *reg;   /* TM register, or -1 for a frame word */
+    int *start; /* first position of the live interval, or -1 if never read */
+    int *end;   /* last position of the live interval */
+    int *calls; /* calls strictly inside the interval, weighted by loop depth */
+    IrInst **def; /* the only def, or NULL */
+} RegAlloc;
+
+/* Function promoteLocals makes every scalar local
+ * and parameter that a function only loads and
+ * stores an IR register of its own, loading it on
+ * entry if it may be read before it is written,
+ * and returns the number of scalars promoted
+ */
+int promoteLocals(IrFunc *prog);
+
+/* Function linearScan merges the IR registers of f
+ * that a move joins where their lives allow it,
+ * then hands the TM registers first..first+count-1
+ * out over the live intervals, and returns where
+ * each IR register lives. An interval that spans
+ * a call only keeps its register if saving it
+ * around the calls costs less than the frame; a
+ * register only the next instruction reads first
+ * passes in scratch, and one only the operation
+ * after it reads second passes in second.
+ */
+RegAlloc *linearScan(IrFunc *f, int first, int count, int scratch, int second);
+
+/* Procedure freeRegAlloc releases an allocation */
+void freeRegAlloc(RegAlloc *a);
+
+#endif
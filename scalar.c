@@ -0,0 +1,177 @@
+/****************************************************/
+/* File: scalar.c                                   */
+/* Scalar replacement in loops                      */
+/* for the TINY compiler                            */
+/* A loop without calls may keep a scalar, or an    */
+/* element of a declared array at a constant        */
+/* subscript, in a register from its entry to its   */
+/* exits, when no other access in the loop can      */
+/* reach the value. The code generator loads it     */
+/* before the loop and stores it back at the exits  */
+/* if the loop assigns it. Only the tree code       */
+/* generator does this; under -i the register       */
+/* allocator keeps scalar locals and parameters,    */
+/* but not globals or elements                      */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "alias.h"
+#include "scalar.h"
+
+/* an access in a nested loop weighs LOOP_WEIGHT
+ * times more per level, up to MAX_DEPTH levels
+ */
+#define LOOP_WEIGHT 8
+#define MAX_DEPTH 3
+
+/* MIN_WEIGHT pays for the load before the loop */
+#define MIN_WEIGHT 2
+
+/* a value the loop accesses, and one access to it */
+typedef struct
+{
+    KeptValue v;
+    TreeNode *ref;
+} Candidate;
+
+static Candidate *cands;
+static int nCands, maxCands;
+static TreeNode **elems; /* the element accesses of the loop */
+static int nElems, maxElems;
+static int hasCall;
+
+static int loopWeight(int depth)
+{
+    int w = 1;
+    for (; depth > 0 && depth <= MAX_DEPTH; depth--)
+        w *= LOOP_WEIGHT;
+    return w;
+}
+
+/* Function keyOf finds the declaration and element
+ * the IdK or ArrayIdK node t names, and returns
+ * FALSE if a register cannot hold it
+ */
+static int keyOf(TreeNode *t, TreeNode **decl, int *index)
+{
+    TreeNode *d = declOf(t);
+    if (d == NULL || d->nodekind != ExpK)
+        return FALSE;
+    *decl = d;
+    *index = -1;
+    if (t->kind.exp == IdK)
+        return d->kind.exp == VarK || d->kind.exp == SingleParamK;
+    if (t->kind.exp != ArrayIdK || d->kind.exp != VarArrayK || !isConst(t->child[0]) ||
+        t->child[0]->attr.val < 0 || t->child[0]->attr.val >= d->attr.arr.length)
+        return FALSE;
+    *index = t->child[0]->attr.val;
+    return TRUE;
+}
+
+int keptMatch(TreeNode *t, KeptValue *v)
+{
+    TreeNode *d;
+    int index;
+    return keyOf(t, &d, &index) && d == v->decl && index == v->index;
+}
+
+/* Procedure addAccess counts an access of weight w
+ * to the value t names
+ */
+static void addAccess(TreeNode *t, int w, int stored)
+{
+    TreeNode *d;
+    int index, k;
+    if (!keyOf(t, &d, &index))
+        return;
+    for (k = 0; k < nCands; k++)
+        if (keptMatch(t, &cands[k].v))
+            break;
+    if (k == nCands)
+    {
+        if (nCands == maxCands)
+        {
+            maxCands = maxCands ? 2 * maxCands : 16;
+            cands = realloc(cands, maxCands * sizeof(Candidate));
+        }
+        cands[k].v.decl = d;
+        cands[k].v.index = index;
+        cands[k].v.stored = FALSE;
+        cands[k].v.weight = 0;
+        cands[k].ref = t;
+        nCands++;
+    }
+    cands[k].v.weight += w;
+    cands[k].v.stored = cands[k].v.stored || stored;
+}
+
+/* Procedure scan records the accesses and calls of
+ * the code t at loop depth depth
+ */
+static void scan(TreeNode *t, int depth)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == CallK && t->bucket != NULL &&
+            t->bucket->treeNode->child[2] != NULL)
+            hasCall = TRUE;
+        if (t->nodekind == ExpK && t->kind.exp == ArrayIdK)
+        {
+            if (nElems == maxElems)
+            {
+                maxElems = maxElems ? 2 * maxElems : 16;
+                elems = realloc(elems, maxElems * sizeof(TreeNode *));
+            }
+            elems[nElems++] = t;
+        }
+        if (t->nodekind == ExpK && (t->kind.exp == IdK || t->kind.exp == ArrayIdK))
+            addAccess(t, loopWeight(depth), FALSE);
+        if (t->nodekind == ExpK && t->kind.exp == AssignK)
+            addAccess(t->child[0], 0, TRUE);
+        for (i = 0; i < MAXCHILDREN; i++)
+            scan(t->child[i], depth + (t->nodekind == StmtK && t->kind.stmt == WhileK));
+    }
+}
+
+/* Function reachable returns TRUE if an access of
+ * the loop to another element may reach c
+ */
+static int reachable(Candidate *c)
+{
+    int k;
+    for (k = 0; k < nElems; k++)
+        if (!keptMatch(elems[k], &c->v) && mayAlias(elems[k], c->ref))
+            return TRUE;
+    return FALSE;
+}
+
+int keptValues(TreeNode *loop, KeptValue *vals, int max)
+{
+    int k, j, n = 0;
+    nCands = nElems = 0;
+    hasCall = FALSE;
+    scan(loop->child[0], 0);
+    scan(loop->child[1], 0);
+    if (hasCall)
+        return 0;
+    for (k = 0; k < nCands; k++)
+    {
+        if (cands[k].v.weight < MIN_WEIGHT ||
+            (cands[k].v.index >= 0 && reachable(&cands[k])))
+            continue;
+        /* insert by weight, dropping the lightest */
+        for (j = n; j > 0 && vals[j - 1].weight < cands[k].v.weight; j--)
+            if (j < max)
+                vals[j] = vals[j - 1];
+        if (j < max)
+        {
+            vals[j] = cands[k].v;
+            if (n < max)
+                n++;
+        }
+    }
+    return n;
+}
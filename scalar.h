@@ -0,0 +1,34 @@
+/****************************************************/
+/* File: scalar.h                                   */
+/* Scalar replacement in loops                      */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _SCALAR_H_
+#define _SCALAR_H_
+
+/* a value a loop may keep in a register */
+typedef struct
+{
+    TreeNode *decl; /* the scalar, or the array */
+    int index;      /* the element, or -1 for a scalar */
+    int stored;     /* the loop assigns it */
+    int weight;     /* accesses, weighed by the loops they are in */
+} KeptValue;
+
+/* Function keptValues stores in vals, most used
+ * first, the scalars and constant elements of
+ * declared arrays that the WhileK node loop
+ * accesses often enough to keep in registers,
+ * when no call and no other access in the loop
+ * can reach them, and returns their number, at
+ * most max
+ */
+int keptValues(TreeNode *loop, KeptValue *vals, int max);
+
+/* Function keptMatch returns TRUE if the IdK or
+ * ArrayIdK node t refers to the value v
+ */
+int keptMatch(TreeNode *t, KeptValue *v);
+
+#endif
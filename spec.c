@@ -0,0 +1,549 @@
+/****************************************************/
+/* File: spec.c                                     */
+/* Function specialization                          */
+/* for the TINY compiler                            */
+/* A call passing constants to scalar parameters or */
+/* global arrays to array parameters may call a     */
+/* copy of the callee without those parameters: a   */
+/* constant one is replaced by the constant, or by  */
+/* a local set on entry if the callee assigns it,   */
+/* and an array one refers to the global array      */
+/* itself. Calls with the same bindings share one   */
+/* copy                                             */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "code.h"
+#include "clone.h"
+#include "spec.h"
+
+/* a read in a loop weighs LOOP_WEIGHT times more
+ * per level of nesting, up to MAX_DEPTH levels
+ */
+#define LOOP_WEIGHT 8
+#define MAX_DEPTH 3
+
+/* MAX_CODE bounds the estimated program size */
+#define MAX_CODE (IADDR_SIZE / 2)
+
+/* MAX_COPIES bounds the copies of one function */
+#define MAX_COPIES 4
+
+/* MAX_ROUNDS bounds specializing in copies */
+#define MAX_ROUNDS 4
+
+static int nRedirected; /* calls redirected to a copy */
+static int nCopies;     /* copies made */
+static int nRemoved;    /* functions removed */
+static int programSize; /* estimated TM instructions */
+
+/* how a call binds a parameter */
+typedef enum
+{
+    Unbound,
+    ConstBound, /* to the constant val */
+    ArrayBound  /* to the global array */
+} BindKind;
+
+typedef struct
+{
+    BindKind kind;
+    int val;
+    TreeNode *array;
+} ParamBind;
+
+/* a copy of fn for the bindings binds */
+typedef struct SpecRec
+{
+    TreeNode *fn;
+    TreeNode *copy;
+    ParamBind *binds;
+    struct SpecRec *next;
+} * SpecList;
+
+static SpecList specs;
+static TreeNode *program;
+
+static int paramCount(TreeNode *fn)
+{
+    TreeNode *p;
+    int n = 0;
+    for (p = fn->child[1]; p != NULL && p->nodekind == ExpK; p = p->sibling)
+        n++;
+    return n;
+}
+
+static int loopWeight(int depth)
+{
+    int w = 1;
+    for (; depth > 0 && depth <= MAX_DEPTH; depth--)
+        w *= LOOP_WEIGHT;
+    return w;
+}
+
+/* Function calls returns TRUE if the code t calls fn */
+static int calls(TreeNode *t, TreeNode *fn)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (isUserCall(t) && t->bucket->treeNode == fn)
+            return TRUE;
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (calls(t->child[i], fn))
+                return TRUE;
+    }
+    return FALSE;
+}
+
+/* Function passesOn returns TRUE if every call of
+ * fn in the code t passes parameter formal, number
+ * k, on in its own place
+ */
+static int passesOn(TreeNode *t, TreeNode *fn, TreeNode *formal, int k)
+{
+    TreeNode *arg;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (isUserCall(t) && t->bucket->treeNode == fn)
+        {
+            for (arg = t->child[0], i = 0; i < k; i++)
+                arg = arg->sibling;
+            if (arg->kind.exp != IdK || arg->bucket == NULL || arg->bucket->treeNode != formal)
+                return FALSE;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (!passesOn(t->child[i], fn, formal, k))
+                return FALSE;
+    }
+    return TRUE;
+}
+
+/* Function assigns returns TRUE if the code t
+ * assigns the declaration d
+ */
+static int assigns(TreeNode *t, TreeNode *d)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == AssignK && t->child[0]->bucket != NULL &&
+            t->child[0]->bucket->treeNode == d)
+            return TRUE;
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (assigns(t->child[i], d))
+                return TRUE;
+    }
+    return FALSE;
+}
+
+/* Function staysBound returns TRUE if the calls of
+ * fn in its own body pass the parameter formal,
+ * number k, bound by bind on in the copy as well
+ */
+static int staysBound(TreeNode *fn, TreeNode *formal, int k, ParamBind *bind)
+{
+    return passesOn(fn->child[2], fn, formal, k) &&
+           (bind->kind == ArrayBound || !assigns(fn->child[2], formal));
+}
+
+/* Function readWeight returns the reads of the
+ * declaration d in the code t, weighed by the
+ * loops they are in
+ */
+static int readWeight(TreeNode *t, TreeNode *d, int depth)
+{
+    int n = 0, i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && (t->kind.exp == IdK || t->kind.exp == ArrayIdK) &&
+            t->bucket != NULL && t->bucket->treeNode == d)
+            n += loopWeight(depth);
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += readWeight(t->child[i], d,
+                            depth + (t->nodekind == StmtK && t->kind.stmt == WhileK));
+    }
+    return n;
+}
+
+/* Function bindArgs records how the call binds each
+ * parameter and returns the number it binds
+ */
+static int bindArgs(TreeNode *call, ParamBind *binds)
+{
+    TreeNode *formal = call->bucket->treeNode->child[1];
+    TreeNode *arg = call->child[0], *d;
+    int k, n = 0;
+    for (k = 0; arg != NULL; k++, arg = arg->sibling, formal = formal->sibling)
+    {
+        d = arg->kind.exp == IdK && arg->bucket != NULL ? arg->bucket->treeNode : NULL;
+        binds[k].kind = Unbound;
+        binds[k].val = 0;
+        binds[k].array = NULL;
+        if (formal->kind.exp == SingleParamK && arg->kind.exp == ConstK)
+        {
+            binds[k].kind = ConstBound;
+            binds[k].val = arg->attr.val;
+        }
+        else if (formal->kind.exp == ArrayParamK && d != NULL &&
+                 d->kind.exp == VarArrayK && d->scope == globalScope)
+        {
+            binds[k].kind = ArrayBound;
+            binds[k].array = d;
+        }
+        n += binds[k].kind != Unbound;
+    }
+    return n;
+}
+
+static SpecList findSpec(TreeNode *fn, ParamBind *binds)
+{
+    SpecList s;
+    int k, n = paramCount(fn);
+    for (s = specs; s != NULL; s = s->next)
+    {
+        if (s->fn != fn)
+            continue;
+        for (k = 0; k < n; k++)
+            if (s->binds[k].kind != binds[k].kind || s->binds[k].val != binds[k].val ||
+                s->binds[k].array != binds[k].array)
+                break;
+        if (k == n)
+            return s;
+    }
+    return NULL;
+}
+
+static int copiesOf(TreeNode *fn)
+{
+    SpecList s;
+    int n = 0;
+    for (s = specs; s != NULL; s = s->next)
+        n += s->fn == fn;
+    return n;
+}
+
+/**************************************************/
+/*************   copying the callee   *************/
+/**************************************************/
+
+static TreeNode *newAssign(BucketList b, TreeNode *e, int line)
+{
+    TreeNode *t = newExpNode(AssignK), *id = newExpNode(IdK);
+    id->attr.name = b->name;
+    id->bucket = b;
+    id->type = Integer;
+    id->lineno = line;
+    t->child[0] = id;
+    t->child[1] = e;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+/* Procedure substConst replaces the reads of the
+ * symbol b in the code t by the constant val
+ */
+static void substConst(TreeNode *t, BucketList b, int val)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == ExpK && t->kind.exp == IdK && t->bucket == b)
+        {
+            t->kind.exp = ConstK;
+            t->attr.val = val;
+            t->bucket = NULL;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            substConst(t->child[i], b, val);
+    }
+}
+
+/* Function copyFunction returns a copy of fn, named
+ * after it, without the parameters binds binds
+ */
+static TreeNode *copyFunction(TreeNode *fn, BucketList sym, ParamBind *binds)
+{
+    TreeNode *c = allocTree(), *body = newStmtNode(CompoundK);
+    TreeNode *params = NULL, *decls = NULL, *stmts = NULL, *formal, *d;
+    char *name = malloc(strlen(fn->attr.name) + 12);
+    ScopeList sc;
+    int k;
+    sprintf(name, "%s_%d", fn->attr.name, copiesOf(fn) + 1);
+    *c = *fn;
+    c->sibling = NULL;
+    c->attr.name = name;
+    st_declare(globalScope, c)->type = sym->type;
+    c->scope = fn->scope;
+    sc = sc_create(name);
+    cloneReset();
+    /* the parameters kept come first in the frame */
+    formal = fn->child[1];
+    for (k = 0; formal != NULL && formal->nodekind == ExpK; k++, formal = formal->sibling)
+        if (binds[k].kind == Unbound)
+        {
+            d = allocTree();
+            *d = *formal;
+            d->sibling = NULL;
+            st_declare(sc, d);
+            cloneBind(formal->bucket, d->bucket);
+            params = dangleTree(params, d);
+        }
+    formal = fn->child[1];
+    for (k = 0; formal != NULL && formal->nodekind == ExpK; k++, formal = formal->sibling)
+        if (binds[k].kind == ConstBound && !assigns(fn->child[2], formal))
+            continue; /* replaced by the constant below */
+        else if (binds[k].kind == ConstBound)
+        {
+            d = cloneDecl(formal, sc);
+            decls = dangleTree(decls, d);
+            stmts = dangleTree(stmts, newAssign(d->bucket, newConst(binds[k].val, fn->lineno),
+                                                fn->lineno));
+        }
+        else if (binds[k].kind == ArrayBound)
+            cloneBind(formal->bucket, binds[k].array->bucket);
+    for (d = fn->child[2]->child[0]; d != NULL; d = d->sibling)
+        decls = dangleTree(decls, cloneDecl(d, sc));
+    stmts = dangleTree(stmts, cloneTree(fn->child[2]->child[1], sc));
+    formal = fn->child[1];
+    for (k = 0; formal != NULL && formal->nodekind == ExpK; k++, formal = formal->sibling)
+        if (binds[k].kind == ConstBound && !assigns(fn->child[2], formal))
+            substConst(stmts, formal->bucket, binds[k].val);
+    if (params == NULL)
+    {
+        params = newTypeNode(TypeK);
+        params->attr.type = VOID;
+        params->lineno = fn->lineno;
+    }
+    body->scope = sc;
+    body->child[0] = decls;
+    body->child[1] = stmts;
+    body->lineno = fn->child[2]->lineno;
+    c->child[1] = params;
+    c->child[2] = body;
+    return c;
+}
+
+/* Procedure redirect makes call call copy, leaving
+ * out the arguments binds binds
+ */
+static void redirect(TreeNode *call, TreeNode *copy, ParamBind *binds)
+{
+    TreeNode *arg = call->child[0], *next, *args = NULL;
+    int k;
+    for (k = 0; arg != NULL; k++, arg = next)
+    {
+        next = arg->sibling;
+        arg->sibling = NULL;
+        if (binds[k].kind == Unbound)
+            args = dangleTree(args, arg);
+    }
+    call->child[0] = args;
+    call->bucket = copy->bucket;
+    call->attr.name = copy->attr.name;
+    nRedirected++;
+}
+
+/**************************************************/
+/*************   choosing the calls   *************/
+/**************************************************/
+
+/* Function outsideCalls counts the calls of fn
+ * in the code t made by other functions
+ */
+static int outsideCalls(TreeNode *t, TreeNode *fn)
+{
+    int n = 0, i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t == fn)
+            continue;
+        if (isUserCall(t) && t->bucket->treeNode == fn)
+            n++;
+        for (i = 0; i < MAXCHILDREN; i++)
+            n += outsideCalls(t->child[i], fn);
+    }
+    return n;
+}
+
+/* Function gain estimates the TM instructions one
+ * run of the call at loop depth depth saves by
+ * calling a copy with the bindings binds
+ */
+static int gain(TreeNode *call, ParamBind *binds, int depth)
+{
+    TreeNode *fn = call->bucket->treeNode, *formal = fn->child[1];
+    int recursive = calls(fn->child[2], fn);
+    int k, g = 0, r;
+    for (k = 0; formal != NULL && formal->nodekind == ExpK; k++, formal = formal->sibling)
+        if (binds[k].kind != Unbound)
+        {
+            /* the argument store, and a load or the
+             * parameter indirection per read
+             */
+            r = 2 + readWeight(fn->child[2], formal, 0);
+            /* recursive calls run the copy too */
+            if (recursive)
+                r *= LOOP_WEIGHT;
+            g += r;
+        }
+    return g * loopWeight(depth);
+}
+
+/* Function keepRecursive unbinds the parameters
+ * of a recursive fn its own calls do not pass on
+ * bound, so that the copy never calls fn, and
+ * returns the number left bound
+ */
+static int keepRecursive(TreeNode *fn, ParamBind *binds)
+{
+    TreeNode *formal = fn->child[1];
+    int k, n = 0;
+    for (k = 0; formal != NULL && formal->nodekind == ExpK; k++, formal = formal->sibling)
+        if (binds[k].kind != Unbound && !staysBound(fn, formal, k, &binds[k]))
+        {
+            binds[k].kind = Unbound;
+            binds[k].val = 0;
+            binds[k].array = NULL;
+        }
+        else
+            n += binds[k].kind != Unbound;
+    return n;
+}
+
+/* Procedure trySpecialize makes call call a copy
+ * of its callee if it binds parameters and the
+ * copy exists or pays for its size
+ */
+static void trySpecialize(TreeNode *call, int depth)
+{
+    TreeNode *fn = call->bucket->treeNode;
+    ParamBind *binds = malloc((paramCount(fn) + 1) * sizeof(ParamBind));
+    SpecList s;
+    int growth;
+    if (bindArgs(call, binds) == 0 || strcmp(fn->attr.name, "main") == 0 ||
+        (calls(fn->child[2], fn) && keepRecursive(fn, binds) == 0))
+    {
+        free(binds);
+        return;
+    }
+    s = findSpec(fn, binds);
+    if (s != NULL)
+    {
+        redirect(call, s->copy, binds);
+        free(binds);
+        return;
+    }
+    growth = nodeCost(fn);
+    /* the last call from outside takes the function along */
+    if (outsideCalls(program, fn) == 1)
+        growth = 0;
+    if (copiesOf(fn) == MAX_COPIES || growth > gain(call, binds, depth) ||
+        programSize + growth > MAX_CODE)
+    {
+        free(binds);
+        return;
+    }
+    s = (SpecList)malloc(sizeof(struct SpecRec));
+    s->fn = fn;
+    s->binds = binds;
+    s->copy = copyFunction(fn, call->bucket, binds);
+    s->next = specs;
+    specs = s;
+    /* the copy follows the function it copies */
+    s->copy->sibling = fn->sibling;
+    fn->sibling = s->copy;
+    programSize += growth;
+    nCopies++;
+    redirect(call, s->copy, binds);
+}
+
+/* Procedure specializeIn looks for calls to
+ * specialize in the code t at loop depth depth
+ */
+static void specializeIn(TreeNode *t, int depth)
+{
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        for (i = 0; i < MAXCHILDREN; i++)
+            specializeIn(t->child[i], depth + (t->nodekind == StmtK && t->kind.stmt == WhileK));
+        if (isUserCall(t))
+            trySpecialize(t, depth);
+    }
+}
+
+/* Procedure removeUncalled unlinks the functions
+ * and copies the redirected calls left uncalled
+ */
+static void removeUncalled(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    SpecList s;
+    int removed, specialized;
+    do
+    {
+        removed = FALSE;
+        for (t = syntaxTree; t->sibling != NULL;)
+        {
+            specialized = FALSE;
+            for (s = specs; s != NULL; s = s->next)
+                if (s->fn == t->sibling || s->copy == t->sibling)
+                    specialized = TRUE;
+            if (specialized && strcmp(t->sibling->attr.name, "main") != 0 &&
+                outsideCalls(syntaxTree, t->sibling) == 0)
+            {
+                t->sibling = t->sibling->sibling;
+                removed = TRUE;
+                nRemoved++;
+            }
+            else
+                t = t->sibling;
+        }
+    } while (removed);
+}
+
+/* Function specializeCalls makes the calls that
+ * pass constants or global arrays call copies of
+ * their callees with those parameters bound, when
+ * the cost model accepts the copy, removes the
+ * functions left without callers, and returns the
+ * number of calls and functions
+ */
+int specializeCalls(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    SpecList s;
+    int round, before;
+    nRedirected = nCopies = nRemoved = 0;
+    specs = NULL;
+    program = syntaxTree;
+    programSize = codeCost(syntaxTree);
+    for (round = 0; round < MAX_ROUNDS; round++)
+    {
+        before = nRedirected;
+        for (t = syntaxTree; t != NULL; t = t->sibling)
+            if (isFunction(t))
+                specializeIn(t->child[2], 0);
+        if (nRedirected == before)
+            break;
+    }
+    removeUncalled(syntaxTree);
+    while (specs != NULL)
+    {
+        s = specs;
+        specs = s->next;
+        free(s->binds);
+        free(s);
+    }
+    if (TraceAnalyze)
+        fprintf(listing, "\nSpecialization: %d calls redirected to %d copies, "
+                         "%d functions removed\n",
+                nRedirected, nCopies, nRemoved);
+    return nRedirected + nRemoved;
+}
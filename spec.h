@@ -0,0 +1,19 @@
+/****************************************************/
+/* File: spec.h                                     */
+/* Function specialization                          */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _SPEC_H_
+#define _SPEC_H_
+
+/* Function specializeCalls makes the calls that
+ * pass constants or global arrays call copies of
+ * their callees with those parameters bound, when
+ * the cost model accepts the copy, removes the
+ * functions left without callers, and returns the
+ * number of calls and functions
+ */
+int specializeCalls(TreeNode *syntaxTree);
+
+#endif
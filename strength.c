@@ -0,0 +1,358 @@
+/****************************************************/
+/* File: strength.c                                 */
+/* Strength reduction of multiply and divide by     */
+/* constants for the TINY compiler                  */
+/* A multiply by a constant becomes the doublings   */
+/* and adds or subtracts of its signed binary       */
+/* digits, and a divide by 1 or -1 a move or a      */
+/* negation, whenever opCost makes the sequence     */
+/* cheaper than MUL or DIV. The TM has no shifts    */
+/* and no high multiply, so other divides stay.     */
+/* In the remainder idiom a-a/b*b, the second reads */
+/* of a and b reuse the registers of the first      */
+/****************************************************/
+
+#include "globals.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "code.h"
+#include "ir.h"
+#include "strength.h"
+
+static int nMuls;    /* multiplies replaced */
+static int nDivs;    /* divides replaced */
+static int nRems;    /* remainders reading their operands once */
+
+static IrFunc *func;
+static int *defs;         /* definitions of every register */
+static IrInst **defInst;  /* the definition, if only one */
+static IrBlock **defBlock;
+static int *useCount;     /* reads of every register */
+static int *local;        /* TRUE if only read in its block */
+static int *uses, maxUses;
+
+/* Function countDigits stores the digits of u in
+ * signed binary, least significant first, using
+ * -1 digits if nonAdjacent is set
+ */
+static int countDigits(unsigned u, int nonAdjacent, int *digits)
+{
+    int n = 0;
+    while (u != 0)
+    {
+        if ((u & 1) == 0)
+            digits[n] = 0;
+        else if (nonAdjacent && (u & 3) == 3)
+            digits[n] = -1;
+        else
+            digits[n] = 1;
+        /* subtracting a -1 digit adds one */
+        u = (digits[n] < 0 ? u + 1 : u - digits[n]) >> 1;
+        n++;
+    }
+    return n;
+}
+
+/* the adds and subtracts the digits take */
+static int steps(int *digits, int n)
+{
+    int k, s = n - 1;
+    for (k = 0; k < n - 1; k++)
+        s += digits[k] != 0;
+    return s;
+}
+
+int mulDigits(int c, int *digits)
+{
+    int plain[MUL_DIGITS], naf[MUL_DIGITS];
+    unsigned u = c < 0 ? 0u - (unsigned)c : (unsigned)c;
+    int np = countDigits(u, FALSE, plain);
+    int nn = countDigits(u, TRUE, naf);
+    int *best = steps(naf, nn) < steps(plain, np) ? naf : plain;
+    int n = best == naf ? nn : np, k;
+    for (k = 0; k < n; k++)
+        digits[k] = best[n - 1 - k];
+    return n;
+}
+
+static int readsOf(IrInst *i)
+{
+    if (irMaxUses(i) > maxUses)
+    {
+        maxUses = irMaxUses(i);
+        uses = realloc(uses, maxUses * sizeof(int));
+    }
+    return irUses(i, uses);
+}
+
+/* Procedure scan records the definitions and the
+ * reads of every register of func
+ */
+static void scan(void)
+{
+    int size = (func->nRegs > 0 ? func->nRegs : 1);
+    IrBlock *b;
+    IrInst *i;
+    int k, n;
+    defs = realloc(defs, size * sizeof(int));
+    defInst = realloc(defInst, size * sizeof(IrInst *));
+    defBlock = realloc(defBlock, size * sizeof(IrBlock *));
+    useCount = realloc(useCount, size * sizeof(int));
+    local = realloc(local, size * sizeof(int));
+    for (k = 0; k < func->nRegs; k++)
+    {
+        defs[k] = useCount[k] = 0;
+        defInst[k] = NULL;
+        defBlock[k] = NULL;
+        local[k] = TRUE;
+    }
+    for (b = func->entry; b != NULL; b = b->next)
+        for (i = b->first; i != NULL; i = i->next)
+        {
+            n = readsOf(i);
+            for (k = 0; k < n; k++)
+            {
+                useCount[uses[k]]++;
+                if (defBlock[uses[k]] != b)
+                    local[uses[k]] = FALSE;
+            }
+            if (i->dst != NO_REG)
+            {
+                defs[i->dst]++;
+                defInst[i->dst] = i;
+                defBlock[i->dst] = b;
+            }
+        }
+}
+
+/* the single definition of r, if it is in block b */
+static IrInst *defOf(IrBlock *b, int r)
+{
+    return r != NO_REG && defs[r] == 1 && defBlock[r] == b ? defInst[r] : NULL;
+}
+
+/* TRUE if from comes before to in their block */
+static int before(IrInst *from, IrInst *to)
+{
+    for (; from != NULL; from = from->next)
+        if (from == to)
+            return TRUE;
+    return FALSE;
+}
+
+/* Function sameValue returns TRUE if registers r
+ * and s of block b always hold the same value
+ * where the later one is defined
+ */
+static int sameValue(IrBlock *b, int r, int s)
+{
+    IrInst *d = defOf(b, r), *e = defOf(b, s), *i;
+    if (r == s)
+        return TRUE;
+    if (d == NULL || e == NULL || d->op != e->op)
+        return FALSE;
+    if (d->op == IrConst)
+        return d->imm == e->imm;
+    if (d->op != IrLoad || d->sym != e->sym)
+        return FALSE;
+    if (!before(d, e))
+    {
+        i = d;
+        d = e;
+        e = i;
+    }
+    for (i = d->next; i != e; i = i->next)
+        if ((i->op == IrStore && i->sym == d->sym) ||
+            (i->op == IrCall && d->sym->scope == globalScope))
+            return FALSE;
+    return TRUE;
+}
+
+/* Procedure remainder makes a subtract s of the
+ * form a-a/b*b read the a and b of the divide
+ */
+static void remainder(IrBlock *b, IrInst *s)
+{
+    IrInst *m = defOf(b, s->src[1]), *q;
+    int k;
+    if (m == NULL || m->op != IrMul)
+        return;
+    for (k = 0; k < 2; k++)
+    {
+        q = defOf(b, m->src[k]);
+        if (q == NULL || q->op != IrDiv || !sameValue(b, m->src[1 - k], q->src[1]) ||
+            !sameValue(b, s->src[0], q->src[0]) || defOf(b, s->src[0]) == NULL ||
+            !before(defOf(b, s->src[0]), q))
+            continue;
+        if (q->src[0] == s->src[0] && m->src[1 - k] == q->src[1])
+            return;
+        q->src[0] = s->src[0];
+        m->src[1 - k] = q->src[1];
+        nRems++;
+        return;
+    }
+}
+
+static IrInst *emitBefore(IrBlock *b, IrInst *pos, IrOp op, int x, int y)
+{
+    IrInst *i = irNewInst(op);
+    i->dst = irNewReg(func);
+    i->src[0] = x;
+    i->src[1] = y;
+    i->tree = pos->tree;
+    irInsertBefore(b, pos, i);
+    return i;
+}
+
+/* the constant operand of i, or NO_REG */
+static int constOperand(IrBlock *b, IrInst *i, int k)
+{
+    IrInst *d = defOf(b, i->src[k]);
+    return d != NULL && d->op == IrConst && d->imm != 0 ? i->src[k] : NO_REG;
+}
+
+/* Procedure multiply rewrites m = x*c as the
+ * doublings and adds or subtracts of the digits
+ * of c if opCost makes them cheaper
+ */
+static void multiply(IrBlock *b, IrInst *m)
+{
+    int digits[MUL_DIGITS], n, k, c, x, t, cost, reads;
+    int kc = constOperand(b, m, 1) != NO_REG ? 1 : 0;
+    IrOp op;
+    if (constOperand(b, m, kc) == NO_REG)
+        return;
+    c = defInst[m->src[kc]]->imm;
+    x = m->src[1 - kc];
+    n = mulDigits(c, digits);
+    /* the steps, a move for c == 1, and a negation */
+    cost = (n - 1) * opCost("ADD");
+    reads = n > 1 ? 2 : 1;
+    for (k = 1; k < n; k++)
+        if (digits[k] != 0)
+        {
+            cost += opCost(digits[k] > 0 ? "ADD" : "SUB");
+            reads++;
+        }
+    if (c < 0)
+        cost += opCost("LDC") + opCost("SUB");
+    else if (n == 1)
+        cost += opCost("LDA");
+    /* a value kept in the frame is loaded for each read */
+    if (!local[x] || defs[x] != 1 || defBlock[x] != b)
+        cost += (reads - 1) * opCost("LD");
+    if (cost >= opCost("MUL") + (useCount[m->src[kc]] == 1 ? opCost("LDC") : 0))
+        return;
+
+    t = x;
+    for (k = 1; k < n; k++)
+    {
+        t = emitBefore(b, m, IrAdd, t, t)->dst;
+        if (digits[k] != 0)
+            t = emitBefore(b, m, digits[k] > 0 ? IrAdd : IrSub, t, x)->dst;
+    }
+    /* the last step defines the result of m */
+    if (c < 0)
+    {
+        IrInst *z = emitBefore(b, m, IrConst, NO_REG, NO_REG);
+        z->imm = 0;
+        m->op = IrSub;
+        m->src[0] = z->dst;
+        m->src[1] = t;
+    }
+    else if (t == x)
+    {
+        m->op = IrMove;
+        m->src[0] = x;
+        m->src[1] = NO_REG;
+    }
+    else
+    {
+        IrInst *last = m->prev;
+        op = last->op;
+        m->op = op;
+        m->src[0] = last->src[0];
+        m->src[1] = last->src[1];
+        irRemove(b, last);
+        free(last);
+    }
+    nMuls++;
+}
+
+/* Procedure divide rewrites d = x/1 as a move and
+ * d = x/-1 as a negation
+ */
+static void divide(IrBlock *b, IrInst *d)
+{
+    int kc = constOperand(b, d, 1), c, cost;
+    if (kc == NO_REG)
+        return;
+    c = defInst[kc]->imm;
+    if (c != 1 && c != -1)
+        return;
+    cost = c > 0 ? opCost("LDA") : opCost("LDC") + opCost("SUB");
+    if (cost >= opCost("DIV") + (useCount[kc] == 1 ? opCost("LDC") : 0))
+        return;
+    if (c > 0)
+    {
+        d->op = IrMove;
+        d->src[1] = NO_REG;
+    }
+    else
+    {
+        IrInst *z = emitBefore(b, d, IrConst, NO_REG, NO_REG);
+        z->imm = 0;
+        d->op = IrSub;
+        d->src[1] = d->src[0];
+        d->src[0] = z->dst;
+    }
+    nDivs++;
+}
+
+/* Function reduceStrength replaces the multiplies
+ * and divides by constants the cost table makes
+ * dearer than adds and subtracts, and lets the
+ * remainder idiom a-a/b*b read a and b only once,
+ * and returns the number of operations rewritten
+ */
+int reduceStrength(IrFunc *prog)
+{
+    IrBlock *b;
+    IrInst *i, *next;
+    nMuls = nDivs = nRems = 0;
+    for (func = prog; func != NULL; func = func->next)
+    {
+        scan();
+        for (b = func->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = i->next)
+                if (i->op == IrSub)
+                    remainder(b, i);
+        /* the reads the remainders moved */
+        scan();
+        for (b = func->entry; b != NULL; b = b->next)
+            for (i = b->first; i != NULL; i = next)
+            {
+                next = i->next;
+                if (i->op == IrMul)
+                    multiply(b, i);
+                else if (i->op == IrDiv)
+                    divide(b, i);
+            }
+        irSweep(func);
+    }
+    free(defs);
+    free(defInst);
+    free(defBlock);
+    free(useCount);
+    free(local);
+    free(uses);
+    defs = useCount = local = uses = NULL;
+    defInst = NULL;
+    defBlock = NULL;
+    maxUses = 0;
+    if (TraceAnalyze)
+        fprintf(listing, "\nStrength reduction: %d multiplies and %d divides by constants "
+                         "replaced, %d remainders reading their operands once\n",
+                nMuls, nDivs, nRems);
+    return nMuls + nDivs + nRems;
+}
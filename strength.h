@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: strength.h                                 */
+/* Strength reduction of multiply and divide by     */
+/* constants for the TINY compiler                  */
+/****************************************************/
+
+#ifndef _STRENGTH_H_
+#define _STRENGTH_H_
+
+#include "ir.h"
+
+/* MUL_DIGITS is the room mulDigits needs */
+#define MUL_DIGITS 33
+
+/* Function mulDigits stores the signed binary
+ * digits (1, 0 or -1, most significant first) of
+ * the magnitude of the nonzero constant c that
+ * take the fewest adds and subtracts to multiply
+ * by, and returns their number
+ */
+int mulDigits(int c, int *digits);
+
+/* Function reduceStrength replaces the multiplies
+ * and divides by constants the cost table makes
+ * dearer than adds and subtracts, and lets the
+ * remainder idiom a-a/b*b read a and b only once,
+ * and returns the number of operations rewritten
+ */
+int reduceStrength(IrFunc *prog);
+
+#endif
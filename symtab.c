@@ -65,6 +65,23 @@ void sc_push(ScopeList sc) {
     scopeList[nScopeList++] = sc;
 }
 
+/* Function st_size returns the number of
+ * memory words a declaration occupies:
+ * functions live in instruction memory and
+ * an array parameter holds the address and
+ * the length of the actual array
+ */
+int st_size(TreeNode *tree)
+{
+    if (tree->nodekind == StmtK)
+        return 0;
+    if (tree->kind.exp == VarArrayK)
+        return tree->attr.arr.length;
+    if (tree->kind.exp == ArrayParamK)
+        return 2;
+    return 1;
+}
+
 /* Procedure st_insert inserts line numbers and
  * memory locations into the symbol table
  * loc = memory location is inserted only the
@@ -92,7 +109,8 @@ void st_insert(char *scope, char *name, ExpType type, TreeNode *tree)
         l->name = name;
         l->lines = (LineList)malloc(sizeof(struct LineListRec));
         l->lines->lineno = lineno;
-        l->memloc = sc->loc++;
+        l->memloc = sc->loc;
+        sc->loc += st_size(tree);
         l->lines->next = NULL;
         l->next = sc->bucket[h];
         l->treeNode = tree;
@@ -110,6 +128,52 @@ void st_insert(char *scope, char *name, ExpType type, TreeNode *tree)
     }
 } /* st_insert */
 
+/* Function st_declare enters the declaration t
+ * into scope sc at the next free location of sc
+ * and binds t to the new symbol. Passes that
+ * create locals after analysis use it
+ */
+BucketList st_declare(ScopeList sc, TreeNode *t)
+{
+    int h = hash(t->attr.name);
+    BucketList l = (BucketList)malloc(sizeof(struct BucketListRec));
+    l->name = t->attr.name;
+    l->type = t->type;
+    l->lines = (LineList)malloc(sizeof(struct LineListRec));
+    l->lines->lineno = t->lineno;
+    l->lines->next = NULL;
+    l->memloc = sc->loc;
+    sc->loc += st_size(t);
+    l->treeNode = t;
+    l->next = sc->bucket[h];
+    sc->bucket[h] = l;
+    t->scope = sc;
+    t->bucket = l;
+    return l;
+}
+
+/* Procedure sc_shift moves the locals declared in
+ * the blocks of t, and the free locations of those
+ * blocks, up by words, so a block wrapped around t
+ * can declare locals below them
+ */
+void sc_shift(TreeNode *t, int words)
+{
+    TreeNode *d;
+    int i;
+    for (; t != NULL; t = t->sibling)
+    {
+        if (t->nodekind == StmtK && t->kind.stmt == CompoundK && t->scope != NULL)
+        {
+            t->scope->loc += words;
+            for (d = t->child[0]; d != NULL; d = d->sibling)
+                d->bucket->memloc += words;
+        }
+        for (i = 0; i < MAXCHILDREN; i++)
+            sc_shift(t->child[i], words);
+    }
+}
+
 /* Function st_lookup returns the memory 
  * location of a variable or -1 if not found
  */
@@ -53,6 +53,23 @@ typedef struct ScopeListRec
  */
 void st_insert(char *scope, char *name, ExpType type, TreeNode *t);
 
+/* Function st_size returns the number of
+ * memory words a declaration occupies
+ */
+int st_size(TreeNode *t);
+
+/* Function st_declare enters the declaration t
+ * into scope sc at the next free location of sc
+ * and binds t to the new symbol
+ */
+BucketList st_declare(ScopeList sc, TreeNode *t);
+
+/* Procedure sc_shift moves the locals declared in
+ * the blocks of t, and the free locations of those
+ * blocks, up by words
+ */
+void sc_shift(TreeNode *t, int words);
+
 ScopeList sc_create(char *name);
 ScopeList sc_top();
 void sc_pop();
@@ -21,6 +21,8 @@
 #define IADDR_SIZE 1024 /* increase for large programs */
 #define DADDR_SIZE 1024 /* increase for large programs */
 #define NO_REGS 8
+#define NO_VREGS 4 /* vector registers */
+#define VLEN 4     /* words in a vector register */
 #define PC_REG 7
 
 #define LINESIZE 121
@@ -45,11 +47,23 @@ typedef enum
     opSUB,   /* RR     reg(r) = reg(s)-reg(t) */
     opMUL,   /* RR     reg(r) = reg(s)*reg(t) */
     opDIV,   /* RR     reg(r) = reg(s)/reg(t) */
+    opMOV,   /* RR     move reg(t) words from mem(reg(s)) to mem(reg(r)) */
+    opFIL,   /* RR     fill reg(t) words from mem(reg(r)) with reg(s) */
+    opVADD,  /* RR     vreg(r) = vreg(s)+vreg(t) */
+    opVSUB,  /* RR     vreg(r) = vreg(s)-vreg(t) */
+    opVMUL,  /* RR     vreg(r) = vreg(s)*vreg(t) */
+    opVLT,   /* RR     vreg(r) = 1 where vreg(s)<vreg(t), else 0 */
+    opVLE,   /* RR     vreg(r) = 1 where vreg(s)<=vreg(t), else 0 */
+    opVEQ,   /* RR     vreg(r) = 1 where vreg(s)==vreg(t), else 0 */
+    opVNE,   /* RR     vreg(r) = 1 where vreg(s)!=vreg(t), else 0 */
+    opVSPL,  /* RR     every word of vreg(r) = reg(s), t is ignored */
     opRRLim, /* limit of RR opcodes */
 
     /* RM instructions */
     opLD,    /* RM     reg(r) = mem(d+reg(s)) */
     opST,    /* RM     mem(d+reg(s)) = reg(r) */
+    opVLD,   /* RM     vreg(r) = the VLEN words from mem(d+reg(s)) */
+    opVST,   /* RM     the VLEN words from mem(d+reg(s)) = vreg(r) */
     opRMLim, /* Limit of RM opcodes */
 
     /* RA instructions */
@@ -86,25 +100,57 @@ int iloc = 0;
 int dloc = 0;
 int traceflag = FALSE;
 int icountflag = FALSE;
+int cyclecountflag = FALSE;
 
 INSTRUCTION iMem[IADDR_SIZE];
 int dMem[DADDR_SIZE];
 int reg[NO_REGS];
+int vreg[NO_VREGS][VLEN];
 
 char *opCodeTab[] = {
-    "HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV", "????",
+    "HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV", "MOV", "FIL",
+    "VADD", "VSUB", "VMUL", "VLT", "VLE", "VEQ", "VNE", "VSPL", "????",
     /* RR opcodes */
-    "LD", "ST", "????", /* RM opcodes */
+    "LD", "ST", "VLD", "VST", "????", /* RM opcodes */
     "LDA", "LDC", "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE", "????"
     /* RA opcodes */
 };
 
+/* cycles charged for each opcode, in the order
+ * of opCodeTab; the compiler's cost table (opCost
+ * in code.c) uses the same numbers
+ */
+int opCycles[] = {
+    1, 1, 1, 1, 1, 4, 12, 2, 2,
+    1, 1, 4, 1, 1, 1, 1, 1, 0,
+    /* RR opcodes */
+    2, 2, 2, 2, 0, /* RM opcodes */
+    1, 1, 1, 1, 1, 1, 1, 1, 0
+    /* RA opcodes */
+};
+
+/* MOV and FIL are also charged WORD_CYCLES for
+ * each word they write, which stepTM adds to
+ * blockCycles
+ */
+#define WORD_CYCLES 1
+long blockCycles = 0;
+
 char *stepResultTab[] = {"OK", "Halted", "Instruction Memory Fault",
                          "Data Memory Fault", "Division by 0"};
 
 char pgmName[20];
 FILE *pgm;
 
+/* with the f command on, each go counts the runs
+ * of every instruction, and the runs on which it
+ * jumped, into the file profName for the compiler
+ */
+int profileflag = FALSE;
+long execCount[IADDR_SIZE];
+long takenCount[IADDR_SIZE];
+char profName[30];
+
 char in_Line[LINESIZE];
 int lineLen;
 int inCol;
@@ -113,6 +159,12 @@ char word[WORDSIZE];
 char ch;
 int done;
 
+/********************************************/
+int isVectorOp(int c)
+{
+    return (c >= opVADD && c <= opVSPL) || c == opVLD || c == opVST;
+} /* isVectorOp */
+
 /********************************************/
 int opClass(int c)
 {
@@ -256,6 +308,7 @@ int readInstructions(void)
     int loc, regNo, lineNo;
     for (regNo = 0; regNo < NO_REGS; regNo++)
         reg[regNo] = 0;
+    memset(vreg, 0, sizeof(vreg));
     dMem[0] = DADDR_SIZE - 1;
     for (loc = 1; loc < DADDR_SIZE; loc++)
         dMem[loc] = 0;
@@ -330,6 +383,10 @@ int readInstructions(void)
                 arg3 = num;
                 break;
             }
+            if (isVectorOp(op) && (arg1 >= NO_VREGS ||
+                                   (opClass(op) == opclRR && op != opVSPL &&
+                                    (arg2 >= NO_VREGS || arg3 >= NO_VREGS))))
+                return error("Bad vector register", lineNo, loc);
             iMem[loc].iop = op;
             iMem[loc].iarg1 = arg1;
             iMem[loc].iarg2 = arg2;
@@ -344,7 +401,7 @@ STEPRESULT stepTM(void)
 {
     INSTRUCTION currentinstruction;
     int pc;
-    int r, s, t, m;
+    int r, s, t, m, k;
     int ok;
 
     pc = reg[PC_REG];
@@ -425,6 +482,65 @@ STEPRESULT stepTM(void)
             return srZERODIVIDE;
         break;
 
+    case opMOV:
+        /***********************************/
+        if (reg[t] <= 0)
+            break;
+        if (reg[r] < 0 || reg[s] < 0 || reg[r] > DADDR_SIZE - reg[t] ||
+            reg[s] > DADDR_SIZE - reg[t])
+            return srDMEM_ERR;
+        memmove(&dMem[reg[r]], &dMem[reg[s]], reg[t] * sizeof(int));
+        blockCycles += (long)reg[t] * WORD_CYCLES;
+        break;
+
+    case opFIL:
+        /***********************************/
+        if (reg[t] <= 0)
+            break;
+        if (reg[r] < 0 || reg[r] > DADDR_SIZE - reg[t])
+            return srDMEM_ERR;
+        for (m = 0; m < reg[t]; m++)
+            dMem[reg[r] + m] = reg[s];
+        blockCycles += (long)reg[t] * WORD_CYCLES;
+        break;
+
+    /* the vector instructions loop over VLEN words,
+     * which the host compiler turns into its own
+     * SIMD instructions
+     */
+    case opVADD:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] + vreg[t][k];
+        break;
+    case opVSUB:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] - vreg[t][k];
+        break;
+    case opVMUL:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] * vreg[t][k];
+        break;
+    case opVLT:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] < vreg[t][k];
+        break;
+    case opVLE:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] <= vreg[t][k];
+        break;
+    case opVEQ:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] == vreg[t][k];
+        break;
+    case opVNE:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = vreg[s][k] != vreg[t][k];
+        break;
+    case opVSPL:
+        for (k = 0; k < VLEN; k++)
+            vreg[r][k] = reg[s];
+        break;
+
     /*************** RM instructions ********************/
     case opLD:
         reg[r] = dMem[m];
@@ -432,6 +548,16 @@ STEPRESULT stepTM(void)
     case opST:
         dMem[m] = reg[r];
         break;
+    case opVLD:
+        if (m > DADDR_SIZE - VLEN)
+            return srDMEM_ERR;
+        memcpy(vreg[r], &dMem[m], sizeof(vreg[r]));
+        break;
+    case opVST:
+        if (m > DADDR_SIZE - VLEN)
+            return srDMEM_ERR;
+        memcpy(&dMem[m], vreg[r], sizeof(vreg[r]));
+        break;
 
     /*************** RA instructions ********************/
     case opLDA:
@@ -470,11 +596,53 @@ STEPRESULT stepTM(void)
     return srOKAY;
 } /* stepTM */
 
+/********************************************/
+/* Procedure readProfile adds the counts of the
+ * earlier runs in profName, if any, so that the
+ * profile covers every run
+ */
+void readProfile(void)
+{
+    FILE *f;
+    int loc;
+    long runs, taken;
+    for (loc = 0; loc < IADDR_SIZE; loc++)
+        execCount[loc] = takenCount[loc] = 0;
+    f = fopen(profName, "r");
+    if (f == NULL)
+        return;
+    while (fscanf(f, "%d %ld %ld", &loc, &runs, &taken) == 3)
+        if ((loc >= 0) && (loc < IADDR_SIZE))
+        {
+            execCount[loc] += runs;
+            takenCount[loc] += taken;
+        }
+    fclose(f);
+}
+
+/********************************************/
+void writeProfile(void)
+{
+    FILE *f;
+    int loc;
+    f = fopen(profName, "w");
+    if (f == NULL)
+    {
+        printf("Unable to write %s\n", profName);
+        return;
+    }
+    for (loc = 0; loc < IADDR_SIZE; loc++)
+        if (execCount[loc] > 0)
+            fprintf(f, "%d %ld %ld\n", loc, execCount[loc], takenCount[loc]);
+    fclose(f);
+}
+
 /********************************************/
 int doCommand(void)
 {
     char cmd;
     int stepcnt = 0, i;
+    long cyclecnt;
     int printcnt;
     int stepResult;
     int regNo, loc;
@@ -519,6 +687,12 @@ int doCommand(void)
         printf("   p(rint         "
                "Toggle print of total instructions executed"
                " ('go' only)\n");
+        printf("   e(lapsed       "
+               "Toggle print of total cycles executed"
+               " ('go' only)\n");
+        printf("   f(requencies   "
+               "Toggle profile of instruction counts"
+               " ('go' only)\n");
         printf("   c(lear         "
                "Reset simulator for new execution of program\n");
         printf("   h(elp          "
@@ -537,6 +711,29 @@ int doCommand(void)
             printf("off.\n");
         break;
 
+    case 'e':
+        /***********************************/
+        cyclecountflag = !cyclecountflag;
+        printf("Printing cycle count now ");
+        if (cyclecountflag)
+            printf("on.\n");
+        else
+            printf("off.\n");
+        break;
+
+    case 'f':
+        /***********************************/
+        profileflag = !profileflag;
+        printf("Profiling into %s now ", profName);
+        if (profileflag)
+        {
+            readProfile();
+            printf("on.\n");
+        }
+        else
+            printf("off.\n");
+        break;
+
     case 's':
         /***********************************/
         if (atEOL())
@@ -610,8 +807,10 @@ int doCommand(void)
         iloc = 0;
         dloc = 0;
         stepcnt = 0;
+        blockCycles = 0;
         for (regNo = 0; regNo < NO_REGS; regNo++)
             reg[regNo] = 0;
+        memset(vreg, 0, sizeof(vreg));
         dMem[0] = DADDR_SIZE - 1;
         for (loc = 1; loc < DADDR_SIZE; loc++)
             dMem[loc] = 0;
@@ -630,16 +829,32 @@ int doCommand(void)
         if (cmd == 'g')
         {
             stepcnt = 0;
+            cyclecnt = 0;
+            blockCycles = 0;
             while (stepResult == srOKAY)
             {
                 iloc = reg[PC_REG];
                 if (traceflag)
                     writeInstruction(iloc);
+                if ((iloc >= 0) && (iloc < IADDR_SIZE))
+                    cyclecnt += opCycles[iMem[iloc].iop];
                 stepResult = stepTM();
                 stepcnt++;
+                if (profileflag && (iloc >= 0) && (iloc < IADDR_SIZE))
+                {
+                    execCount[iloc]++;
+                    if (reg[PC_REG] != iloc + 1)
+                        takenCount[iloc]++;
+                }
             }
+            if (profileflag)
+                writeProfile();
+            cyclecnt += blockCycles;
+            blockCycles = 0;
             if (icountflag)
                 printf("Number of instructions executed = %d\n", stepcnt);
+            if (cyclecountflag)
+                printf("Number of cycles executed = %ld\n", cyclecnt);
         }
         else
         {
@@ -671,6 +886,8 @@ int main(int argc, char *argv[])
     strcpy(pgmName, argv[1]);
     if (strchr(pgmName, '.') == NULL)
         strcat(pgmName, ".tm");
+    strncpy(profName, pgmName, strcspn(pgmName, "."));
+    strcat(profName, ".prof");
     pgm = fopen(pgmName, "r");
     if (pgm == NULL)
     {
@@ -0,0 +1,287 @@
+/****************************************************/
+/* File: unroll.c                                   */
+/* Loop unrolling                                   */
+/* for the TINY compiler                            */
+/* A counted loop                                   */
+/*     while (i < n) { ...; i = i + c; }            */
+/* is unrolled by k into                            */
+/*     while (i < n - (k-1)*c) { body ... body }    */
+/*     while (i < n) { ...; i = i + c; }            */
+/* where the second loop runs the remaining trips.  */
+/* As in C, the bound is assumed not to overflow    */
+/****************************************************/
+
+#include <limits.h>
+#include "globals.h"
+#include "util.h"
+#include "symtab.h"
+#include "analyze.h"
+#include "alias.h"
+#include "code.h"
+#include "clone.h"
+#include "idiom.h"
+#include "vector.h"
+#include "profile.h"
+#include "unroll.h"
+
+/* a loop of at most FULL_TRIPS trips whose body
+ * costs at most FULL_COST over all of them is
+ * unrolled fully
+ */
+#define FULL_TRIPS 16
+#define FULL_COST 96
+
+/* partial unrolling copies bodies of at most
+ * MAX_BODY estimated TM instructions
+ */
+#define MAX_BODY 48
+
+/* MAX_CODE bounds the estimated program size */
+#define MAX_CODE (IADDR_SIZE / 2)
+
+static int nFull;       /* loops unrolled fully */
+static int nPartial;    /* loops unrolled by UnrollFactor */
+static int programSize; /* estimated TM instructions */
+static int partial;     /* FALSE while only full unrolling is tried */
+
+/* the counted loop being examined */
+static TreeNode *var;   /* declaration of the induction variable */
+static TreeNode *bound; /* what var is compared with */
+static int step;        /* added to var at the end of each trip */
+
+/* Function countedLoop returns TRUE if w compares
+ * a local scalar with an invariant bound and only
+ * steps it by a constant at the end of its body,
+ * setting var, bound and step
+ */
+static int countedLoop(TreeNode *w)
+{
+    TreeNode *test = w->child[0], *last = w->child[1], *rhs;
+    if (test->nodekind != ExpK || test->kind.exp != OpK ||
+        test->child[0]->kind.exp != IdK)
+        return FALSE;
+    var = declOf(test->child[0]);
+    bound = test->child[1];
+    if (!isScalar(var) || var->scope == globalScope)
+        return FALSE;
+    if (last->nodekind == StmtK && last->kind.stmt == CompoundK)
+        for (last = last->child[1]; last != NULL && last->sibling != NULL;)
+            last = last->sibling;
+    if (last == NULL || last->nodekind != ExpK || last->kind.exp != AssignK ||
+        !isVar(last->child[0], var) || last->child[1]->kind.exp != OpK)
+        return FALSE;
+    rhs = last->child[1];
+    if (isVar(rhs->child[0], var) && isConst(rhs->child[1]) &&
+        (rhs->attr.op == PLUS || rhs->attr.op == MINUS))
+        step = rhs->attr.op == PLUS ? rhs->child[1]->attr.val : -rhs->child[1]->attr.val;
+    else if (isConst(rhs->child[0]) && isVar(rhs->child[1], var) && rhs->attr.op == PLUS)
+        step = rhs->child[0]->attr.val;
+    else
+        return FALSE;
+    switch (test->attr.op)
+    {
+    case LT:
+    case LE:
+        if (step <= 0)
+            return FALSE;
+        break;
+    case GT:
+    case GE:
+        if (step >= 0)
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+    return assignCount(w->child[1], var) == 1 && isInvariant(bound, w->child[1]);
+}
+
+/* Function tripCount returns the trips of the
+ * counted loop w entered with var equal to init
+ */
+static long long tripCount(TreeNode *w, long long init)
+{
+    long long b = bound->attr.val, s = step;
+    switch (w->child[0]->attr.op)
+    {
+    case LT:
+        return init < b ? (b - init + s - 1) / s : 0;
+    case LE:
+        return init <= b ? (b - init) / s + 1 : 0;
+    case GT:
+        return init > b ? (init - b - s - 1) / -s : 0;
+    default: /* GE */
+        return init >= b ? (init - b) / -s + 1 : 0;
+    }
+}
+
+/* a block without a scope of its own */
+static TreeNode *newBlock(TreeNode *stmts, int line)
+{
+    TreeNode *t = newStmtNode(CompoundK);
+    t->child[1] = stmts;
+    t->lineno = line;
+    return t;
+}
+
+/* Function copies returns n copies of the body of
+ * loop w for scope sc
+ */
+static TreeNode *copies(TreeNode *w, int n, ScopeList sc)
+{
+    TreeNode *list = NULL;
+    cloneReset();
+    while (n-- > 0)
+        list = dangleTree(list, cloneTree(w->child[1], sc));
+    return list;
+}
+
+/* Procedure unrollFully replaces w by its body
+ * repeated trips times
+ */
+static void unrollFully(TreeNode *w, int trips, ScopeList sc)
+{
+    TreeNode *body = copies(w, trips, sc);
+    w->kind.stmt = CompoundK;
+    w->child[0] = w->child[2] = NULL;
+    w->child[1] = body;
+    w->scope = NULL;
+    nFull++;
+}
+
+/* Procedure unrollBy runs k trips of w per test,
+ * leaving w for the remaining trips
+ */
+static void unrollBy(TreeNode *w, int k, ScopeList sc)
+{
+    TreeNode *rest = allocTree(), *loop, *test;
+    long long offset = (long long)(k - 1) * step;
+    *rest = *w;
+    rest->sibling = NULL;
+    test = allocTree();
+    *test = *w->child[0];
+    cloneReset();
+    test->child[0] = cloneTree(w->child[0]->child[0], sc);
+    if (isConst(bound))
+        test->child[1] = newConst((int)(bound->attr.val - offset), w->lineno);
+    else
+    {
+        test->child[1] = newExpNode(OpK);
+        test->child[1]->attr.op = MINUS;
+        test->child[1]->type = Integer;
+        test->child[1]->child[0] = cloneTree(bound, sc);
+        test->child[1]->child[1] = newConst((int)offset, w->lineno);
+    }
+    loop = newStmtNode(WhileK);
+    loop->lineno = w->lineno;
+    loop->child[0] = test;
+    loop->child[1] = newBlock(copies(w, k, sc), w->lineno);
+    w->kind.stmt = CompoundK;
+    w->child[0] = w->child[2] = NULL;
+    w->child[1] = dangleTree(loop, rest);
+    w->scope = NULL;
+    nPartial++;
+}
+
+/* Procedure unrollLoop unrolls the loop w, whose
+ * locals live in scope sc, if it is counted and
+ * the copies fit. prev is the statement before w.
+ * A profile keeps loops the training runs never
+ * reached, or that ran fewer than UnrollFactor
+ * trips per entry, from growing
+ */
+static void unrollLoop(TreeNode *w, TreeNode *prev, ScopeList sc)
+{
+    BlockLoop block;
+    VectorLoop vector;
+    NodeProfile *prof = nodeProfile(w);
+    int cost, growth;
+    long long trips = -1, offset;
+    /* the tree code generator runs these a block or vector at a time */
+    if (!countedLoop(w) ||
+        (!GenIR && (blockLoop(w, &block) || (!OptimizeSize && vectorLoop(w, &vector)))))
+        return;
+    if (prof != NULL && prof->entries == 0)
+        return;
+    cost = codeCost(w->child[1]);
+    if (isConst(bound) && prev != NULL && prev->nodekind == ExpK &&
+        prev->kind.exp == AssignK && isVar(prev->child[0], var) &&
+        isConst(prev->child[1]))
+        trips = tripCount(w, prev->child[1]->attr.val);
+    if (trips >= 0 && trips <= FULL_TRIPS && trips * cost <= FULL_COST)
+    {
+        growth = (int)trips * cost - nodeCost(w);
+        if (programSize + growth <= MAX_CODE)
+        {
+            unrollFully(w, (int)trips, sc);
+            programSize += growth;
+            return;
+        }
+    }
+    if (!partial || UnrollFactor < 2 || (trips >= 0 && trips < UnrollFactor) || cost > MAX_BODY)
+        return;
+    if (prof != NULL && prof->trips < (long)UnrollFactor * prof->entries)
+        return;
+    offset = (long long)(UnrollFactor - 1) * step;
+    if (isConst(bound))
+        offset = bound->attr.val - offset;
+    if (offset < INT_MIN || offset > INT_MAX)
+        return;
+    growth = UnrollFactor * cost + codeCost(w->child[0]) + 2;
+    if (programSize + growth > MAX_CODE)
+        return;
+    unrollBy(w, UnrollFactor, sc);
+    programSize += growth;
+}
+
+/* Procedure unrollStmt unrolls the loops of t,
+ * innermost first. prev is the statement before t
+ */
+static void unrollStmt(TreeNode *t, TreeNode *prev, ScopeList scope)
+{
+    TreeNode *s;
+    if (t == NULL || t->nodekind != StmtK)
+        return;
+    switch (t->kind.stmt)
+    {
+    case CompoundK:
+        if (t->scope != NULL)
+            scope = t->scope;
+        for (prev = NULL, s = t->child[1]; s != NULL; prev = s, s = s->sibling)
+            unrollStmt(s, prev, scope);
+        break;
+    case IfK:
+        unrollStmt(t->child[1], NULL, scope);
+        unrollStmt(t->child[2], NULL, scope);
+        break;
+    case WhileK:
+        unrollStmt(t->child[1], NULL, scope);
+        unrollLoop(t, prev, scope);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Function unrollLoops unrolls counted while
+ * loops fully when their trip count is a small
+ * constant, and otherwise by UnrollFactor with a
+ * loop for the remaining trips, and returns the
+ * number of loops unrolled
+ */
+int unrollLoops(TreeNode *syntaxTree)
+{
+    TreeNode *t;
+    nFull = nPartial = 0;
+    programSize = codeCost(syntaxTree);
+    /* full unrolling gains the most, so it gets the space first */
+    for (partial = FALSE; partial <= TRUE; partial++)
+        for (t = syntaxTree; t != NULL; t = t->sibling)
+            if (t->nodekind == StmtK && t->kind.stmt == FunctionK && t->child[2] != NULL)
+                unrollStmt(t->child[2], NULL, t->child[2]->scope);
+    if (TraceAnalyze)
+        fprintf(listing, "\nLoop unrolling: %d loops unrolled fully, "
+                         "%d by %d\n",
+                nFull, nPartial, UnrollFactor);
+    return nFull + nPartial;
+}
@@ -0,0 +1,18 @@
+/****************************************************/
+/* File: unroll.h                                   */
+/* Loop unrolling                                   */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _UNROLL_H_
+#define _UNROLL_H_
+
+/* Function unrollLoops unrolls counted while
+ * loops fully when their trip count is a small
+ * constant, and otherwise by UnrollFactor with a
+ * loop for the remaining trips, and returns the
+ * number of loops unrolled
+ */
+int unrollLoops(TreeNode *syntaxTree);
+
+#endif
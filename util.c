@@ -7,6 +7,7 @@
 /****************************************************/
 
 #include "globals.h"
+#include "symtab.h"
 #include "util.h"
 
 /* Procedure printToken prints a token 
@@ -114,6 +115,9 @@ TreeNode *allocTree(void)
             t->child[i] = NULL;
         t->sibling = NULL;
         t->lineno = lineno;
+        t->scope = NULL;
+        t->bucket = NULL;
+        t->id = 0;
     }
     return t;
 }
@@ -192,6 +196,95 @@ char *copyString(char *s)
     return t;
 }
 
+/* Function isPureExp returns TRUE if evaluating
+ * the expression t can neither assign a variable
+ * nor call a function
+ */
+int isPureExp(TreeNode *t)
+{
+    int i;
+    if (t == NULL)
+        return TRUE;
+    if (t->nodekind == ExpK &&
+        (t->kind.exp == AssignK || t->kind.exp == CallK))
+        return FALSE;
+    for (i = 0; i < MAXCHILDREN; i++)
+        if (!isPureExp(t->child[i]))
+            return FALSE;
+    return TRUE;
+}
+
+/* Procedure replaceNode overwrites node t with
+ * node s, keeping t in its sibling list
+ */
+void replaceNode(TreeNode *t, TreeNode *s)
+{
+    TreeNode *sibling = t->sibling;
+    *t = *s;
+    t->sibling = sibling;
+}
+
+/* Function isConst returns TRUE if t is a
+ * constant
+ */
+int isConst(TreeNode *t)
+{
+    return t != NULL && t->nodekind == ExpK && t->kind.exp == ConstK;
+}
+
+/* Function isScalar returns TRUE if d declares a
+ * scalar variable or parameter
+ */
+int isScalar(TreeNode *d)
+{
+    return d != NULL && d->nodekind == ExpK &&
+           (d->kind.exp == VarK || d->kind.exp == SingleParamK);
+}
+
+/* Function isFunction returns TRUE if t declares
+ * a function with a body
+ */
+int isFunction(TreeNode *t)
+{
+    return t->nodekind == StmtK && t->kind.stmt == FunctionK &&
+           t->child[2] != NULL;
+}
+
+/* Function isUserCall returns TRUE if t calls a
+ * function of the program, not input or output
+ */
+int isUserCall(TreeNode *t)
+{
+    return t->nodekind == ExpK && t->kind.exp == CallK &&
+           t->bucket != NULL && isFunction(t->bucket->treeNode);
+}
+
+/* Function newConst creates an integer constant
+ * node of value val at line line
+ */
+TreeNode *newConst(int val, int line)
+{
+    TreeNode *t = newExpNode(ConstK);
+    t->attr.val = val;
+    t->type = Integer;
+    t->lineno = line;
+    return t;
+}
+
+/* Function newOp creates the integer operation
+ * a op b, at the line of a
+ */
+TreeNode *newOp(TokenType op, TreeNode *a, TreeNode *b)
+{
+    TreeNode *t = newExpNode(OpK);
+    t->attr.op = op;
+    t->child[0] = a;
+    t->child[1] = b;
+    t->type = Integer;
+    t->lineno = a->lineno;
+    return t;
+}
+
 /* Variable indentno is used by printTree to
  * store current number of spaces to indent
  */
@@ -34,6 +34,47 @@ TreeNode *newTypeNode(TypeKind);
  */
 char *copyString(char *);
 
+/* Function isPureExp returns TRUE if evaluating
+ * the expression t can neither assign a variable
+ * nor call a function
+ */
+int isPureExp(TreeNode *t);
+
+/* Procedure replaceNode overwrites node t with
+ * node s, keeping t in its sibling list
+ */
+void replaceNode(TreeNode *t, TreeNode *s);
+
+/* Function isConst returns TRUE if t is a
+ * constant
+ */
+int isConst(TreeNode *t);
+
+/* Function isScalar returns TRUE if d declares a
+ * scalar variable or parameter
+ */
+int isScalar(TreeNode *d);
+
+/* Function isFunction returns TRUE if t declares
+ * a function with a body
+ */
+int isFunction(TreeNode *t);
+
+/* Function isUserCall returns TRUE if t calls a
+ * function of the program, not input or output
+ */
+int isUserCall(TreeNode *t);
+
+/* Function newConst creates an integer constant
+ * node of value val at line line
+ */
+TreeNode *newConst(int val, int line);
+
+/* Function newOp creates the integer operation
+ * a op b, at the line of a
+ */
+TreeNode *newOp(TokenType op, TreeNode *a, TreeNode *b);
+
 /* procedure printTree prints a syntax tree to the 
  * listing file using indentation to indicate subtrees
  */
@@ -0,0 +1,161 @@
+/****************************************************/
+/* File: vector.c                                   */
+/* Vectorization of element-wise array loops        */
+/* for the TINY compiler                            */
+/* A loop                                           */
+/*     while (i < n) { a[i + c] = e; ...; ++i; }    */
+/* whose elements are all at i plus a constant can  */
+/* run VECTOR_LENGTH trips at once while            */
+/*     i + VECTOR_LENGTH - 1 < n                    */
+/* holds, leaving the rest to the loop itself, if   */
+/* no trip reads or writes an element another trip  */
+/* writes: every access to a written array is at    */
+/* the offset of the write, and no other array may  */
+/* share its storage. The IR back end has no vector */
+/* instructions, so under -i such a loop is only    */
+/* unrolled at -O2                                  */
+/****************************************************/
+
+#include "globals.h"
+#include "util.h"
+#include "alias.h"
+#include "code.h"
+#include "vector.h"
+
+/* the element accesses of the loop */
+typedef struct
+{
+    TreeNode *decl;
+    int offset;
+    int write;
+} Access;
+
+#define MAX_ACCESSES 32
+
+static Access accesses[MAX_ACCESSES];
+static int nAccesses;
+
+/* Function invariant returns TRUE if the
+ * expression t reads only constants and scalars
+ * other than the counter var
+ */
+static int invariant(TreeNode *t, TreeNode *var)
+{
+    if (t->nodekind != ExpK)
+        return FALSE;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return TRUE;
+    case IdK:
+        return isScalar(declOf(t)) && declOf(t) != var;
+    case OpK:
+        return invariant(t->child[0], var) && invariant(t->child[1], var);
+    default:
+        return FALSE;
+    }
+}
+
+/* Function addAccess records the access t to an
+ * element at var plus a constant and returns
+ * FALSE if it is not one
+ */
+static int addAccess(TreeNode *t, TreeNode *var, int write)
+{
+    TreeNode *d = declOf(t);
+    int offset;
+    if (d == NULL || (d->kind.exp != VarArrayK && d->kind.exp != ArrayParamK) ||
+        nAccesses == MAX_ACCESSES || !offsetOf(t->child[0], var, &offset))
+        return FALSE;
+    accesses[nAccesses].decl = d;
+    accesses[nAccesses].offset = offset;
+    accesses[nAccesses].write = write;
+    nAccesses++;
+    return TRUE;
+}
+
+/* Function need returns the vector registers the
+ * expression t takes, its left operand first, or
+ * 0 if it cannot run on vectors
+ */
+static int need(TreeNode *t, TreeNode *var)
+{
+    int left, right;
+    if (t->nodekind != ExpK)
+        return 0;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return 1;
+    case IdK:
+        return invariant(t, var) ? 1 : 0;
+    case ArrayIdK:
+        return addAccess(t, var, FALSE) ? 1 : 0;
+    case OpK:
+        if (t->attr.op == OVER)
+            return 0;
+        left = need(t->child[0], var);
+        right = need(t->child[1], var);
+        if (left == 0 || right == 0)
+            return 0;
+        return left > right ? left : right + 1;
+    default:
+        return 0;
+    }
+}
+
+/* Function independent returns TRUE if no trip
+ * touches an element another trip writes
+ */
+static int independent(void)
+{
+    int j, k;
+    for (j = 0; j < nAccesses; j++)
+        for (k = 0; k < nAccesses; k++)
+            if (accesses[j].write && k != j &&
+                (accesses[j].decl == accesses[k].decl
+                     ? accesses[j].offset != accesses[k].offset
+                     : mayShare(accesses[j].decl, accesses[k].decl)))
+                return FALSE;
+    return TRUE;
+}
+
+int vectorLoop(TreeNode *loop, VectorLoop *v)
+{
+    TreeNode *test = loop->child[0], *body = loop->child[1];
+    TreeNode *var, *s, *rhs;
+    int n, regs;
+    if (test->nodekind != ExpK || test->kind.exp != OpK ||
+        (test->attr.op != LT && test->attr.op != LE) ||
+        test->child[0]->kind.exp != IdK || !isScalar(var = declOf(test->child[0])) ||
+        !invariant(test->child[1], var))
+        return FALSE;
+    if (body->nodekind != StmtK || body->kind.stmt != CompoundK || body->child[0] != NULL ||
+        body->child[1] == NULL)
+        return FALSE;
+    nAccesses = 0;
+    for (n = 0, s = body->child[1]; s->sibling != NULL; s = s->sibling, n++)
+        if (s->nodekind != ExpK || s->kind.exp != AssignK ||
+            s->child[0]->kind.exp != ArrayIdK || !addAccess(s->child[0], var, TRUE) ||
+            (regs = need(s->child[1], var)) == 0 || regs > VECTOR_REGS)
+            return FALSE;
+    /* the last statement is i = i + 1 */
+    rhs = s->child[1];
+    if (n == 0 || s->nodekind != ExpK || s->kind.exp != AssignK || !isVar(s->child[0], var) ||
+        rhs->nodekind != ExpK || rhs->kind.exp != OpK || rhs->attr.op != PLUS ||
+        !((isVar(rhs->child[0], var) && isConst(rhs->child[1]) && rhs->child[1]->attr.val == 1) ||
+          (isConst(rhs->child[0]) && rhs->child[0]->attr.val == 1 && isVar(rhs->child[1], var))))
+        return FALSE;
+    if (!independent())
+        return FALSE;
+    v->stmts = body->child[1];
+    v->step = s;
+    v->test = allocTree();
+    *v->test = *test;
+    v->test->child[0] = newOp(PLUS, test->child[0], newConst(VECTOR_LENGTH - 1, loop->lineno));
+    v->next = allocTree();
+    *v->next = *s;
+    v->next->sibling = NULL;
+    v->next->child[1] = newOp(PLUS, s->child[0], newConst(VECTOR_LENGTH, loop->lineno));
+    return TRUE;
+}
@@ -0,0 +1,31 @@
+/****************************************************/
+/* File: vector.h                                   */
+/* Vectorization of element-wise array loops        */
+/* for the TINY compiler                            */
+/****************************************************/
+
+#ifndef _VECTOR_H_
+#define _VECTOR_H_
+
+/* a counted loop whose trips may run
+ * VECTOR_LENGTH at a time
+ */
+typedef struct
+{
+    TreeNode *stmts; /* the element assignments of the body */
+    TreeNode *step;  /* the counter step ending the body */
+    TreeNode *test;  /* the test for VECTOR_LENGTH more trips */
+    TreeNode *next;  /* the counter step by VECTOR_LENGTH */
+} VectorLoop;
+
+/* Function vectorLoop returns TRUE if the WhileK
+ * node loop steps a counter by one and otherwise
+ * only assigns sums, differences, products and
+ * comparisons of unchanging values and elements
+ * at the counter plus a constant to such elements,
+ * no trip touching an element another writes, and
+ * then describes it in v
+ */
+int vectorLoop(TreeNode *loop, VectorLoop *v);
+
+#endif